@@ -1,4 +1,11 @@
 #!/bin/bash
 
 $VULKAN_SDK/bin/glslc ../../shaders/triangle_shader.vert -o ../../shaders/vert.spv
-$VULKAN_SDK/bin/glslc ../../shaders/triangle_shader.frag -o ../../shaders/frag.spv
\ No newline at end of file
+$VULKAN_SDK/bin/glslc ../../shaders/triangle_shader.frag -o ../../shaders/frag.spv
+$VULKAN_SDK/bin/glslc ../../shaders/meshlet.vert -o ../../shaders/meshlet_vert.spv
+$VULKAN_SDK/bin/glslc ../../shaders/cluster_cull.comp -o ../../shaders/cluster_cull.spv
+$VULKAN_SDK/bin/glslc --target-spv=spv1.4 ../../shaders/meshlet.task -o ../../shaders/meshlet_task.spv
+$VULKAN_SDK/bin/glslc --target-spv=spv1.4 ../../shaders/meshlet.mesh -o ../../shaders/meshlet_mesh.spv
+$VULKAN_SDK/bin/glslc ../../shaders/mesh.vert -o ../../shaders/mesh_vert.spv
+$VULKAN_SDK/bin/glslc ../../shaders/cluster_occlusion.comp -o ../../shaders/cluster_occlusion.spv
+$VULKAN_SDK/bin/glslc ../../shaders/depth_pyramid.comp -o ../../shaders/depth_pyramid.spv
\ No newline at end of file
@@ -1,2 +1,9 @@
 "%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\triangle_shader.vert" -o "..\..\shaders\vert.spv"
-"%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\triangle_shader.frag" -o "..\..\shaders\frag.spv"
\ No newline at end of file
+"%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\triangle_shader.frag" -o "..\..\shaders\frag.spv"
+"%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\meshlet.vert" -o "..\..\shaders\meshlet_vert.spv"
+"%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\cluster_cull.comp" -o "..\..\shaders\cluster_cull.spv"
+"%VULKAN_SDK%\bin\glslc.exe" --target-spv=spv1.4 "..\..\shaders\meshlet.task" -o "..\..\shaders\meshlet_task.spv"
+"%VULKAN_SDK%\bin\glslc.exe" --target-spv=spv1.4 "..\..\shaders\meshlet.mesh" -o "..\..\shaders\meshlet_mesh.spv"
+"%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\mesh.vert" -o "..\..\shaders\mesh_vert.spv"
+"%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\cluster_occlusion.comp" -o "..\..\shaders\cluster_occlusion.spv"
+"%VULKAN_SDK%\bin\glslc.exe" "..\..\shaders\depth_pyramid.comp" -o "..\..\shaders\depth_pyramid.spv"
\ No newline at end of file
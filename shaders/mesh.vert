@@ -0,0 +1,45 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform FrameData {
+    float time;
+    float aspect;
+    vec2 padding;
+    mat4 view_projection;
+    vec4 camera_position;
+} frame;
+
+// Tint of the draw's material, see MeshRenderer.
+layout(set = 1, binding = 0) uniform Material {
+    vec4 color;
+} material;
+
+// Dequantization of the UNORM16 positions and the instance transform, matching
+// MeshPushConstants.
+layout(push_constant) uniform MeshDecode {
+    vec4 position_offset;
+    vec4 position_scale;
+    mat4 model;
+} decode;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main() {
+    vec3 local_position = decode.position_offset.xyz + inPosition.xyz * decode.position_scale.xyz;
+    vec3 position = (decode.model * vec4(local_position, 1.0)).xyz;
+    // Instances are rotated and uniformly scaled only.
+    vec3 normal = normalize(mat3(decode.model) * octDecode(inNormal));
+    gl_Position = frame.view_projection * vec4(position, 1.0);
+    vec3 to_camera = normalize(frame.camera_position.xyz - position);
+    fragColor = inColor.rgb * material.color.rgb * (0.25 + 0.75 * max(dot(normal, to_camera), 0.0));
+}
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshlet_common.glsl"
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 0) out vec3 fragColor;
+
+// The depth prepass draws with a different pipeline and the main pass tests
+// against its depths for equality.
+invariant gl_Position;
+
+void main() {
+    gl_Position = frame.view_projection * vec4(inPosition, 1.0);
+    fragColor = meshletColor(gl_InstanceIndex);
+}
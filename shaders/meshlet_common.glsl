@@ -0,0 +1,44 @@
+// Shared by the meshlet shaders. Layouts match FrameUniforms, Meshlet and
+// MeshletBounds on the C++ side.
+
+layout(set = 0, binding = 0) uniform FrameData {
+    float time;
+    float aspect;
+    vec2 padding;
+    mat4 view_projection;
+    vec4 camera_position;
+    vec4 frustum_planes[6];
+    // The view the depth pyramid was built with, for the first occlusion phase.
+    mat4 previous_view_projection;
+} frame;
+
+struct Meshlet {
+    uint vertex_offset;
+    uint triangle_offset;
+    uint vertex_count;
+    uint triangle_count;
+};
+
+struct MeshletBounds {
+    vec4 center_radius;
+    vec4 cone_apex;
+    vec4 cone_axis_cutoff;
+};
+
+layout(push_constant) uniform CullData {
+    uint meshlet_count;
+    uint write_first_instance;
+    // Occlusion culling only: 1 for the first phase, 2 for the second.
+    uint phase;
+    // Levels of the depth pyramid to test against, 0 for none.
+    uint pyramid_levels;
+    vec2 pyramid_size;
+    // 0 leaves the stats alone. Task shaders run once per window; only the main
+    // window's draw counts.
+    uint count_stats;
+} cull;
+
+vec3 meshletColor(uint index) {
+    uint hash = index * 2654435761u;
+    return vec3(float(hash & 255u), float((hash >> 8) & 255u), float((hash >> 16) & 255u)) / 255.0 * 0.7 + 0.3;
+}
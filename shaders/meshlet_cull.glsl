@@ -0,0 +1,53 @@
+// Cluster culling shared by the task shader and the compute fallback.
+
+layout(std430, set = 0, binding = 1) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Bounds {
+    MeshletBounds bounds[];
+};
+
+layout(std430, set = 0, binding = 7) buffer Stats {
+    uint visible;
+    uint frustum_culled;
+    uint backface_culled;
+    // Two-phase occlusion culling: clusters the first phase rejected that the
+    // second found visible, and those both phases rejected.
+    uint late_visible;
+    uint occlusion_culled;
+} stats;
+
+const uint cull_visible = 0;
+const uint cull_frustum = 1;
+const uint cull_backface = 2;
+
+// Mirrors isMeshletVisible() in meshlet.cpp.
+uint classifyMeshlet(uint index) {
+    MeshletBounds b = bounds[index];
+    for (int i = 0; i < 6; ++i) {
+        if (dot(frame.frustum_planes[i].xyz, b.center_radius.xyz) + frame.frustum_planes[i].w < -b.center_radius.w) {
+            return cull_frustum;
+        }
+    }
+    if (dot(normalize(b.cone_apex.xyz - frame.camera_position.xyz), b.cone_axis_cutoff.xyz) >= b.cone_axis_cutoff.w) {
+        return cull_backface;
+    }
+    return cull_visible;
+}
+
+// Classifies the meshlet and updates the culling counters if asked to.
+bool cullMeshlet(uint index) {
+    uint result = classifyMeshlet(index);
+    if (cull.count_stats == 0u) {
+        return result == cull_visible;
+    }
+    if (result == cull_frustum) {
+        atomicAdd(stats.frustum_culled, 1u);
+    } else if (result == cull_backface) {
+        atomicAdd(stats.backface_culled, 1u);
+    } else {
+        atomicAdd(stats.visible, 1u);
+    }
+    return result == cull_visible;
+}
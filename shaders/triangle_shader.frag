@@ -1,8 +1,25 @@
 #version 450
 
+// Pipeline variant switch, see TriangleFeatures. The other pipelines sharing
+// this shader leave it at the default.
+layout(constant_id = 2) const bool DITHER = false;
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 0) out vec4 outColor;
 
+const float bayer4x4[16] = float[](
+    0.0, 8.0, 2.0, 10.0,
+    12.0, 4.0, 14.0, 6.0,
+    3.0, 11.0, 1.0, 9.0,
+    15.0, 7.0, 13.0, 5.0
+);
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+    if (DITHER) {
+        // Ordered dither of one 8-bit step against banding in the gradients.
+        ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+        color += ((bayer4x4[pixel.y * 4 + pixel.x] + 0.5) / 16.0 - 0.5) / 255.0;
+    }
+    outColor = vec4(color, 1.0);
 }
\ No newline at end of file
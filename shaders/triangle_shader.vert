@@ -1,5 +1,20 @@
 #version 450
 
+layout(set = 0, binding = 0) uniform FrameData {
+    float time;
+    float aspect;
+} frame;
+
+layout(push_constant) uniform DrawData {
+    vec2 offset;
+    float scale;
+    float rotation;
+} draw;
+
+// Pipeline variant switches, see TriangleFeatures.
+layout(constant_id = 0) const bool ROTATION = true;
+layout(constant_id = 1) const bool VERTEX_COLORS = true;
+
 layout(location = 0) out vec3 fragColor;
 
 vec2 positions[3] = vec2[](
@@ -15,6 +30,12 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    vec2 position = positions[gl_VertexIndex] * draw.scale;
+    if (ROTATION) {
+        float angle = draw.rotation + frame.time;
+        position = mat2(cos(angle), sin(angle), -sin(angle), cos(angle)) * position;
+    }
+    position.x /= frame.aspect;
+    gl_Position = vec4(position + draw.offset, 0.0, 1.0);
+    fragColor = VERTEX_COLORS ? colors[gl_VertexIndex] : vec3(1.0);
+}
@@ -0,0 +1,143 @@
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+void normalize3(float v[3])
+{
+    float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len > 0.0f) {
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
+    }
+}
+
+void cross3(const float a[3], const float b[3], float out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+float dot3(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Gribb/Hartmann plane extraction for a [0, 1] depth range.
+void extractFrustumPlanes(const Mat4& view_projection, float planes[6][4])
+{
+    auto row = [&](int r, int c) { return view_projection.m[c * 4 + r]; };
+    for (int c = 0; c < 4; ++c) {
+        planes[0][c] = row(3, c) + row(0, c);
+        planes[1][c] = row(3, c) - row(0, c);
+        planes[2][c] = row(3, c) + row(1, c);
+        planes[3][c] = row(3, c) - row(1, c);
+        planes[4][c] = row(2, c);
+        planes[5][c] = row(3, c) - row(2, c);
+    }
+    for (int i = 0; i < 6; ++i) {
+        float len = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        for (int c = 0; c < 4; ++c) {
+            planes[i][c] /= len;
+        }
+    }
+}
+
+} // namespace
+
+Mat4 multiply(const Mat4& a, const Mat4& b)
+{
+    Mat4 result{};
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                sum += a.m[k * 4 + r] * b.m[c * 4 + k];
+            }
+            result.m[c * 4 + r] = sum;
+        }
+    }
+    return result;
+}
+
+Mat4 perspective(float fov_y_radians, float aspect, float z_near, float z_far)
+{
+    float f = 1.0f / std::tan(fov_y_radians * 0.5f);
+    Mat4 result{};
+    result.m[0] = f / aspect;
+    result.m[5] = -f;
+    result.m[10] = z_far / (z_near - z_far);
+    result.m[11] = -1.0f;
+    result.m[14] = z_near * z_far / (z_near - z_far);
+    return result;
+}
+
+Mat4 lookAt(const float eye[3], const float center[3], const float up[3])
+{
+    float f[3] = { center[0] - eye[0], center[1] - eye[1], center[2] - eye[2] };
+    normalize3(f);
+    float s[3];
+    cross3(f, up, s);
+    normalize3(s);
+    float u[3];
+    cross3(s, f, u);
+
+    Mat4 result{};
+    for (int i = 0; i < 3; ++i) {
+        result.m[i * 4 + 0] = s[i];
+        result.m[i * 4 + 1] = u[i];
+        result.m[i * 4 + 2] = -f[i];
+    }
+    result.m[12] = -dot3(s, eye);
+    result.m[13] = -dot3(u, eye);
+    result.m[14] = dot3(f, eye);
+    result.m[15] = 1.0f;
+    return result;
+}
+
+Camera makeCamera(const float eye[3], const float center[3], float fov_y_radians, float aspect, float z_near, float z_far)
+{
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+    Camera camera{};
+    camera.view = lookAt(eye, center, up);
+    camera.projection = perspective(fov_y_radians, aspect, z_near, z_far);
+    camera.view_projection = multiply(camera.projection, camera.view);
+    for (int i = 0; i < 3; ++i) {
+        camera.position[i] = eye[i];
+    }
+    extractFrustumPlanes(camera.view_projection, camera.frustum_planes);
+    return camera;
+}
+
+Camera makeOrbitCamera(const float center[3], float radius, float angle_radians, float aspect)
+{
+    constexpr float fov_y = 0.8f;
+    float distance = radius / std::sin(fov_y * 0.5f);
+    float eye[3] = {
+        center[0] + distance * std::sin(angle_radians),
+        center[1] + radius * 0.5f,
+        center[2] + distance * std::cos(angle_radians),
+    };
+    float z_near = std::max(distance - radius * 2.0f, distance * 0.01f);
+    return makeCamera(eye, center, fov_y, aspect, z_near, distance + radius * 2.0f);
+}
+
+Camera fitCamera(const Camera& base, float aspect)
+{
+    Camera camera = base;
+    // perspective() stores f / aspect and -f.
+    const float f_x = base.projection.m[0];
+    const float f_y = -base.projection.m[5];
+    if (aspect <= f_y / f_x) {
+        camera.projection.m[0] = f_y / aspect;
+    } else {
+        camera.projection.m[5] = -f_x * aspect;
+    }
+    camera.view_projection = multiply(camera.projection, camera.view);
+    extractFrustumPlanes(camera.view_projection, camera.frustum_planes);
+    return camera;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Column-major 4x4 matrices, laid out like GLSL mat4.
+struct Mat4
+{
+    float m[16];
+};
+
+Mat4 multiply(const Mat4& a, const Mat4& b);
+
+// Right handed, depth mapped to [0, 1] and Y flipped for Vulkan clip space, so
+// counter-clockwise triangles stay front facing.
+Mat4 perspective(float fov_y_radians, float aspect, float z_near, float z_far);
+Mat4 lookAt(const float eye[3], const float center[3], const float up[3]);
+
+struct Camera
+{
+    Mat4 view;
+    Mat4 projection;
+    Mat4 view_projection;
+    float position[3];
+    // World space planes (xyz normal pointing inside, w distance):
+    // left, right, bottom, top, near, far.
+    float frustum_planes[6][4];
+};
+
+Camera makeCamera(const float eye[3], const float center[3], float fov_y_radians, float aspect, float z_near, float z_far);
+
+// Orbits around a bounding sphere at a distance where it fills the view.
+Camera makeOrbitCamera(const float center[3], float radius, float angle_radians, float aspect);
+
+// Camera at the same place as base for a view with another aspect ratio. Its
+// frustum stays inside the one of base: a narrower view keeps the vertical
+// field of view, a wider one the horizontal, so it shows nothing culled by base.
+Camera fitCamera(const Camera& base, float aspect);
@@ -0,0 +1,601 @@
+#include "cluster_renderer.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr uint32_t task_group_size = 32;
+constexpr uint32_t cull_group_size = 64;
+
+// Matches CullData in meshlet_common.glsl.
+struct CullPushConstants
+{
+    uint32_t meshlet_count;
+    uint32_t write_first_instance;
+    uint32_t phase;
+    uint32_t pyramid_levels;
+    float pyramid_size[2];
+    uint32_t count_stats;
+};
+
+enum Binding : uint32_t
+{
+    binding_frame = 0,
+    binding_meshlets = 1,
+    binding_bounds = 2,
+    binding_vertex_indices = 3,
+    binding_triangle_indices = 4,
+    binding_positions = 5,
+    binding_draws = 6,
+    binding_stats = 7,
+    binding_depth_pyramid = 8,
+};
+
+std::string shaderPath(const char* name)
+{
+#if defined(_WIN32)
+    return std::string("shaders\\") + name;
+#else
+    return std::string("shaders/") + name;
+#endif
+}
+
+} // namespace
+
+ClusterRenderer::ClusterRenderer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                                 VkCommandPool command_pool, VkPipelineCache pipeline_cache, VkRenderPass render_pass,
+                                 VkRenderPass prepass_render_pass, VkBuffer frame_uniforms, VkDeviceSize frame_uniforms_size,
+                                 const MeshletData& data, const ClusterRendererFeatures& features, uint32_t frame_count)
+    : device_{device}
+    , features_{features}
+    , meshlet_count_{static_cast<uint32_t>(data.meshlets.size())}
+    , frames_(frame_count)
+{
+    if (data.meshlets.empty()) {
+        throw std::invalid_argument("meshlet data is empty");
+    }
+    if (features_.occlusion_culling && (features_.mesh_shaders || prepass_render_pass == VK_NULL_HANDLE)) {
+        throw std::invalid_argument("occlusion culling needs the compute path and a depth prepass");
+    }
+    if (features_.mesh_shaders) {
+        cmd_draw_mesh_tasks_ = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device_, "vkCmdDrawMeshTasksEXT"));
+        if (!cmd_draw_mesh_tasks_) {
+            throw std::runtime_error("failed to load vkCmdDrawMeshTasksEXT");
+        }
+    }
+
+    // Bounding sphere of the mesh around the center of its bounding box.
+    float min_corner[3] = { data.positions[0], data.positions[1], data.positions[2] };
+    float max_corner[3] = { data.positions[0], data.positions[1], data.positions[2] };
+    for (size_t i = 0; i < data.positions.size(); i += 3) {
+        for (int c = 0; c < 3; ++c) {
+            min_corner[c] = std::min(min_corner[c], data.positions[i + c]);
+            max_corner[c] = std::max(max_corner[c], data.positions[i + c]);
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        center_[c] = (min_corner[c] + max_corner[c]) * 0.5f;
+    }
+    for (size_t i = 0; i < data.positions.size(); i += 3) {
+        float dx = data.positions[i] - center_[0];
+        float dy = data.positions[i + 1] - center_[1];
+        float dz = data.positions[i + 2] - center_[2];
+        radius_ = std::max(radius_, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+
+    try {
+        createBuffers(data, mem_props, queue, command_pool);
+        createDescriptors(frame_uniforms, frame_uniforms_size);
+        createPipelines(pipeline_cache, render_pass, prepass_render_pass);
+    } catch (...) {
+        release();
+        throw;
+    }
+    std::cout << "Cluster renderer created: " << meshlet_count_ << " meshlets, "
+              << (features_.mesh_shaders ? "mesh shader" : "compute + indirect") << " path"
+              << (features_.occlusion_culling ? " with occlusion culling" : "") << std::endl;
+}
+
+ClusterRenderer::~ClusterRenderer()
+{
+    release();
+}
+
+void ClusterRenderer::release()
+{
+    vkDestroyPipeline(device_, depth_pipeline_, nullptr);
+    vkDestroyPipeline(device_, draw_pipeline_, nullptr);
+    vkDestroyPipeline(device_, cull_pipeline_, nullptr);
+    vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+    vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+    vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_, nullptr);
+    depth_pipeline_ = VK_NULL_HANDLE;
+    draw_pipeline_ = VK_NULL_HANDLE;
+    cull_pipeline_ = VK_NULL_HANDLE;
+    pipeline_layout_ = VK_NULL_HANDLE;
+    descriptor_pool_ = VK_NULL_HANDLE;
+    descriptor_set_layout_ = VK_NULL_HANDLE;
+    for (auto& frame: frames_) {
+        utils::destroyBuffer(device_, frame.draws);
+        utils::destroyBuffer(device_, frame.stats);
+    }
+    utils::destroyBuffer(device_, index_buffer_);
+    utils::destroyBuffer(device_, triangle_indices_);
+    utils::destroyBuffer(device_, vertex_indices_);
+    utils::destroyBuffer(device_, positions_);
+    utils::destroyBuffer(device_, bounds_);
+    utils::destroyBuffer(device_, meshlets_);
+}
+
+void ClusterRenderer::createBuffers(const MeshletData& data, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                                    VkCommandPool command_pool)
+{
+    auto upload = [&](const auto& values, VkBufferUsageFlags usage) {
+        return utils::createDeviceLocalBuffer(device_, mem_props, queue, command_pool, values.data(),
+                                              values.size() * sizeof(values[0]), usage);
+    };
+    meshlets_ = upload(data.meshlets, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    bounds_ = upload(data.bounds, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    positions_ = upload(data.positions, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    if (features_.mesh_shaders) {
+        vertex_indices_ = upload(data.vertex_indices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        // The shader reads the bytes as uints, so round the buffer up to whole words.
+        std::vector<uint8_t> triangle_indices = data.triangle_indices;
+        triangle_indices.resize((triangle_indices.size() + 3) & ~size_t(3), 0);
+        triangle_indices_ = upload(triangle_indices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    } else {
+        index_buffer_ = upload(flattenMeshletIndices(data), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    }
+
+    // Occlusion culling keeps a second set of draws for its second phase.
+    const VkDeviceSize draw_count = features_.occlusion_culling ? 2 * VkDeviceSize(meshlet_count_) : meshlet_count_;
+    for (auto& frame: frames_) {
+        if (!features_.mesh_shaders) {
+            frame.draws = utils::createBuffer(device_, mem_props, draw_count * sizeof(VkDrawIndexedIndirectCommand),
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        frame.stats = utils::createBuffer(device_, mem_props, sizeof(Stats),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+}
+
+VkShaderStageFlags ClusterRenderer::shaderStages() const
+{
+    if (features_.mesh_shaders) {
+        return VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+    return VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+}
+
+void ClusterRenderer::createDescriptors(VkBuffer frame_uniforms, VkDeviceSize frame_uniforms_size)
+{
+    std::vector<std::pair<Binding, VkDescriptorType>> bindings = {
+        { binding_frame, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC },
+        { binding_meshlets, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        { binding_bounds, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        { binding_stats, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+    };
+    if (features_.mesh_shaders) {
+        bindings.push_back({ binding_vertex_indices, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER });
+        bindings.push_back({ binding_triangle_indices, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER });
+        bindings.push_back({ binding_positions, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER });
+    } else {
+        bindings.push_back({ binding_draws, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER });
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> layout_bindings;
+    for (const auto& [binding, type]: bindings) {
+        VkDescriptorSetLayoutBinding layout_binding{};
+        layout_binding.binding = binding;
+        layout_binding.descriptorType = type;
+        layout_binding.descriptorCount = 1;
+        layout_binding.stageFlags = shaderStages();
+        layout_bindings.push_back(layout_binding);
+    }
+    // Written once a pyramid is set, see bindDepthPyramid().
+    if (features_.occlusion_culling) {
+        VkDescriptorSetLayoutBinding layout_binding{};
+        layout_binding.binding = binding_depth_pyramid;
+        layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        layout_binding.descriptorCount = 1;
+        layout_binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        layout_bindings.push_back(layout_binding);
+    }
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+    layout_info.pBindings = layout_bindings.data();
+    VkResult res = vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &descriptor_set_layout_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cluster descriptor set layout, error: " + std::to_string(res));
+    }
+
+    const uint32_t frame_count = static_cast<uint32_t>(frames_.size());
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame_count },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size() - 1) * frame_count },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame_count },
+    };
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = frame_count;
+    pool_info.poolSizeCount = features_.occlusion_culling ? 3 : 2;
+    pool_info.pPoolSizes = pool_sizes;
+    res = vkCreateDescriptorPool(device_, &pool_info, nullptr, &descriptor_pool_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cluster descriptor pool, error: " + std::to_string(res));
+    }
+
+    for (auto& frame: frames_) {
+        VkDescriptorSetAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = descriptor_pool_;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &descriptor_set_layout_;
+        res = vkAllocateDescriptorSets(device_, &alloc_info, &frame.descriptor_set);
+        if (res != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate cluster descriptor set, error: " + std::to_string(res));
+        }
+
+        auto bufferFor = [&](Binding binding) -> VkDescriptorBufferInfo {
+            switch (binding) {
+            case binding_frame: return { frame_uniforms, 0, frame_uniforms_size };
+            case binding_meshlets: return { meshlets_.buffer, 0, VK_WHOLE_SIZE };
+            case binding_bounds: return { bounds_.buffer, 0, VK_WHOLE_SIZE };
+            case binding_vertex_indices: return { vertex_indices_.buffer, 0, VK_WHOLE_SIZE };
+            case binding_triangle_indices: return { triangle_indices_.buffer, 0, VK_WHOLE_SIZE };
+            case binding_positions: return { positions_.buffer, 0, VK_WHOLE_SIZE };
+            case binding_draws: return { frame.draws.buffer, 0, VK_WHOLE_SIZE };
+            case binding_stats: return { frame.stats.buffer, 0, VK_WHOLE_SIZE };
+            case binding_depth_pyramid: break; // An image, written by bindDepthPyramid().
+            }
+            return {};
+        };
+        std::vector<VkDescriptorBufferInfo> buffer_infos;
+        buffer_infos.reserve(bindings.size());
+        std::vector<VkWriteDescriptorSet> writes;
+        for (const auto& [binding, type]: bindings) {
+            buffer_infos.push_back(bufferFor(binding));
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = frame.descriptor_set;
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            write.descriptorType = type;
+            write.pBufferInfo = &buffer_infos.back();
+            writes.push_back(write);
+        }
+        vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+VkShaderModule ClusterRenderer::loadShaderModule(const char* name)
+{
+    std::vector<char> code = utils::readFile(shaderPath(name));
+    VkShaderModuleCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = code.size();
+    create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+    VkResult res = vkCreateShaderModule(device_, &create_info, nullptr, &shader_module);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error(std::string("failed to create shader module ") + name + ", error: " + std::to_string(res));
+    }
+    return shader_module;
+}
+
+void ClusterRenderer::createPipelines(VkPipelineCache pipeline_cache, VkRenderPass render_pass, VkRenderPass prepass_render_pass)
+{
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = shaderStages();
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &descriptor_set_layout_;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    VkResult res = vkCreatePipelineLayout(device_, &layout_info, nullptr, &pipeline_layout_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cluster pipeline layout, error: " + std::to_string(res));
+    }
+
+    std::vector<VkShaderModule> modules;
+    auto stage = [&](VkShaderStageFlagBits flags, const char* name) {
+        modules.push_back(loadShaderModule(name));
+        VkPipelineShaderStageCreateInfo stage_info{};
+        stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage_info.stage = flags;
+        stage_info.module = modules.back();
+        stage_info.pName = "main";
+        return stage_info;
+    };
+
+    try {
+        if (features_.mesh_shaders) {
+            draw_pipeline_ = createGraphicsPipeline(pipeline_cache, render_pass, {
+                stage(VK_SHADER_STAGE_TASK_BIT_EXT, "meshlet_task.spv"),
+                stage(VK_SHADER_STAGE_MESH_BIT_EXT, "meshlet_mesh.spv"),
+                stage(VK_SHADER_STAGE_FRAGMENT_BIT, "frag.spv"),
+            }, false);
+        } else {
+            VkComputePipelineCreateInfo compute_info{};
+            compute_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            compute_info.stage = stage(VK_SHADER_STAGE_COMPUTE_BIT,
+                                       features_.occlusion_culling ? "cluster_occlusion.spv" : "cluster_cull.spv");
+            compute_info.layout = pipeline_layout_;
+            compute_info.basePipelineIndex = -1;
+            res = vkCreateComputePipelines(device_, pipeline_cache, 1, &compute_info, nullptr, &cull_pipeline_);
+            if (res != VK_SUCCESS) {
+                throw std::runtime_error("failed to create cluster culling pipeline, error: " + std::to_string(res));
+            }
+            const VkPipelineShaderStageCreateInfo vertex_stage = stage(VK_SHADER_STAGE_VERTEX_BIT, "meshlet_vert.spv");
+            draw_pipeline_ = createGraphicsPipeline(pipeline_cache, render_pass, {
+                vertex_stage,
+                stage(VK_SHADER_STAGE_FRAGMENT_BIT, "frag.spv"),
+            }, true);
+            if (features_.occlusion_culling) {
+                depth_pipeline_ = createGraphicsPipeline(pipeline_cache, prepass_render_pass, { vertex_stage }, true, true);
+            }
+        }
+    } catch (...) {
+        for (auto shader_module: modules) {
+            vkDestroyShaderModule(device_, shader_module, nullptr);
+        }
+        throw;
+    }
+    for (auto shader_module: modules) {
+        vkDestroyShaderModule(device_, shader_module, nullptr);
+    }
+}
+
+VkPipeline ClusterRenderer::createGraphicsPipeline(VkPipelineCache pipeline_cache, VkRenderPass render_pass,
+                                                   const std::vector<VkPipelineShaderStageCreateInfo>& stages, bool vertex_input,
+                                                   bool depth_only)
+{
+    VkDynamicState dynamic_states[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamic_state_info{};
+    dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state_info.dynamicStateCount = 2;
+    dynamic_state_info.pDynamicStates = dynamic_states;
+
+    VkVertexInputBindingDescription vertex_binding{};
+    vertex_binding.binding = 0;
+    vertex_binding.stride = 3 * sizeof(float);
+    vertex_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription position_attribute{};
+    position_attribute.location = 0;
+    position_attribute.binding = 0;
+    position_attribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+    position_attribute.offset = 0;
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_state_info{};
+    vertex_input_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_state_info.vertexBindingDescriptionCount = 1;
+    vertex_input_state_info.pVertexBindingDescriptions = &vertex_binding;
+    vertex_input_state_info.vertexAttributeDescriptionCount = 1;
+    vertex_input_state_info.pVertexAttributeDescriptions = &position_attribute;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_state_info{};
+    input_assembly_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly_state_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly_state_info.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewport_state_info{};
+    viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state_info.viewportCount = 1;
+    viewport_state_info.scissorCount = 1;
+
+    // Clusters facing away are already rejected by their normal cones; the
+    // rasterizer handles the remaining back faces inside visible clusters.
+    VkPipelineRasterizationStateCreateInfo rasterizer_info{};
+    rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer_info.lineWidth = 1.0f;
+    rasterizer_info.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisample_state_info{};
+    multisample_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample_state_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisample_state_info.minSampleShading = 1.0f;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment{};
+    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo color_blend_info{};
+    color_blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend_info.logicOpEnable = VK_FALSE;
+    color_blend_info.attachmentCount = depth_only ? 0 : 1;
+    color_blend_info.pAttachments = &color_blend_attachment;
+
+    // The main pass redraws the prepass clusters at equal depth.
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info{};
+    depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil_info.depthTestEnable = VK_TRUE;
+    depth_stencil_info.depthWriteEnable = VK_TRUE;
+    depth_stencil_info.depthCompareOp = depth_only ? VK_COMPARE_OP_LESS : VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkGraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = static_cast<uint32_t>(stages.size());
+    pipeline_info.pStages = stages.data();
+    // Mesh shading pipelines must not have vertex input or input assembly state.
+    pipeline_info.pVertexInputState = vertex_input ? &vertex_input_state_info : nullptr;
+    pipeline_info.pInputAssemblyState = vertex_input ? &input_assembly_state_info : nullptr;
+    pipeline_info.pViewportState = &viewport_state_info;
+    pipeline_info.pRasterizationState = &rasterizer_info;
+    pipeline_info.pMultisampleState = &multisample_state_info;
+    pipeline_info.pDepthStencilState = &depth_stencil_info;
+    pipeline_info.pColorBlendState = &color_blend_info;
+    pipeline_info.pDynamicState = &dynamic_state_info;
+    pipeline_info.layout = pipeline_layout_;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+    pipeline_info.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult res = vkCreateGraphicsPipelines(device_, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cluster draw pipeline, error: " + std::to_string(res));
+    }
+    return pipeline;
+}
+
+void ClusterRenderer::setDepthPyramid(const DepthPyramid* pyramid)
+{
+    depth_pyramid_ = pyramid;
+    for (auto& frame: frames_) {
+        frame.pyramid_bound = false;
+    }
+}
+
+void ClusterRenderer::bindDepthPyramid(FrameResources& frame)
+{
+    if (frame.pyramid_bound || !depth_pyramid_) {
+        return;
+    }
+    VkDescriptorImageInfo image_info{ depth_pyramid_->sampler(), depth_pyramid_->view(), VK_IMAGE_LAYOUT_GENERAL };
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = frame.descriptor_set;
+    write.dstBinding = binding_depth_pyramid;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+    frame.pyramid_bound = true;
+}
+
+void ClusterRenderer::recordCull(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset)
+{
+    FrameResources& frame = frames_[frame_slot];
+    frame.used = true;
+    vkCmdFillBuffer(command_buffer, frame.stats.buffer, 0, sizeof(Stats), 0);
+    const VkPipelineStageFlags cull_stage = features_.mesh_shaders ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    utils::memoryBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                         cull_stage, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    if (features_.mesh_shaders) {
+        return;
+    }
+
+    // The previous frame's draws read this slot's commands only before the slot's
+    // fence, so no write-after-read barrier is needed here. The slot's
+    // descriptor set is free to update for the same reason.
+    if (features_.occlusion_culling) {
+        bindDepthPyramid(frame);
+    }
+    recordCullDispatch(command_buffer, frame, frame_uniforms_offset, 1);
+    // The second occlusion phase reads back which clusters the first one drew.
+    utils::memoryBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void ClusterRenderer::recordLateCull(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset)
+{
+    FrameResources& frame = frames_[frame_slot];
+    recordCullDispatch(command_buffer, frame, frame_uniforms_offset, 2);
+    utils::memoryBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void ClusterRenderer::recordCullDispatch(VkCommandBuffer command_buffer, FrameResources& frame, uint32_t frame_uniforms_offset,
+                                         uint32_t phase)
+{
+    CullPushConstants push_constants{};
+    push_constants.meshlet_count = meshlet_count_;
+    push_constants.write_first_instance = features_.draw_indirect_first_instance ? 1u : 0u;
+    push_constants.phase = phase;
+    push_constants.count_stats = 1;
+    // The first frames after a pyramid is set have nothing to test against yet.
+    if (features_.occlusion_culling && depth_pyramid_ && depth_pyramid_->built()) {
+        push_constants.pyramid_levels = depth_pyramid_->levelCount();
+        push_constants.pyramid_size[0] = static_cast<float>(depth_pyramid_->extent().width);
+        push_constants.pyramid_size[1] = static_cast<float>(depth_pyramid_->extent().height);
+    }
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1, &frame.descriptor_set,
+                            1, &frame_uniforms_offset);
+    vkCmdPushConstants(command_buffer, pipeline_layout_, shaderStages(), 0, sizeof(push_constants), &push_constants);
+    vkCmdDispatch(command_buffer, (meshlet_count_ + cull_group_size - 1) / cull_group_size, 1, 1);
+}
+
+void ClusterRenderer::recordDepthPrepass(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset)
+{
+    const FrameResources& frame = frames_[frame_slot];
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depth_pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &frame.descriptor_set,
+                            1, &frame_uniforms_offset);
+    recordIndirectDraws(command_buffer, frame, 0, meshlet_count_);
+}
+
+void ClusterRenderer::recordDraw(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset,
+                                 bool count_stats)
+{
+    FrameResources& frame = frames_[frame_slot];
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &frame.descriptor_set,
+                            1, &frame_uniforms_offset);
+    if (features_.mesh_shaders) {
+        CullPushConstants push_constants{};
+        push_constants.meshlet_count = meshlet_count_;
+        push_constants.count_stats = count_stats ? 1u : 0u;
+        vkCmdPushConstants(command_buffer, pipeline_layout_, shaderStages(), 0, sizeof(push_constants), &push_constants);
+        cmd_draw_mesh_tasks_(command_buffer, (meshlet_count_ + task_group_size - 1) / task_group_size, 1, 1);
+        return;
+    }
+    // Both occlusion phases' draws follow each other in the buffer.
+    recordIndirectDraws(command_buffer, frame, 0, features_.occlusion_culling ? 2 * meshlet_count_ : meshlet_count_);
+}
+
+void ClusterRenderer::recordIndirectDraws(VkCommandBuffer command_buffer, const FrameResources& frame, uint32_t first,
+                                          uint32_t count)
+{
+    VkDeviceSize vertex_offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &positions_.buffer, &vertex_offset);
+    vkCmdBindIndexBuffer(command_buffer, index_buffer_.buffer, 0, VK_INDEX_TYPE_UINT32);
+    // Without multiDrawIndirect every draw has to be issued on its own.
+    const uint32_t batch = features_.multi_draw_indirect ? std::max(1u, features_.max_draw_indirect_count) : 1u;
+    const uint32_t end = first + count;
+    for (uint32_t draw = first; draw < end; draw += batch) {
+        uint32_t draw_count = std::min(batch, end - draw);
+        vkCmdDrawIndexedIndirect(command_buffer, frame.draws.buffer, draw * sizeof(VkDrawIndexedIndirectCommand), draw_count,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+void ClusterRenderer::recordEndFrame(VkCommandBuffer command_buffer)
+{
+    const VkPipelineStageFlags cull_stage = features_.mesh_shaders ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    utils::memoryBarrier(command_buffer,
+                         cull_stage, VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+std::optional<ClusterRenderer::Stats> ClusterRenderer::readStats(uint32_t frame_slot) const
+{
+    const FrameResources& frame = frames_[frame_slot];
+    if (!frame.used) {
+        return std::nullopt;
+    }
+    return *static_cast<const Stats*>(frame.stats.mapped);
+}
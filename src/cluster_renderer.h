@@ -0,0 +1,145 @@
+#pragma once
+
+#include "depth_pyramid.h"
+#include "meshlet.h"
+#include "vk_utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <optional>
+#include <stdint.h>
+#include <vector>
+
+struct ClusterRendererFeatures
+{
+    // VK_EXT_mesh_shader with task and mesh shaders enabled on the device.
+    bool mesh_shaders = false;
+    // Core features used by the compute fallback when the device has them.
+    bool multi_draw_indirect = false;
+    bool draw_indirect_first_instance = false;
+    uint32_t max_draw_indirect_count = 1;
+    // Two-phase occlusion culling against a depth pyramid, compute path only.
+    bool occlusion_culling = false;
+};
+
+// Draws a meshlet mesh with per-cluster frustum and normal cone culling on the
+// GPU. With mesh shaders the task shader culls 32 meshlets per workgroup and
+// launches mesh workgroups only for the visible ones. Otherwise a compute pass
+// writes one indexed indirect draw per meshlet, zeroing the instance count of
+// culled ones, and the draws read a flat index buffer in meshlet order.
+//
+// With occlusion culling a frame records recordCull(), the depth prepass with
+// recordDepthPrepass(), DepthPyramid::recordBuild() and recordLateCull(), in
+// that order and before any recordDraw(). The first phase tests clusters
+// against the previous frame's pyramid and feeds the prepass; the second tests
+// the clusters the first phase rejected against the pyramid of the prepass.
+// The main pass draws both phases' lists.
+class ClusterRenderer {
+public:
+    struct Stats
+    {
+        uint32_t visible;
+        uint32_t frustum_culled;
+        uint32_t backface_culled;
+        // Occlusion culling: clusters drawn by the second phase only, and those
+        // rejected by both phases. Visible includes the late ones.
+        uint32_t late_visible;
+        uint32_t occlusion_culled;
+    };
+
+public:
+    // frame_uniforms is the buffer bound with a dynamic offset at binding 0; it has
+    // to hold FrameUniforms with a valid camera. prepass_render_pass is the depth
+    // only pass of occlusion culling, VK_NULL_HANDLE without it.
+    ClusterRenderer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                    VkCommandPool command_pool, VkPipelineCache pipeline_cache, VkRenderPass render_pass,
+                    VkRenderPass prepass_render_pass, VkBuffer frame_uniforms, VkDeviceSize frame_uniforms_size,
+                    const MeshletData& data, const ClusterRendererFeatures& features, uint32_t frame_count);
+    ~ClusterRenderer();
+    ClusterRenderer(const ClusterRenderer&) = delete;
+    ClusterRenderer& operator=(const ClusterRenderer&) = delete;
+
+public:
+    // Points occlusion culling at a new pyramid. Frames in flight keep the old
+    // one; each frame slot switches over when it next records its culling.
+    void setDepthPyramid(const DepthPyramid* pyramid);
+
+    // Resets the counters and, on the fallback path, runs the culling dispatch
+    // (the first phase with occlusion culling). Must be recorded outside of a
+    // render pass.
+    void recordCull(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset);
+    // Draws the first phase's clusters into the depth-only prepass. Must be
+    // recorded inside that render pass, after viewport and scissor are set.
+    void recordDepthPrepass(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset);
+    // Second occlusion phase, after the pyramid has been rebuilt from the prepass.
+    void recordLateCull(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset);
+    // Must be recorded inside the render pass, after viewport and scissor are set.
+    // Mesh shaders cull in every draw; only a draw with count_stats adds to the
+    // counters, so exactly one window should pass it.
+    void recordDraw(VkCommandBuffer command_buffer, uint32_t frame_slot, uint32_t frame_uniforms_offset,
+                    bool count_stats);
+    // Makes the counters visible to the host. Must be recorded after the render pass.
+    void recordEndFrame(VkCommandBuffer command_buffer);
+    // Counters of the last frame recorded into frame_slot. The caller must have
+    // waited for that frame's fence.
+    std::optional<Stats> readStats(uint32_t frame_slot) const;
+
+    uint32_t meshletCount() const { return meshlet_count_; }
+    bool usesMeshShaders() const { return features_.mesh_shaders; }
+    bool usesOcclusionCulling() const { return features_.occlusion_culling; }
+    // Bounding sphere of the whole mesh, for placing the camera.
+    const float* center() const { return center_; }
+    float radius() const { return radius_; }
+
+private:
+    struct FrameResources
+    {
+        VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+        utils::Buffer draws;
+        utils::Buffer stats;
+        bool used = false;
+        // The descriptor set points at depth_pyramid_.
+        bool pyramid_bound = false;
+    };
+
+    void release();
+    void createBuffers(const MeshletData& data, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                       VkCommandPool command_pool);
+    void createDescriptors(VkBuffer frame_uniforms, VkDeviceSize frame_uniforms_size);
+    void createPipelines(VkPipelineCache pipeline_cache, VkRenderPass render_pass, VkRenderPass prepass_render_pass);
+    VkPipeline createGraphicsPipeline(VkPipelineCache pipeline_cache, VkRenderPass render_pass,
+                                      const std::vector<VkPipelineShaderStageCreateInfo>& stages, bool vertex_input,
+                                      bool depth_only = false);
+    void bindDepthPyramid(FrameResources& frame);
+    void recordCullDispatch(VkCommandBuffer command_buffer, FrameResources& frame, uint32_t frame_uniforms_offset,
+                            uint32_t phase);
+    void recordIndirectDraws(VkCommandBuffer command_buffer, const FrameResources& frame, uint32_t first, uint32_t count);
+    VkShaderModule loadShaderModule(const char* name);
+    VkShaderStageFlags shaderStages() const;
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    ClusterRendererFeatures features_;
+    PFN_vkCmdDrawMeshTasksEXT cmd_draw_mesh_tasks_ = nullptr;
+    uint32_t meshlet_count_ = 0;
+    float center_[3] = {};
+    float radius_ = 0.0f;
+
+    utils::Buffer meshlets_;
+    utils::Buffer bounds_;
+    utils::Buffer positions_;
+    // Mesh shader path.
+    utils::Buffer vertex_indices_;
+    utils::Buffer triangle_indices_;
+    // Compute fallback path.
+    utils::Buffer index_buffer_;
+
+    std::vector<FrameResources> frames_;
+    VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline cull_pipeline_ = VK_NULL_HANDLE;
+    VkPipeline draw_pipeline_ = VK_NULL_HANDLE;
+    // Occlusion culling.
+    VkPipeline depth_pipeline_ = VK_NULL_HANDLE;
+    const DepthPyramid* depth_pyramid_ = nullptr;
+};
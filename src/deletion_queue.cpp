@@ -0,0 +1,41 @@
+#include "deletion_queue.h"
+
+DeletionQueue::~DeletionQueue()
+{
+    flush();
+}
+
+void DeletionQueue::push(uint64_t frame_number, std::function<void()> deleter)
+{
+    entries_.push_back({frame_number, std::move(deleter)});
+}
+
+void DeletionQueue::collect(uint64_t frames_completed)
+{
+    // Entries are pushed with non-decreasing frame numbers in practice, but a
+    // late push for an older frame must not hold back the ones after it.
+    size_t kept = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].frame_number < frames_completed) {
+            entries_[i].deleter();
+        } else {
+            if (kept != i) {
+                entries_[kept] = std::move(entries_[i]);
+            }
+            ++kept;
+        }
+    }
+    entries_.resize(kept);
+}
+
+void DeletionQueue::flush()
+{
+    // A deleter may push further entries, so take the list first.
+    while (!entries_.empty()) {
+        std::vector<Entry> entries = std::move(entries_);
+        entries_.clear();
+        for (auto& entry: entries) {
+            entry.deleter();
+        }
+    }
+}
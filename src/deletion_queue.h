@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Defers the destruction of GPU objects until the frames that may still use them
+// have completed, so replacing an object never needs vkDeviceWaitIdle. Entries
+// are keyed by frame number: an entry pushed while frame N is being recorded runs
+// from the first collect() that reports more than N frames completed, which the
+// caller derives from its frame fences.
+class DeletionQueue {
+public:
+    DeletionQueue() = default;
+    // Runs everything still queued; the owner must have waited for the device.
+    ~DeletionQueue();
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+public:
+    void push(uint64_t frame_number, std::function<void()> deleter);
+    // Takes over a move-only owner (utils::OwnedHandle, a vector of them, ...),
+    // which is destroyed with the entry.
+    template <typename Resource>
+    void retire(uint64_t frame_number, Resource&& resource)
+    {
+        static_assert(!std::is_lvalue_reference_v<Resource>, "retire() takes ownership, pass an rvalue");
+        auto owner = std::make_shared<Resource>(std::move(resource));
+        push(frame_number, [owner]() mutable { owner.reset(); });
+    }
+
+    // Runs the entries of frames before frames_completed, in push order.
+    void collect(uint64_t frames_completed);
+    // Runs every entry. Only valid once the device is idle.
+    void flush();
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry
+    {
+        uint64_t frame_number;
+        std::function<void()> deleter;
+    };
+
+    std::vector<Entry> entries_;
+};
@@ -0,0 +1,272 @@
+#include "depth_pyramid.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Match the level array and the workgroup tile in depth_pyramid.comp.
+constexpr uint32_t max_levels = 16;
+constexpr uint32_t tile_size = 32;
+
+// Matches PyramidData in depth_pyramid.comp.
+struct PyramidPushConstants
+{
+    uint32_t depth_size[2];
+    uint32_t size[2];
+    uint32_t level_count;
+    uint32_t group_count;
+};
+
+std::string shaderPath(const char* name)
+{
+#if defined(_WIN32)
+    return std::string("shaders\\") + name;
+#else
+    return std::string("shaders/") + name;
+#endif
+}
+
+uint32_t previousPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result <= value / 2) {
+        result *= 2;
+    }
+    return result;
+}
+
+} // namespace
+
+DepthPyramid::DepthPyramid(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkPipelineCache pipeline_cache,
+                           VkImageView depth_view, VkExtent2D depth_extent)
+    : device_{device}
+    , depth_extent_{depth_extent}
+{
+    if (depth_extent.width == 0 || depth_extent.height == 0) {
+        throw std::invalid_argument("depth pyramid of an empty depth buffer");
+    }
+    createImage(mem_props);
+    createDescriptors(depth_view);
+    createPipeline(pipeline_cache);
+    std::cout << "Depth pyramid created: " << image_->extent.width << "x" << image_->extent.height << ", "
+              << image_->mip_levels << " levels" << std::endl;
+}
+
+void DepthPyramid::createImage(const VkPhysicalDeviceMemoryProperties& mem_props)
+{
+    const uint32_t max_size = 1u << (max_levels - 1);
+    VkExtent2D extent = { std::min(previousPowerOfTwo(depth_extent_.width), max_size),
+                          std::min(previousPowerOfTwo(depth_extent_.height), max_size) };
+    uint32_t level_count = 1;
+    while ((std::max(extent.width, extent.height) >> level_count) > 0) {
+        ++level_count;
+    }
+    image_ = utils::UniqueImage(device_, utils::createImage(device_, mem_props, extent, VK_FORMAT_R32_SFLOAT,
+                                                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                            VK_IMAGE_ASPECT_COLOR_BIT, level_count));
+
+    for (uint32_t level = 0; level < level_count; ++level) {
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image_->image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_->format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.baseMipLevel = level;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = 1;
+        VkImageView view = VK_NULL_HANDLE;
+        VkResult res = vkCreateImageView(device_, &view_info, nullptr, &view);
+        if (res != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid level view, error: " + std::to_string(res));
+        }
+        level_views_.emplace_back(device_, view);
+    }
+
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkResult res = vkCreateSampler(device_, &sampler_info, nullptr, &sampler);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid sampler, error: " + std::to_string(res));
+    }
+    sampler_ = utils::UniqueSampler(device_, sampler);
+
+    counter_ = utils::UniqueBuffer(device_, utils::createBuffer(device_, mem_props, sizeof(uint32_t),
+                                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+}
+
+void DepthPyramid::createDescriptors(VkImageView depth_view)
+{
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = max_levels;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 3;
+    layout_info.pBindings = bindings;
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    VkResult res = vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &set_layout);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor set layout, error: " + std::to_string(res));
+    }
+    descriptor_set_layout_ = utils::UniqueDescriptorSetLayout(device_, set_layout);
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, max_levels },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 3;
+    pool_info.pPoolSizes = pool_sizes;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    res = vkCreateDescriptorPool(device_, &pool_info, nullptr, &descriptor_pool);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor pool, error: " + std::to_string(res));
+    }
+    descriptor_pool_ = utils::UniqueDescriptorPool(device_, descriptor_pool);
+
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool_;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = descriptor_set_layout_.address();
+    res = vkAllocateDescriptorSets(device_, &alloc_info, &descriptor_set_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate depth pyramid descriptor set, error: " + std::to_string(res));
+    }
+
+    VkDescriptorImageInfo depth_info{ sampler_, depth_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    // Array entries past the last level repeat it, so every descriptor is valid.
+    std::vector<VkDescriptorImageInfo> level_infos(max_levels);
+    for (uint32_t i = 0; i < max_levels; ++i) {
+        level_infos[i] = { VK_NULL_HANDLE, level_views_[std::min<size_t>(i, level_views_.size() - 1)], VK_IMAGE_LAYOUT_GENERAL };
+    }
+    VkDescriptorBufferInfo counter_info{ counter_->buffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet writes[3]{};
+    for (uint32_t i = 0; i < 3; ++i) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptor_set_;
+        writes[i].dstBinding = bindings[i].binding;
+        writes[i].descriptorCount = bindings[i].descriptorCount;
+        writes[i].descriptorType = bindings[i].descriptorType;
+    }
+    writes[0].pImageInfo = &depth_info;
+    writes[1].pImageInfo = level_infos.data();
+    writes[2].pBufferInfo = &counter_info;
+    vkUpdateDescriptorSets(device_, 3, writes, 0, nullptr);
+}
+
+void DepthPyramid::createPipeline(VkPipelineCache pipeline_cache)
+{
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(PyramidPushConstants);
+
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = descriptor_set_layout_.address();
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkResult res = vkCreatePipelineLayout(device_, &layout_info, nullptr, &pipeline_layout);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline layout, error: " + std::to_string(res));
+    }
+    pipeline_layout_ = utils::UniquePipelineLayout(device_, pipeline_layout);
+
+    std::vector<char> code = utils::readFile(shaderPath("depth_pyramid.spv"));
+    VkShaderModuleCreateInfo module_info{};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = code.size();
+    module_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule module = VK_NULL_HANDLE;
+    res = vkCreateShaderModule(device_, &module_info, nullptr, &module);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module depth_pyramid.spv, error: " + std::to_string(res));
+    }
+    utils::UniqueShaderModule shader_module{device_, module};
+
+    VkComputePipelineCreateInfo compute_info{};
+    compute_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    compute_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compute_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    compute_info.stage.module = shader_module;
+    compute_info.stage.pName = "main";
+    compute_info.layout = pipeline_layout_;
+    compute_info.basePipelineIndex = -1;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    res = vkCreateComputePipelines(device_, pipeline_cache, 1, &compute_info, nullptr, &pipeline);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline, error: " + std::to_string(res));
+    }
+    pipeline_ = utils::UniquePipeline(device_, pipeline);
+}
+
+void DepthPyramid::recordBuild(VkCommandBuffer command_buffer)
+{
+    // Earlier builds and the culling passes reading their result have to finish
+    // before the levels and the counter are overwritten.
+    if (built_) {
+        utils::memoryBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+    } else {
+        utils::imageBarrier(command_buffer, image_->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    }
+    vkCmdFillBuffer(command_buffer, counter_->buffer, 0, sizeof(uint32_t), 0);
+    utils::memoryBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    const uint32_t groups_x = (image_->extent.width + tile_size - 1) / tile_size;
+    const uint32_t groups_y = (image_->extent.height + tile_size - 1) / tile_size;
+    PyramidPushConstants push_constants{};
+    push_constants.depth_size[0] = depth_extent_.width;
+    push_constants.depth_size[1] = depth_extent_.height;
+    push_constants.size[0] = image_->extent.width;
+    push_constants.size[1] = image_->extent.height;
+    push_constants.level_count = image_->mip_levels;
+    push_constants.group_count = groups_x * groups_y;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1, &descriptor_set_, 0, nullptr);
+    vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vkCmdDispatch(command_buffer, groups_x, groups_y, 1);
+    utils::memoryBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    built_ = true;
+}
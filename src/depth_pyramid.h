@@ -0,0 +1,62 @@
+#pragma once
+
+#include "vk_handle.h"
+#include "vk_utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Hierarchical depth (Hi-Z) pyramid of a depth buffer, for occlusion culling.
+// Level 0 is the depth buffer rounded down to a power of two, every texel
+// holding the farthest depth of the depth texels it covers; each further level
+// halves the previous one the same way. One dispatch builds every level in the
+// manner of single pass downsampling: each workgroup reduces a 32x32 tile of
+// level 0 down to a single texel of level 5 in shared memory, and the last
+// workgroup to finish reduces the remaining, small levels.
+class DepthPyramid {
+public:
+    // depth_view is sampled in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, so the
+    // depth image needs VK_IMAGE_USAGE_SAMPLED_BIT.
+    DepthPyramid(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkPipelineCache pipeline_cache,
+                 VkImageView depth_view, VkExtent2D depth_extent);
+    DepthPyramid(const DepthPyramid&) = delete;
+    DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+public:
+    // Must be recorded outside of a render pass, after the depth writes have been
+    // made visible to compute shaders. Leaves the pyramid in
+    // VK_IMAGE_LAYOUT_GENERAL, readable by later compute dispatches.
+    void recordBuild(VkCommandBuffer command_buffer);
+
+    // View of all levels and a nearest sampler for texelFetch().
+    VkImageView view() const { return image_->view; }
+    VkSampler sampler() const { return sampler_; }
+    VkExtent2D extent() const { return image_->extent; }
+    uint32_t levelCount() const { return image_->mip_levels; }
+    // False until the first build has been recorded; before that the levels
+    // hold undefined values and must not be tested against.
+    bool built() const { return built_; }
+
+private:
+    void createImage(const VkPhysicalDeviceMemoryProperties& mem_props);
+    void createDescriptors(VkImageView depth_view);
+    void createPipeline(VkPipelineCache pipeline_cache);
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkExtent2D depth_extent_{};
+    bool built_ = false;
+
+    utils::UniqueImage image_;
+    std::vector<utils::UniqueImageView> level_views_;
+    utils::UniqueSampler sampler_;
+    // Workgroups that have finished their tile, reset before every build.
+    utils::UniqueBuffer counter_;
+
+    utils::UniqueDescriptorSetLayout descriptor_set_layout_;
+    utils::UniqueDescriptorPool descriptor_pool_;
+    VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+    utils::UniquePipelineLayout pipeline_layout_;
+    utils::UniquePipeline pipeline_;
+};
@@ -0,0 +1,115 @@
+#include "draw_queue.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint32_t depth_bits = 20;
+constexpr uint32_t mesh_bits = 16;
+constexpr uint32_t material_bits = 16;
+constexpr uint32_t pipeline_bits = 8;
+constexpr uint32_t pass_bits = 4;
+
+constexpr uint32_t mesh_shift = depth_bits;
+constexpr uint32_t material_shift = mesh_shift + mesh_bits;
+constexpr uint32_t pipeline_shift = material_shift + material_bits;
+constexpr uint32_t pass_shift = pipeline_shift + pipeline_bits;
+static_assert(pass_shift + pass_bits == 64, "draw key fields must fill 64 bits");
+
+uint64_t field(uint32_t value, uint32_t bits, uint32_t shift)
+{
+    return (uint64_t(value) & ((uint64_t(1) << bits) - 1)) << shift;
+}
+
+uint32_t extract(uint64_t key, uint32_t bits, uint32_t shift)
+{
+    return static_cast<uint32_t>((key >> shift) & ((uint64_t(1) << bits) - 1));
+}
+
+struct NoopRecorder
+{
+    void bindPipeline(uint32_t) {}
+    void bindMaterial(uint32_t) {}
+    void bindMesh(uint32_t) {}
+    void draw(uint32_t) {}
+};
+
+} // namespace
+
+uint64_t packDrawKey(const DrawKeyFields& fields)
+{
+    return field(fields.pass, pass_bits, pass_shift) | field(fields.pipeline, pipeline_bits, pipeline_shift) |
+           field(fields.material, material_bits, material_shift) | field(fields.mesh, mesh_bits, mesh_shift) |
+           field(fields.depth, depth_bits, 0);
+}
+
+DrawKeyFields unpackDrawKey(uint64_t key)
+{
+    DrawKeyFields fields{};
+    fields.pass = extract(key, pass_bits, pass_shift);
+    fields.pipeline = extract(key, pipeline_bits, pipeline_shift);
+    fields.material = extract(key, material_bits, material_shift);
+    fields.mesh = extract(key, mesh_bits, mesh_shift);
+    fields.depth = extract(key, depth_bits, 0);
+    return fields;
+}
+
+uint32_t quantizeDrawDepth(float depth)
+{
+    const float max_depth = static_cast<float>((1u << depth_bits) - 1);
+    return static_cast<uint32_t>(std::clamp(depth, 0.0f, 1.0f) * max_depth);
+}
+
+void DrawQueue::clear()
+{
+    keys_.clear();
+    payloads_.clear();
+}
+
+void DrawQueue::push(uint64_t key, uint32_t payload)
+{
+    keys_.push_back(key);
+    payloads_.push_back(payload);
+}
+
+void DrawQueue::sort()
+{
+    const size_t count = keys_.size();
+    if (count < 2) {
+        return;
+    }
+    // Histograms of all eight digits in one read of the keys.
+    uint32_t histograms[8][256] = {};
+    for (uint64_t key: keys_) {
+        for (int digit = 0; digit < 8; ++digit) {
+            ++histograms[digit][(key >> (digit * 8)) & 0xff];
+        }
+    }
+    sorted_keys_.resize(count);
+    sorted_payloads_.resize(count);
+    for (int digit = 0; digit < 8; ++digit) {
+        uint32_t* offsets = histograms[digit];
+        const uint32_t shift = digit * 8;
+        if (offsets[(keys_[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            uint32_t bucket_size = offsets[bucket];
+            offsets[bucket] = offset;
+            offset += bucket_size;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t target = offsets[(keys_[i] >> shift) & 0xff]++;
+            sorted_keys_[target] = keys_[i];
+            sorted_payloads_[target] = payloads_[i];
+        }
+        keys_.swap(sorted_keys_);
+        payloads_.swap(sorted_payloads_);
+    }
+}
+
+DrawQueue::BindStats DrawQueue::bindStats() const
+{
+    return record(NoopRecorder{});
+}
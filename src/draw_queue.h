@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Render state of a draw, packed into a 64-bit sort key with the most
+// expensive state change in the highest bits:
+//   pass 63..60 | pipeline 59..52 | material 51..36 | mesh 35..20 | depth 19..0
+// Sorting by key groups draws by pass, pipeline, material and mesh, and orders
+// each group front to back.
+struct DrawKeyFields
+{
+    uint32_t pass;
+    uint32_t pipeline;
+    uint32_t material;
+    uint32_t mesh;
+    // See quantizeDrawDepth().
+    uint32_t depth;
+};
+
+uint64_t packDrawKey(const DrawKeyFields& fields);
+DrawKeyFields unpackDrawKey(uint64_t key);
+// Maps a depth in [0, 1], 0 nearest, to the key's depth field; values outside
+// are clamped.
+uint32_t quantizeDrawDepth(float depth);
+
+// Draws of one render pass, each a sort key and a payload the caller uses to
+// find what to draw. Filled and sorted every frame; record() replays the draws
+// in their current order and skips binds of state that is already bound.
+class DrawQueue {
+public:
+    struct BindStats
+    {
+        uint32_t draws;
+        uint32_t pipeline_binds;
+        uint32_t material_binds;
+        uint32_t mesh_binds;
+    };
+
+public:
+    void clear();
+    void push(uint64_t key, uint32_t payload);
+    // Stable LSD radix sort on 8-bit digits. Digits that are the same in every
+    // key are skipped, so unused key bits cost one histogram pass only.
+    void sort();
+    // Binds record() would issue for the current order.
+    BindStats bindStats() const;
+
+    // Recorder provides bindPipeline(id), bindMaterial(id), bindMesh(id) and
+    // draw(payload). Its pipelines must share one layout: a material stays
+    // bound across pipeline changes.
+    template <typename Recorder>
+    BindStats record(Recorder&& recorder) const
+    {
+        BindStats stats{};
+        DrawKeyFields bound{};
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            const DrawKeyFields fields = unpackDrawKey(keys_[i]);
+            if (i == 0 || fields.pipeline != bound.pipeline) {
+                recorder.bindPipeline(fields.pipeline);
+                ++stats.pipeline_binds;
+            }
+            if (i == 0 || fields.material != bound.material) {
+                recorder.bindMaterial(fields.material);
+                ++stats.material_binds;
+            }
+            if (i == 0 || fields.mesh != bound.mesh) {
+                recorder.bindMesh(fields.mesh);
+                ++stats.mesh_binds;
+            }
+            recorder.draw(payloads_[i]);
+            ++stats.draws;
+            bound = fields;
+        }
+        return stats;
+    }
+
+    size_t size() const { return keys_.size(); }
+    const std::vector<uint64_t>& keys() const { return keys_; }
+    const std::vector<uint32_t>& payloads() const { return payloads_; }
+
+private:
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> payloads_;
+    // Ping-pong targets of the sort passes, kept to reuse their memory.
+    std::vector<uint64_t> sorted_keys_;
+    std::vector<uint32_t> sorted_payloads_;
+};
@@ -0,0 +1,73 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Changes smaller than this are ignored to keep the render target size stable.
+constexpr float min_step = 0.02f;
+// Largest increase per frame; decreases are not limited.
+constexpr float max_increase = 0.05f;
+
+} // namespace
+
+DynamicResolutionController::DynamicResolutionController(DynamicResolutionSettings settings)
+    : settings_{settings}, scale_{settings.max_scale}
+{
+}
+
+void DynamicResolutionController::addSample(double gpu_ms, float rendered_scale)
+{
+    if (gpu_ms <= 0.0 || rendered_scale <= 0.0f) {
+        return;
+    }
+    const bool over_budget = gpu_ms > settings_.budget_ms;
+    if (over_budget && rendered_scale > scale_) {
+        return;
+    }
+    const double cost = gpu_ms / (double(rendered_scale) * rendered_scale);
+    samples_.push_back({ gpu_ms, cost });
+    while (samples_.size() > settings_.history) {
+        samples_.pop_front();
+    }
+
+    const double target_ms = settings_.budget_ms * settings_.target_fraction;
+    // Scaling up is judged on the worse of the average and the latest sample, so
+    // one cheap frame cannot push it past the budget. Over budget, this is
+    // rendered_scale * sqrt(target_ms / gpu_ms).
+    const double measured_cost = over_budget ? cost : std::max(cost, averageCost());
+    float wanted = static_cast<float>(std::sqrt(target_ms / measured_cost));
+    if (!over_budget) {
+        wanted = std::min(wanted, scale_ + max_increase);
+    }
+    wanted = std::clamp(wanted, settings_.min_scale, settings_.max_scale);
+    if (std::abs(wanted - scale_) >= min_step || wanted == settings_.min_scale || wanted == settings_.max_scale) {
+        scale_ = wanted;
+    }
+    if (over_budget) {
+        // Samples taken before the load rose would pull the average back down.
+        samples_.clear();
+    }
+}
+
+double DynamicResolutionController::averageMs() const
+{
+    if (samples_.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (const Sample& sample: samples_) {
+        sum += sample.gpu_ms;
+    }
+    return sum / static_cast<double>(samples_.size());
+}
+
+double DynamicResolutionController::averageCost() const
+{
+    double sum = 0.0;
+    for (const Sample& sample: samples_) {
+        sum += sample.cost;
+    }
+    return sum / static_cast<double>(samples_.size());
+}
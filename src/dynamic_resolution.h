@@ -0,0 +1,51 @@
+#pragma once
+
+#include <deque>
+#include <stdint.h>
+
+struct DynamicResolutionSettings
+{
+    double budget_ms = 16.0;
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    // Fraction of the budget the controller aims for, leaving room for noise.
+    double target_fraction = 0.9;
+    // Number of GPU frame times averaged before scaling back up.
+    uint32_t history = 16;
+};
+
+// Picks the render scale (fraction of the output extent per axis) from measured
+// GPU frame times. GPU cost is assumed to scale with pixel count, i.e. with the
+// square of the scale. Over budget, the latest sample is used so a load spike is
+// answered on the next frame; under budget, the rolling average is used and the
+// step is limited, so the scale creeps back up without oscillating.
+//
+// Samples arrive frames after they were rendered, so each one carries the scale
+// its frame used. Costs are compared per unit of scale squared, and a frame over
+// budget at a scale above the current one is ignored: the cut it asks for has
+// already been made.
+class DynamicResolutionController {
+public:
+    explicit DynamicResolutionController(DynamicResolutionSettings settings);
+
+public:
+    void addSample(double gpu_ms, float rendered_scale);
+    float scale() const { return scale_; }
+    double averageMs() const;
+    const DynamicResolutionSettings& settings() const { return settings_; }
+
+private:
+    struct Sample
+    {
+        double gpu_ms;
+        // gpu_ms over the square of the scale the frame was rendered at.
+        double cost;
+    };
+
+    double averageCost() const;
+
+private:
+    DynamicResolutionSettings settings_;
+    std::deque<Sample> samples_;
+    float scale_;
+};
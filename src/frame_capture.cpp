@@ -0,0 +1,451 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+bool isBgra(VkFormat format)
+{
+    return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+bool isRgba(VkFormat format)
+{
+    return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+void replaceAll(std::string& str, const std::string& from, const std::string& to)
+{
+    for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size())) {
+        str.replace(pos, from.size(), to);
+    }
+}
+
+const std::array<uint32_t, 256>& crcTable()
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    const auto& table = crcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void putPngChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+{
+    putBigEndian(out, static_cast<uint32_t>(size));
+    size_t type_pos = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    putBigEndian(out, crc32(out.data() + type_pos, size + 4));
+}
+
+// zlib stream made of stored (uncompressed) deflate blocks.
+void putZlibStored(std::vector<uint8_t>& out, const std::vector<uint8_t>& data)
+{
+    constexpr size_t max_block = 65535;
+    out.push_back(0x78);
+    out.push_back(0x01);
+    size_t pos = 0;
+    do {
+        size_t len = std::min(max_block, data.size() - pos);
+        bool last = pos + len == data.size();
+        out.push_back(last ? 1 : 0);
+        out.push_back(static_cast<uint8_t>(len));
+        out.push_back(static_cast<uint8_t>(len >> 8));
+        out.push_back(static_cast<uint8_t>(~len));
+        out.push_back(static_cast<uint8_t>(~len >> 8));
+        out.insert(out.end(), data.begin() + pos, data.begin() + pos + len);
+        pos += len;
+    } while (pos < data.size());
+
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < data.size(); ) {
+        // 5552 is the largest run that cannot overflow b before the modulo.
+        size_t end = std::min(data.size(), i + 5552);
+        for (; i < end; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    putBigEndian(out, (b << 16) | a);
+}
+
+} // namespace
+
+RawFileSink::RawFileSink(const std::string& path)
+    : file_{path, std::fstream::binary | std::fstream::trunc}
+{
+    if (!file_.is_open()) {
+        throw std::runtime_error("failed to open capture file: " + path);
+    }
+}
+
+void RawFileSink::write(const CapturedFrame& frame)
+{
+    const size_t row_size = static_cast<size_t>(frame.width) * 4;
+    for (uint32_t y = 0; y < frame.height; ++y) {
+        file_.write(reinterpret_cast<const char*>(frame.pixels + static_cast<size_t>(y) * frame.row_pitch), row_size);
+    }
+}
+
+PngSequenceSink::PngSequenceSink(std::string prefix)
+    : prefix_{std::move(prefix)}
+{
+}
+
+void PngSequenceSink::write(const CapturedFrame& frame)
+{
+    const size_t row_size = static_cast<size_t>(frame.width) * 4;
+    scanlines_.resize((row_size + 1) * frame.height);
+    const bool swizzle = isBgra(frame.format);
+    for (uint32_t y = 0; y < frame.height; ++y) {
+        uint8_t* dst = scanlines_.data() + y * (row_size + 1);
+        const uint8_t* src = frame.pixels + static_cast<size_t>(y) * frame.row_pitch;
+        *dst++ = 0; // filter type: none
+        if (swizzle) {
+            for (uint32_t x = 0; x < frame.width; ++x, dst += 4, src += 4) {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = src[3];
+            }
+        } else {
+            std::copy(src, src + row_size, dst);
+        }
+    }
+
+    encoded_.clear();
+    static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    encoded_.insert(encoded_.end(), std::begin(signature), std::end(signature));
+    std::vector<uint8_t> header;
+    putBigEndian(header, frame.width);
+    putBigEndian(header, frame.height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, no interlace
+    putPngChunk(encoded_, "IHDR", header.data(), header.size());
+    std::vector<uint8_t> idat;
+    putZlibStored(idat, scanlines_);
+    putPngChunk(encoded_, "IDAT", idat.data(), idat.size());
+    putPngChunk(encoded_, "IEND", nullptr, 0);
+
+    std::ostringstream name;
+    name << prefix_ << std::setw(6) << std::setfill('0') << index_++ << ".png";
+    std::ofstream file{name.str(), std::fstream::binary | std::fstream::trunc};
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open capture file: " + name.str());
+    }
+    file.write(reinterpret_cast<const char*>(encoded_.data()), encoded_.size());
+}
+
+PipeSink::PipeSink(std::string command, VkExtent2D extent, VkFormat format)
+{
+    replaceAll(command, "{width}", std::to_string(extent.width));
+    replaceAll(command, "{height}", std::to_string(extent.height));
+    replaceAll(command, "{pix_fmt}", isBgra(format) ? "bgra" : "rgba");
+#if defined(_WIN32)
+    pipe_ = _popen(command.c_str(), "wb");
+#else
+    pipe_ = popen(command.c_str(), "w");
+#endif
+    if (!pipe_) {
+        throw std::runtime_error("failed to start capture command: " + command);
+    }
+    std::cout << "Capture pipe: " << command << std::endl;
+}
+
+PipeSink::~PipeSink()
+{
+#if defined(_WIN32)
+    _pclose(pipe_);
+#else
+    pclose(pipe_);
+#endif
+}
+
+void PipeSink::write(const CapturedFrame& frame)
+{
+    const size_t row_size = static_cast<size_t>(frame.width) * 4;
+    for (uint32_t y = 0; y < frame.height; ++y) {
+        if (fwrite(frame.pixels + static_cast<size_t>(y) * frame.row_pitch, 1, row_size, pipe_) != row_size) {
+            throw std::runtime_error("failed to write frame to capture pipe");
+        }
+    }
+}
+
+std::unique_ptr<CaptureSink> createCaptureSink(const std::string& spec, VkExtent2D extent, VkFormat format)
+{
+    auto colon = spec.find(':');
+    if (colon == std::string::npos || colon + 1 == spec.size()) {
+        throw std::runtime_error("invalid capture spec: " + spec);
+    }
+    std::string kind = spec.substr(0, colon);
+    std::string target = spec.substr(colon + 1);
+    if (kind == "raw") {
+        return std::make_unique<RawFileSink>(target);
+    } else if (kind == "png") {
+        return std::make_unique<PngSequenceSink>(target);
+    } else if (kind == "pipe") {
+        return std::make_unique<PipeSink>(target, extent, format);
+    }
+    throw std::runtime_error("unknown capture sink: " + kind);
+}
+
+FrameCapture::FrameCapture(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props,
+                           VkExtent2D extent, VkFormat format, uint32_t ring_size,
+                           std::unique_ptr<CaptureSink> sink)
+    : device_{device}, extent_{extent}, format_{format}, sink_{std::move(sink)}
+{
+    if (!isBgra(format) && !isRgba(format)) {
+        throw std::runtime_error("frame capture supports only 8 bit RGBA/BGRA formats, got: " + std::to_string(format));
+    }
+    row_pitch_ = extent.width * 4;
+    const VkDeviceSize size = static_cast<VkDeviceSize>(row_pitch_) * extent.height;
+
+    slots_.resize(ring_size);
+    try {
+        for (auto& slot: slots_) {
+            // Cached memory makes the CPU reads fast; it is usually not coherent,
+            // which consume() handles with an explicit invalidate.
+            slot.buffer = utils::createBuffer(device_, mem_props, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        }
+        writer_ = std::thread([this] { writerLoop(); });
+    } catch (...) {
+        for (auto& slot: slots_) {
+            if (slot.buffer.buffer != VK_NULL_HANDLE) {
+                utils::destroyBuffer(device_, slot.buffer);
+            }
+        }
+        throw;
+    }
+    std::cout << "Frame capture created: " << ring_size << " x " << size / 1024 << " KiB readback buffers" << std::endl;
+}
+
+FrameCapture::~FrameCapture()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    writer_.join();
+    for (auto& slot: slots_) {
+        utils::destroyBuffer(device_, slot.buffer);
+    }
+}
+
+void FrameCapture::recordCopy(VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout, uint64_t frame_number)
+{
+    Slot* free_slot = nullptr;
+    {
+        std::lock_guard lock{mutex_};
+        for (auto& slot: slots_) {
+            if (slot.state == SlotState::free) {
+                free_slot = &slot;
+                break;
+            }
+        }
+        if (!free_slot) {
+            // Every buffer waits for the GPU or the sink; waiting for either would
+            // stall the render loop, so this frame is not captured.
+            ++frames_dropped_;
+            return;
+        }
+        free_slot->state = SlotState::copying;
+        free_slot->frame_number = frame_number;
+    }
+    Slot& slot = *free_slot;
+
+    utils::imageBarrier(command_buffer, image, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {extent_.width, extent_.height, 1};
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &region);
+
+    utils::imageBarrier(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+
+    VkBufferMemoryBarrier host_barrier{};
+    host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host_barrier.buffer = slot.buffer.buffer;
+    host_barrier.offset = 0;
+    host_barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &host_barrier, 0, nullptr);
+}
+
+void FrameCapture::consume(uint64_t frames_completed)
+{
+    bool print = false;
+    {
+        std::lock_guard lock{mutex_};
+        if (sink_error_) {
+            std::rethrow_exception(sink_error_);
+        }
+        std::vector<Slot*> ready;
+        uint32_t backlog = 0;
+        for (auto& slot: slots_) {
+            if (slot.state == SlotState::copying && slot.frame_number < frames_completed) {
+                ready.push_back(&slot);
+            } else if (slot.state == SlotState::writing) {
+                ++backlog;
+            }
+        }
+        std::sort(ready.begin(), ready.end(), [](const Slot* a, const Slot* b) {
+            return a->frame_number < b->frame_number;
+        });
+        for (Slot* slot: ready) {
+            if (!(slot->buffer.memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+                VkMappedMemoryRange range{};
+                range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                range.memory = slot->buffer.memory;
+                range.offset = 0;
+                range.size = VK_WHOLE_SIZE;
+                vkInvalidateMappedMemoryRanges(device_, 1, &range);
+            }
+            slot->state = SlotState::writing;
+            write_queue_.push_back(slot);
+        }
+        peak_backlog_ = std::max(peak_backlog_, backlog);
+        if (frames_written_ >= next_stats_) {
+            next_stats_ = frames_written_ + 300;
+            print = true;
+        }
+    }
+    condition_.notify_one();
+    if (print) {
+        printStats(std::cout);
+    }
+}
+
+void FrameCapture::finish()
+{
+    std::unique_lock lock{mutex_};
+    condition_.wait(lock, [this] {
+        return std::none_of(slots_.begin(), slots_.end(), [](const Slot& slot) { return slot.state == SlotState::writing; });
+    });
+    if (sink_error_) {
+        std::rethrow_exception(sink_error_);
+    }
+}
+
+void FrameCapture::writerLoop()
+{
+    for (;;) {
+        Slot* slot = nullptr;
+        {
+            std::unique_lock lock{mutex_};
+            condition_.wait(lock, [this] { return stopping_ || !write_queue_.empty(); });
+            // Queued frames are still written on shutdown.
+            if (write_queue_.empty()) {
+                return;
+            }
+            slot = write_queue_.front();
+            write_queue_.pop_front();
+        }
+
+        CapturedFrame frame{};
+        frame.frame_number = slot->frame_number;
+        frame.width = extent_.width;
+        frame.height = extent_.height;
+        frame.row_pitch = row_pitch_;
+        frame.format = format_;
+        frame.pixels = static_cast<const uint8_t*>(slot->buffer.mapped);
+
+        auto begin = std::chrono::steady_clock::now();
+        std::exception_ptr error;
+        try {
+            sink_->write(frame);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        auto end = std::chrono::steady_clock::now();
+        {
+            std::lock_guard lock{mutex_};
+            if (error) {
+                // The render thread rethrows it; later frames are not written.
+                if (!sink_error_) {
+                    sink_error_ = error;
+                }
+            } else if (!sink_error_) {
+                if (frames_written_ == 0) {
+                    first_write_ = begin;
+                }
+                sink_time_ += end - begin;
+                ++frames_written_;
+                bytes_written_ += static_cast<uint64_t>(row_pitch_) * extent_.height;
+            }
+            slot->state = SlotState::free;
+        }
+        // Wakes finish().
+        condition_.notify_all();
+    }
+}
+
+void FrameCapture::printStats(std::ostream& os) const
+{
+    std::lock_guard lock{mutex_};
+    if (frames_written_ == 0) {
+        os << "Capture: no frames written, " << frames_dropped_ << " dropped" << std::endl;
+        return;
+    }
+    using ms = std::chrono::duration<double, std::milli>;
+    const double wall_s = ms(std::chrono::steady_clock::now() - first_write_).count() / 1000.0;
+    const double sink_ms = ms(sink_time_).count();
+    const double mib = static_cast<double>(bytes_written_) / (1024.0 * 1024.0);
+    os << "Capture " << extent_.width << "x" << extent_.height << ": "
+       << frames_written_ << " frames written, " << frames_dropped_ << " dropped, "
+       << (wall_s > 0.0 ? frames_written_ / wall_s : 0.0) << " fps sustained, "
+       << (wall_s > 0.0 ? mib / wall_s : 0.0) << " MiB/s, "
+       << "sink " << sink_ms / frames_written_ << " ms/frame ("
+       << (sink_ms > 0.0 ? mib / (sink_ms / 1000.0) : 0.0) << " MiB/s peak), writer busy "
+       << (wall_s > 0.0 ? std::min(100.0, sink_ms / (wall_s * 10.0)) : 0.0) << "%, backlog peak "
+       << peak_backlog_ << "/" << slots_.size() << " buffers" << std::endl;
+}
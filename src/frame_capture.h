@@ -0,0 +1,147 @@
+#pragma once
+
+#include "vk_utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CapturedFrame
+{
+    uint64_t frame_number;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_pitch;
+    VkFormat format;
+    const uint8_t* pixels;
+};
+
+class CaptureSink {
+public:
+    virtual ~CaptureSink() = default;
+    virtual void write(const CapturedFrame& frame) = 0;
+};
+
+// Appends every frame's pixels to a single file, back to back.
+class RawFileSink : public CaptureSink {
+public:
+    explicit RawFileSink(const std::string& path);
+    void write(const CapturedFrame& frame) override;
+
+private:
+    std::ofstream file_;
+};
+
+// Writes <prefix>000000.png, <prefix>000001.png, ... as uncompressed RGBA PNGs,
+// which keeps the encoder dependency free and cheap on the CPU.
+class PngSequenceSink : public CaptureSink {
+public:
+    explicit PngSequenceSink(std::string prefix);
+    void write(const CapturedFrame& frame) override;
+
+private:
+    std::string prefix_;
+    uint64_t index_ = 0;
+    std::vector<uint8_t> scanlines_;
+    std::vector<uint8_t> encoded_;
+};
+
+// Streams raw frames into the stdin of a shell command, e.g. an ffmpeg encoder.
+// "{width}", "{height}" and "{pix_fmt}" in the command are replaced by the
+// capture extent and the matching ffmpeg pixel format.
+class PipeSink : public CaptureSink {
+public:
+    PipeSink(std::string command, VkExtent2D extent, VkFormat format);
+    ~PipeSink() override;
+    PipeSink(const PipeSink&) = delete;
+    PipeSink& operator=(const PipeSink&) = delete;
+    void write(const CapturedFrame& frame) override;
+
+private:
+    FILE* pipe_ = nullptr;
+};
+
+// spec is "raw:<file>", "png:<prefix>" or "pipe:<command>".
+std::unique_ptr<CaptureSink> createCaptureSink(const std::string& spec, VkExtent2D extent, VkFormat format);
+
+// Reads rendered frames back to the CPU without stalling the GPU. Each frame is
+// copied into a free one of ring_size persistently mapped host buffers. Once the
+// frame's submission is known to be complete, the buffer is handed to a writer
+// thread that feeds the sink, and it is only free again when the sink is done
+// with it. Neither the copy nor the sink ever blocks the render loop: a frame
+// that finds every buffer in use is dropped instead.
+class FrameCapture {
+public:
+    FrameCapture(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props,
+                 VkExtent2D extent, VkFormat format, uint32_t ring_size,
+                 std::unique_ptr<CaptureSink> sink);
+    ~FrameCapture();
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+public:
+    // Records the copy of image (currently in layout, last written as a color
+    // attachment) into a free buffer, or drops frame_number if there is none. The
+    // image is returned to layout.
+    void recordCopy(VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout, uint64_t frame_number);
+    // Queues every captured frame with a number below frames_completed for the
+    // writer thread. Rethrows the first error of the sink.
+    void consume(uint64_t frames_completed);
+    // Waits until the writer has handed every queued frame to the sink.
+    void finish();
+    void printStats(std::ostream& os) const;
+
+private:
+    enum class SlotState
+    {
+        free,
+        // Copy recorded; the frame's submission may still be running.
+        copying,
+        // Queued for or being written by the writer thread.
+        writing,
+    };
+
+    struct Slot
+    {
+        utils::Buffer buffer;
+        uint64_t frame_number = 0;
+        SlotState state = SlotState::free;
+    };
+
+    void writerLoop();
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkExtent2D extent_;
+    VkFormat format_;
+    uint32_t row_pitch_ = 0;
+    std::vector<Slot> slots_;
+    std::unique_ptr<CaptureSink> sink_;
+
+    // Guards the slot states, the queue and the statistics.
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Slot*> write_queue_;
+    std::exception_ptr sink_error_;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    std::chrono::steady_clock::time_point first_write_{};
+    std::chrono::steady_clock::duration sink_time_{};
+    uint64_t frames_written_ = 0;
+    uint64_t frames_dropped_ = 0;
+    uint64_t bytes_written_ = 0;
+    // Buffers held by the writer when frames were queued, the sink's backpressure.
+    uint32_t peak_backlog_ = 0;
+    uint64_t next_stats_ = 300;
+};
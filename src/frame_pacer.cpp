@@ -0,0 +1,114 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Fractions of the refresh period the start delay and its limit grow by per
+// frame that made its vblank.
+constexpr double delay_step = 1.0 / 64.0;
+constexpr double limit_step = 1.0 / 1024.0;
+
+FramePacer::Clock::duration toDuration(double ms)
+{
+    return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+}
+
+double toMs(FramePacer::Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+} // namespace
+
+FramePacer::FramePacer(FramePacerSettings settings)
+    : settings_{settings}
+    , delay_limit_ms_{std::max(0.0, settings.refresh_period_ms - settings.margin_ms)}
+{
+}
+
+FramePacer::Clock::time_point FramePacer::startTime(Clock::time_point last_present) const
+{
+    return last_present + toDuration(start_delay_ms_);
+}
+
+void FramePacer::frameStarted(uint64_t frame_number, Clock::time_point time)
+{
+    // A frame skipped for a swap chain rebuild is started again.
+    if (!started_.empty() && started_.back().first == frame_number) {
+        started_.back().second = time;
+        return;
+    }
+    started_.emplace_back(frame_number, time);
+}
+
+std::optional<FrameLatency> FramePacer::framePresented(uint64_t frame_number, Clock::time_point time)
+{
+    while (!started_.empty() && started_.front().first < frame_number) {
+        started_.pop_front();
+    }
+    if (started_.empty() || started_.front().first != frame_number) {
+        return std::nullopt;
+    }
+    FrameLatency result{};
+    result.frame_number = frame_number;
+    result.latency_ms = toMs(time - started_.front().second);
+    result.start_delay_ms = start_delay_ms_;
+    started_.pop_front();
+
+    // Every frame aims at the first vblank after the previous present.
+    result.missed = last_present_ && toMs(time - *last_present_) > 1.5 * settings_.refresh_period_ms;
+    last_present_ = time;
+    const double max_delay_ms = std::max(0.0, settings_.refresh_period_ms - settings_.margin_ms);
+    if (result.missed) {
+        delay_limit_ms_ = std::max(0.0, start_delay_ms_ - settings_.margin_ms);
+        start_delay_ms_ = delay_limit_ms_;
+        ++missed_;
+    } else {
+        delay_limit_ms_ = std::min(delay_limit_ms_ + settings_.refresh_period_ms * limit_step, max_delay_ms);
+        start_delay_ms_ = std::min(start_delay_ms_ + settings_.refresh_period_ms * delay_step, delay_limit_ms_);
+    }
+    ++presented_;
+
+    history_.push_back(result);
+    while (history_.size() > settings_.history) {
+        history_.pop_front();
+    }
+    return result;
+}
+
+FramePacer::Clock::time_point FramePacer::estimatePresent(Clock::time_point rendered)
+{
+    // The first frame sets the phase of the modelled vblanks. After that a FIFO
+    // display shows at most one image per refresh, at the first vblank after
+    // the image is done.
+    if (!last_estimate_) {
+        last_estimate_ = rendered;
+        return rendered;
+    }
+    const double period_ms = settings_.refresh_period_ms;
+    Clock::time_point vblank = *last_estimate_ + toDuration(period_ms);
+    if (rendered > vblank) {
+        vblank += toDuration(std::ceil(toMs(rendered - vblank) / period_ms) * period_ms);
+    }
+    last_estimate_ = vblank;
+    return vblank;
+}
+
+void FramePacer::printStats(std::ostream& os) const
+{
+    if (history_.empty()) {
+        os << "Frame pacing: no frames presented" << std::endl;
+        return;
+    }
+    double total_ms = 0.0;
+    double max_ms = 0.0;
+    for (const FrameLatency& frame: history_) {
+        total_ms += frame.latency_ms;
+        max_ms = std::max(max_ms, frame.latency_ms);
+    }
+    os << "Frame pacing: latency avg " << total_ms / history_.size() << " ms, max " << max_ms << " ms over "
+       << history_.size() << " frames, start delay " << start_delay_ms_ << "/" << settings_.refresh_period_ms
+       << " ms, " << missed_ << "/" << presented_ << " frames missed their vblank" << std::endl;
+}
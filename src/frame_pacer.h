@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <ostream>
+#include <stdint.h>
+#include <utility>
+
+struct FramePacerSettings
+{
+    double refresh_period_ms = 1000.0 / 60.0;
+    // Part of the refresh period never given up to the start delay, so a frame
+    // that takes slightly longer than the last ones still makes its vblank.
+    double margin_ms = 2.0;
+    // Number of frames the latency report is averaged over.
+    uint32_t history = 120;
+};
+
+struct FrameLatency
+{
+    uint64_t frame_number = 0;
+    // From the CPU starting the frame to the frame reaching the display.
+    double latency_ms = 0.0;
+    // Delay the frame was started with after the previous present.
+    double start_delay_ms = 0.0;
+    // The frame was shown one or more refreshes after the one it aimed for.
+    bool missed = false;
+};
+
+// Starts frames just in time for the vblank they are shown at. The caller waits
+// until the previous frame has reached the display, then until startTime(), so at
+// most one frame is queued and input is sampled as late as possible. The start
+// delay grows a little after every frame that made its vblank. A miss drops it
+// by the margin and caps it there; the cap creeps back up far slower, so the
+// delay settles just below the point where frames start missing and probes
+// for more only now and then.
+//
+// Present times come from VK_KHR_present_wait when available. Without it,
+// estimatePresent() stands in: it models a FIFO display refreshing at
+// refresh_period_ms and predicts the vblank a frame finished rendering at is
+// shown at, which is all the pacer itself consumes.
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+public:
+    explicit FramePacer(FramePacerSettings settings);
+
+public:
+    // When to start the frame after the one presented at last_present.
+    Clock::time_point startTime(Clock::time_point last_present) const;
+    void frameStarted(uint64_t frame_number, Clock::time_point time);
+    // Frames have to be reported in order. Returns the frame's latency, or
+    // nothing for a frame that was not reported as started.
+    std::optional<FrameLatency> framePresented(uint64_t frame_number, Clock::time_point time);
+    // Software stand-in for present_wait: the vblank at which a frame that
+    // finished rendering at rendered is shown.
+    Clock::time_point estimatePresent(Clock::time_point rendered);
+
+    double startDelayMs() const { return start_delay_ms_; }
+    void printStats(std::ostream& os) const;
+
+private:
+    FramePacerSettings settings_;
+    double start_delay_ms_ = 0.0;
+    double delay_limit_ms_ = 0.0;
+    std::deque<std::pair<uint64_t, Clock::time_point>> started_;
+    std::optional<Clock::time_point> last_present_;
+    std::optional<Clock::time_point> last_estimate_;
+    std::deque<FrameLatency> history_;
+    uint64_t presented_ = 0;
+    uint64_t missed_ = 0;
+};
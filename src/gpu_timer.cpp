@@ -0,0 +1,55 @@
+#include "gpu_timer.h"
+
+#include <stdexcept>
+#include <string>
+
+GpuTimer::GpuTimer(VkDevice device, float timestamp_period_ns, uint32_t slot_count)
+    : device_{device}, period_ms_{timestamp_period_ns / 1e6}, slot_count_{slot_count}
+{
+    if (slot_count == 0 || slot_count > 64) {
+        throw std::runtime_error("gpu timer supports 1 to 64 slots, got: " + std::to_string(slot_count));
+    }
+    VkQueryPoolCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = slot_count * 2;
+    VkResult res = vkCreateQueryPool(device_, &create_info, nullptr, &query_pool_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool, error: " + std::to_string(res));
+    }
+}
+
+GpuTimer::~GpuTimer()
+{
+    vkDestroyQueryPool(device_, query_pool_, nullptr);
+}
+
+void GpuTimer::reset(VkCommandBuffer command_buffer, uint32_t slot)
+{
+    vkCmdResetQueryPool(command_buffer, query_pool_, slot * 2, 2);
+}
+
+void GpuTimer::begin(VkCommandBuffer command_buffer, uint32_t slot)
+{
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_, slot * 2);
+}
+
+void GpuTimer::end(VkCommandBuffer command_buffer, uint32_t slot)
+{
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_, slot * 2 + 1);
+    used_slots_ |= 1ull << slot;
+}
+
+std::optional<double> GpuTimer::read(uint32_t slot)
+{
+    if (!(used_slots_ & (1ull << slot))) {
+        return std::nullopt;
+    }
+    uint64_t timestamps[2] = {};
+    VkResult res = vkGetQueryPoolResults(device_, query_pool_, slot * 2, 2, sizeof(timestamps), timestamps,
+                                         sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS || timestamps[1] < timestamps[0]) {
+        return std::nullopt;
+    }
+    return static_cast<double>(timestamps[1] - timestamps[0]) * period_ms_;
+}
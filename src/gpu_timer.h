@@ -0,0 +1,34 @@
+#pragma once
+
+#include "vulkan/vulkan_core.h"
+
+#include <optional>
+#include <stdint.h>
+
+// Measures GPU time between two points of a command buffer with timestamp
+// queries. Each slot owns a begin/end query pair, so one slot per frame in flight
+// lets results be read after the frame's fence without ever waiting on a query.
+class GpuTimer {
+public:
+    GpuTimer(VkDevice device, float timestamp_period_ns, uint32_t slot_count);
+    ~GpuTimer();
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+public:
+    // Must be recorded outside of a render pass, before begin() for the slot.
+    void reset(VkCommandBuffer command_buffer, uint32_t slot);
+    // May be recorded inside a render pass, to time single draws.
+    void begin(VkCommandBuffer command_buffer, uint32_t slot);
+    void end(VkCommandBuffer command_buffer, uint32_t slot);
+    // Elapsed milliseconds of the last begin/end pair recorded into slot, or
+    // nothing if that slot has not been used or its results are not available.
+    std::optional<double> read(uint32_t slot);
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueryPool query_pool_ = VK_NULL_HANDLE;
+    double period_ms_ = 0.0;
+    uint32_t slot_count_ = 0;
+    uint64_t used_slots_ = 0;
+};
@@ -0,0 +1,81 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <iterator>
+
+JobSystem::JobSystem(uint32_t thread_count)
+{
+    if (thread_count == 0) {
+        thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    workers_.reserve(thread_count);
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    for (auto& worker: workers_) {
+        worker.join();
+    }
+}
+
+size_t JobSystem::pendingJobs() const
+{
+    std::lock_guard lock{mutex_};
+    return batches_.size() + jobs_.size();
+}
+
+bool JobSystem::runBatch()
+{
+    Job batch;
+    {
+        std::lock_guard lock{mutex_};
+        if (batches_.empty()) {
+            return false;
+        }
+        batch = std::move(batches_.front());
+        batches_.pop_front();
+    }
+    batch.run();
+    return true;
+}
+
+void JobSystem::cancelBatches(const void* owner)
+{
+    std::deque<Job> cancelled;
+    {
+        std::lock_guard lock{mutex_};
+        auto it = std::stable_partition(batches_.begin(), batches_.end(), [owner](const Job& batch) {
+            return batch.owner != owner;
+        });
+        std::move(it, batches_.end(), std::back_inserter(cancelled));
+        batches_.erase(it, batches_.end());
+    }
+    // Destroying the tasks breaks their promises, outside the lock.
+}
+
+void JobSystem::workerLoop()
+{
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock lock{mutex_};
+            condition_.wait(lock, [this] { return stopping_ || !batches_.empty() || !jobs_.empty(); });
+            // Queued jobs are still run on shutdown so no future is left broken.
+            auto& queue = batches_.empty() ? jobs_ : batches_;
+            if (queue.empty()) {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job.run();
+    }
+}
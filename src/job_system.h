@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed pool of worker threads for CPU work that must stay off the render
+// thread (file reads, decompression, culling). Jobs run in submission order,
+// after any parallelFor() batches; results and exceptions come back through
+// std::future.
+class JobSystem {
+public:
+    // 0 uses one thread per hardware thread, minus the render thread.
+    explicit JobSystem(uint32_t thread_count = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+public:
+    template <typename Func>
+    auto submit(Func&& func) -> std::future<std::invoke_result_t<Func>>
+    {
+        return enqueue(jobs_, std::forward<Func>(func));
+    }
+
+    // Calls func(first, last) for consecutive batches of [0, count). The calling
+    // thread runs the last batch itself and returns when all are done, so it must
+    // not be a worker. Batches go ahead of submitted jobs, and the calling thread
+    // also runs those no worker has started, so per-frame work such as culling
+    // never waits behind long jobs like texture decoding. The first exception
+    // thrown by func is rethrown once no batch is left running.
+    template <typename Func>
+    void parallelFor(uint32_t count, uint32_t batch, Func&& func)
+    {
+        std::vector<std::future<void>> batches;
+        uint32_t first = 0;
+        for (; count - first > batch; first += batch) {
+            batches.push_back(enqueue(batches_, [&func, first, batch] { func(first, first + batch); }, &batches));
+        }
+        // The batches reference func, so none may run after this returns: on an
+        // exception the unstarted ones are dropped and the started ones awaited.
+        std::exception_ptr error;
+        try {
+            if (first < count) {
+                func(first, count);
+            }
+            while (runBatch()) {
+            }
+        } catch (...) {
+            error = std::current_exception();
+            cancelBatches(&batches);
+        }
+        for (auto& result: batches) {
+            try {
+                result.get();
+            } catch (...) {
+                // Dropped batches report a broken promise, which is not the cause.
+                if (!error) {
+                    error = std::current_exception();
+                    cancelBatches(&batches);
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    uint32_t threadCount() const { return static_cast<uint32_t>(workers_.size()); }
+    size_t pendingJobs() const;
+
+private:
+    struct Job
+    {
+        std::function<void()> run;
+        // The parallelFor() call a batch belongs to.
+        const void* owner = nullptr;
+    };
+
+    template <typename Func>
+    auto enqueue(std::deque<Job>& queue, Func&& func, const void* owner = nullptr) -> std::future<std::invoke_result_t<Func>>
+    {
+        using Result = std::invoke_result_t<Func>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard lock{mutex_};
+            queue.push_back(Job{[task] { (*task)(); }, owner});
+        }
+        condition_.notify_one();
+        return result;
+    }
+
+    // Runs the oldest parallelFor() batch no worker has taken; false if there is none.
+    bool runBatch();
+    // Drops the batches of owner no thread has taken yet.
+    void cancelBatches(const void* owner);
+    void workerLoop();
+
+private:
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    // parallelFor() batches, taken before jobs.
+    std::deque<Job> batches_;
+    std::deque<Job> jobs_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,201 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr uint8_t ktx2_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+enum Supercompression : uint32_t
+{
+    supercompression_none = 0,
+    supercompression_basis_lz = 1,
+    supercompression_zstd = 2,
+    supercompression_zlib = 3,
+};
+
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+uint32_t divideRoundUp(uint32_t value, uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+} // namespace
+
+std::optional<FormatBlock> formatBlock(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        return FormatBlock{ 4, 4, 8 };
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return FormatBlock{ 4, 4, 16 };
+    case VK_FORMAT_R8_UNORM:
+        return FormatBlock{ 1, 1, 1 };
+    case VK_FORMAT_R8G8_UNORM:
+        return FormatBlock{ 1, 1, 2 };
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return FormatBlock{ 1, 1, 4 };
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return FormatBlock{ 1, 1, 8 };
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return FormatBlock{ 1, 1, 16 };
+    default:
+        return std::nullopt;
+    }
+}
+
+VkExtent2D Ktx2Info::levelExtent(uint32_t level) const
+{
+    return { std::max(1u, width >> level), std::max(1u, height >> level) };
+}
+
+uint32_t Ktx2Info::levelRowPitch(uint32_t level) const
+{
+    return divideRoundUp(levelExtent(level).width, block.width) * block.bytes;
+}
+
+uint32_t Ktx2Info::levelBlockRows(uint32_t level) const
+{
+    return divideRoundUp(levelExtent(level).height, block.height);
+}
+
+uint64_t Ktx2Info::levelSize(uint32_t level) const
+{
+    return uint64_t(levelRowPitch(level)) * levelBlockRows(level);
+}
+
+Ktx2Info readKtx2Info(const std::string& file_path)
+{
+    std::ifstream file(file_path, std::fstream::binary | std::fstream::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + file_path);
+    }
+    const uint64_t file_size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    Ktx2Header header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.identifier, ktx2_identifier, sizeof(ktx2_identifier)) != 0) {
+        throw std::runtime_error("not a KTX2 file: " + file_path);
+    }
+    if (header.vk_format == VK_FORMAT_UNDEFINED || header.supercompression_scheme == supercompression_basis_lz) {
+        throw std::runtime_error("Basis Universal textures are not supported, transcode to BCn offline: " + file_path);
+    }
+    if (header.pixel_height == 0 || header.pixel_depth != 0 || header.layer_count > 1 || header.face_count != 1) {
+        throw std::runtime_error("only 2D textures without layers or faces can be streamed: " + file_path);
+    }
+#ifndef HAVE_ZSTD
+    if (header.supercompression_scheme == supercompression_zstd) {
+        throw std::runtime_error("zstd supercompressed texture, but this build has no zstd: " + file_path);
+    }
+#endif
+    if (header.supercompression_scheme != supercompression_none && header.supercompression_scheme != supercompression_zstd) {
+        throw std::runtime_error("unsupported KTX2 supercompression scheme " + std::to_string(header.supercompression_scheme) +
+                                 ": " + file_path);
+    }
+
+    Ktx2Info info{};
+    info.format = static_cast<VkFormat>(header.vk_format);
+    auto block = formatBlock(info.format);
+    if (!block) {
+        throw std::runtime_error("unsupported texture format " + std::to_string(header.vk_format) + ": " + file_path);
+    }
+    info.block = *block;
+    info.width = header.pixel_width;
+    info.height = header.pixel_height;
+    info.supercompression = header.supercompression_scheme;
+
+    // A level count of 0 asks the loader to generate mips; stream the base level only.
+    const uint32_t level_count = std::max(1u, header.level_count);
+    if (level_count > 32 || (std::max(header.pixel_width, header.pixel_height) >> (level_count - 1)) == 0) {
+        throw std::runtime_error("invalid KTX2 level count: " + file_path);
+    }
+    info.levels.resize(level_count);
+    if (!file.read(reinterpret_cast<char*>(info.levels.data()), level_count * sizeof(Ktx2Level))) {
+        throw std::runtime_error("truncated KTX2 level index: " + file_path);
+    }
+    for (uint32_t level = 0; level < level_count; ++level) {
+        const Ktx2Level& entry = info.levels[level];
+        if (entry.byte_offset > file_size || entry.byte_length > file_size - entry.byte_offset) {
+            throw std::runtime_error("KTX2 level " + std::to_string(level) + " is outside the file: " + file_path);
+        }
+        uint64_t expected = info.levelSize(level);
+        uint64_t stored = info.supercompression == supercompression_none ? entry.byte_length : entry.uncompressed_byte_length;
+        if (stored != expected) {
+            throw std::runtime_error("KTX2 level " + std::to_string(level) + " has an unexpected size: " + file_path);
+        }
+    }
+    return info;
+}
+
+std::vector<uint8_t> readKtx2Level(const std::string& file_path, const Ktx2Info& info, uint32_t level)
+{
+    const Ktx2Level& entry = info.levels.at(level);
+    std::ifstream file(file_path, std::fstream::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + file_path);
+    }
+    std::vector<uint8_t> stored(entry.byte_length);
+    file.seekg(static_cast<std::streamoff>(entry.byte_offset));
+    if (!file.read(reinterpret_cast<char*>(stored.data()), static_cast<std::streamsize>(stored.size()))) {
+        throw std::runtime_error("failed to read KTX2 level " + std::to_string(level) + ": " + file_path);
+    }
+    if (info.supercompression == supercompression_none) {
+        return stored;
+    }
+
+#ifdef HAVE_ZSTD
+    std::vector<uint8_t> decoded(entry.uncompressed_byte_length);
+    size_t size = ZSTD_decompress(decoded.data(), decoded.size(), stored.data(), stored.size());
+    if (ZSTD_isError(size) || size != decoded.size()) {
+        throw std::runtime_error("failed to decompress KTX2 level " + std::to_string(level) + ": " + file_path);
+    }
+    return decoded;
+#else
+    throw std::runtime_error("zstd supercompressed texture, but this build has no zstd: " + file_path);
+#endif
+}
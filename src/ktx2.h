@@ -0,0 +1,53 @@
+#pragma once
+
+#include "vulkan/vulkan_core.h"
+
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct FormatBlock
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes;
+};
+
+// Block size of the formats the texture streamer can upload: BCn and common
+// uncompressed color formats.
+std::optional<FormatBlock> formatBlock(VkFormat format);
+
+struct Ktx2Level
+{
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+
+// The parts of a KTX2 header needed to stream a 2D texture. Only the header and
+// level index are read, so this is cheap enough to do for every texture up
+// front; level data is read on demand with readKtx2Level().
+struct Ktx2Info
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    FormatBlock block{};
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t supercompression = 0;
+    // levels[0] is the full resolution image.
+    std::vector<Ktx2Level> levels;
+
+    uint32_t levelCount() const { return static_cast<uint32_t>(levels.size()); }
+    VkExtent2D levelExtent(uint32_t level) const;
+    uint32_t levelRowPitch(uint32_t level) const;
+    uint32_t levelBlockRows(uint32_t level) const;
+    uint64_t levelSize(uint32_t level) const;
+};
+
+// Throws for files this build cannot stream: cube maps, arrays, 3D textures,
+// Basis Universal payloads, and zstd supercompression without HAVE_ZSTD.
+Ktx2Info readKtx2Info(const std::string& file_path);
+// Reads one level and undoes its supercompression. Safe to call from several
+// threads at once; every call opens its own stream.
+std::vector<uint8_t> readKtx2Level(const std::string& file_path, const Ktx2Info& info, uint32_t level);
@@ -1,11 +1,11 @@
 #include "triangle.h"
 
-int main()
+int main(int argc, char** argv)
 {
     std::cout << "VULKAN_SDK: " << std::getenv("VULKAN_SDK") << std::endl;
-    TriangleApplication app;
 
     try {
+        TriangleApplication app{parseOptions(argc, argv)};
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
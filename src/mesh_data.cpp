@@ -0,0 +1,148 @@
+#include "mesh_data.h"
+
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+struct ObjIndex
+{
+    int position = 0;
+    int normal = 0;
+};
+
+// Resolves a 1-based or negative (relative) OBJ index to a 0-based one.
+int resolveIndex(int index, size_t count)
+{
+    if (index > 0) {
+        return index - 1;
+    }
+    return static_cast<int>(count) + index;
+}
+
+ObjIndex parseFaceVertex(const std::string& token)
+{
+    ObjIndex result{};
+    size_t first = token.find('/');
+    result.position = std::stoi(token.substr(0, first));
+    if (first != std::string::npos) {
+        size_t second = token.find('/', first + 1);
+        if (second != std::string::npos && second + 1 < token.size()) {
+            result.normal = std::stoi(token.substr(second + 1));
+        }
+    }
+    return result;
+}
+
+void generateNormals(MeshData& mesh)
+{
+    for (auto& vertex: mesh.vertices) {
+        vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        MeshVertex& a = mesh.vertices[mesh.indices[i]];
+        MeshVertex& b = mesh.vertices[mesh.indices[i + 1]];
+        MeshVertex& c = mesh.vertices[mesh.indices[i + 2]];
+        float e1[3] = { b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2] };
+        float e2[3] = { c.position[0] - a.position[0], c.position[1] - a.position[1], c.position[2] - a.position[2] };
+        // Area weighted: the cross product is not normalized on purpose.
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        for (MeshVertex* v: { &a, &b, &c }) {
+            v->normal[0] += n[0];
+            v->normal[1] += n[1];
+            v->normal[2] += n[2];
+        }
+    }
+    for (auto& vertex: mesh.vertices) {
+        float len = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+        if (len > 0.0f) {
+            vertex.normal[0] /= len;
+            vertex.normal[1] /= len;
+            vertex.normal[2] /= len;
+        } else {
+            vertex.normal[2] = 1.0f;
+        }
+    }
+}
+
+} // namespace
+
+MeshData loadObj(const std::string& file_path)
+{
+    std::ifstream file(file_path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + file_path);
+    }
+
+    std::vector<std::array<float, 7>> positions;
+    std::vector<std::array<float, 3>> normals;
+    std::unordered_map<uint64_t, uint32_t> vertex_map;
+    MeshData mesh{};
+    bool has_normals = true;
+
+    std::string line;
+    std::vector<uint32_t> polygon;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        std::istringstream stream(line);
+        std::string tag;
+        stream >> tag;
+        if (tag == "v") {
+            std::array<float, 7> p = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+            stream >> p[0] >> p[1] >> p[2];
+            float r, g, b;
+            if (stream >> r >> g >> b) {
+                p[3] = r;
+                p[4] = g;
+                p[5] = b;
+            }
+            positions.push_back(p);
+        } else if (tag == "vn") {
+            std::array<float, 3> n{};
+            stream >> n[0] >> n[1] >> n[2];
+            normals.push_back(n);
+        } else if (tag == "f") {
+            polygon.clear();
+            std::string token;
+            while (stream >> token) {
+                ObjIndex index = parseFaceVertex(token);
+                int p = resolveIndex(index.position, positions.size());
+                int n = index.normal != 0 ? resolveIndex(index.normal, normals.size()) : -1;
+                if (p < 0 || p >= static_cast<int>(positions.size()) || n >= static_cast<int>(normals.size())) {
+                    throw std::runtime_error(file_path + ":" + std::to_string(line_number) + ": face index out of range");
+                }
+                has_normals = has_normals && n >= 0;
+                uint64_t key = (static_cast<uint64_t>(p) << 32) | static_cast<uint32_t>(n);
+                auto [it, inserted] = vertex_map.emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+                if (inserted) {
+                    MeshVertex vertex{};
+                    for (int i = 0; i < 3; ++i) {
+                        vertex.position[i] = positions[p][i];
+                        vertex.normal[i] = n >= 0 ? normals[n][i] : 0.0f;
+                        vertex.color[i] = positions[p][3 + i];
+                    }
+                    vertex.color[3] = 1.0f;
+                    mesh.vertices.push_back(vertex);
+                }
+                polygon.push_back(it->second);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[i - 1]);
+                mesh.indices.push_back(polygon[i]);
+            }
+        }
+    }
+    if (mesh.indices.empty()) {
+        throw std::runtime_error("no faces found in: " + file_path);
+    }
+    if (!has_normals) {
+        generateNormals(mesh);
+    }
+    return mesh;
+}
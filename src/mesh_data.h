@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float color[4];
+};
+
+struct MeshData
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// Reads positions, normals and per-vertex colors ("v x y z r g b") from a
+// Wavefront OBJ file. Polygons are triangulated as fans and vertices are
+// deduplicated on their position/normal pair. Missing normals are generated
+// from the faces.
+MeshData loadObj(const std::string& file_path);
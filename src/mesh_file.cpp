@@ -0,0 +1,254 @@
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr char mesh_file_magic[4] = { 'M', 'S', 'H', '1' };
+constexpr uint32_t mesh_file_version = 1;
+constexpr size_t mesh_file_alignment = 16;
+
+size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Bytes per element of the formats packMesh() writes, used to check the
+// attribute table of a file before its layout is handed to the pipeline.
+uint32_t formatSize(uint32_t format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R32_SFLOAT:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_SNORM:
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        return 12;
+    default:
+        return 0;
+    }
+}
+
+// Formats mesh.vert reads its inputs with, by location: the UNORM16 position it
+// decodes with the push constant offset and scale, the octahedral normal and
+// the color.
+constexpr uint32_t mesh_shader_formats[] = { VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16_SNORM, VK_FORMAT_R8G8B8A8_UNORM };
+constexpr uint32_t mesh_shader_location_count = static_cast<uint32_t>(std::size(mesh_shader_formats));
+
+template <typename Index>
+bool indicesInRange(const void* data, uint32_t index_count, uint32_t vertex_count)
+{
+    const Index* indices = static_cast<const Index*>(data);
+    Index max_index = 0;
+    for (uint32_t i = 0; i < index_count; ++i) {
+        max_index = std::max(max_index, indices[i]);
+    }
+    return index_count == 0 || max_index < vertex_count;
+}
+
+float clampUnit(float value)
+{
+    return std::min(1.0f, std::max(-1.0f, value));
+}
+
+} // namespace
+
+void encodeOctahedral(const float normal[3], int16_t encoded[2])
+{
+    float l1 = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+    float x = l1 > 0.0f ? normal[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? normal[1] / l1 : 0.0f;
+    // The lower hemisphere is folded over the diagonals of the square.
+    if (l1 > 0.0f && normal[2] < 0.0f) {
+        float folded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    encoded[0] = static_cast<int16_t>(std::lround(clampUnit(x) * 32767.0f));
+    encoded[1] = static_cast<int16_t>(std::lround(clampUnit(y) * 32767.0f));
+}
+
+void decodeOctahedral(const int16_t encoded[2], float normal[3])
+{
+    // Same as octDecode() in mesh.vert.
+    float x = std::max(encoded[0] / 32767.0f, -1.0f);
+    float y = std::max(encoded[1] / 32767.0f, -1.0f);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+void unpackPosition(const MeshFileHeader& header, const PackedVertex& vertex, float position[3])
+{
+    for (int c = 0; c < 3; ++c) {
+        position[c] = header.position_offset[c] + vertex.position[c] / 65535.0f * header.position_scale[c];
+    }
+}
+
+PackedMesh packMesh(const MeshData& mesh)
+{
+    if (mesh.vertices.empty() || mesh.indices.empty()) {
+        throw std::invalid_argument("cannot pack an empty mesh");
+    }
+    PackedMesh result{};
+    MeshFileHeader& header = result.header;
+    std::memcpy(header.magic, mesh_file_magic, sizeof(header.magic));
+    header.version = mesh_file_version;
+    header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    header.index_count = static_cast<uint32_t>(mesh.indices.size());
+    header.index_size = mesh.vertices.size() <= 0x10000 ? 2 : 4;
+    header.vertex_stride = sizeof(PackedVertex);
+    header.attribute_count = 3;
+    header.attributes[0] = { 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedVertex, position) };
+    header.attributes[1] = { 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal) };
+    header.attributes[2] = { 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color) };
+
+    float min_corner[3];
+    float max_corner[3];
+    std::copy(mesh.vertices[0].position, mesh.vertices[0].position + 3, min_corner);
+    std::copy(mesh.vertices[0].position, mesh.vertices[0].position + 3, max_corner);
+    for (const MeshVertex& vertex: mesh.vertices) {
+        for (int c = 0; c < 3; ++c) {
+            min_corner[c] = std::min(min_corner[c], vertex.position[c]);
+            max_corner[c] = std::max(max_corner[c], vertex.position[c]);
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        header.position_offset[c] = min_corner[c];
+        header.position_scale[c] = max_corner[c] - min_corner[c];
+        header.center[c] = (min_corner[c] + max_corner[c]) * 0.5f;
+    }
+
+    result.vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        const MeshVertex& in = mesh.vertices[i];
+        PackedVertex& out = result.vertices[i];
+        for (int c = 0; c < 3; ++c) {
+            float range = header.position_scale[c];
+            float unorm = range > 0.0f ? (in.position[c] - header.position_offset[c]) / range : 0.0f;
+            out.position[c] = static_cast<uint16_t>(std::lround(std::min(1.0f, std::max(0.0f, unorm)) * 65535.0f));
+        }
+        out.position[3] = 0;
+        encodeOctahedral(in.normal, out.normal);
+        for (int c = 0; c < 4; ++c) {
+            out.color[c] = static_cast<uint8_t>(std::lround(std::min(1.0f, std::max(0.0f, in.color[c])) * 255.0f));
+        }
+        float dx = in.position[0] - header.center[0];
+        float dy = in.position[1] - header.center[1];
+        float dz = in.position[2] - header.center[2];
+        header.radius = std::max(header.radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+
+    result.indices.resize(mesh.indices.size() * header.index_size);
+    if (header.index_size == 2) {
+        uint16_t* out = reinterpret_cast<uint16_t*>(result.indices.data());
+        for (size_t i = 0; i < mesh.indices.size(); ++i) {
+            out[i] = static_cast<uint16_t>(mesh.indices[i]);
+        }
+    } else {
+        std::memcpy(result.indices.data(), mesh.indices.data(), result.indices.size());
+    }
+    header.vertex_data_offset = alignUp(sizeof(MeshFileHeader), mesh_file_alignment);
+    header.index_data_offset = alignUp(header.vertex_data_offset + result.vertices.size() * sizeof(PackedVertex), mesh_file_alignment);
+    return result;
+}
+
+void writeMeshFile(const std::string& file_path, const PackedMesh& mesh)
+{
+    const MeshFileHeader& header = mesh.header;
+    std::vector<uint8_t> out(header.index_data_offset + mesh.indices.size(), 0);
+    std::memcpy(out.data(), &header, sizeof(header));
+    std::memcpy(out.data() + header.vertex_data_offset, mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex));
+    std::memcpy(out.data() + header.index_data_offset, mesh.indices.data(), mesh.indices.size());
+    utils::writeFile(file_path, out.data(), out.size());
+}
+
+MeshFile::MeshFile(const std::string& file_path)
+    : file_{file_path}
+{
+    if (file_.size() < sizeof(MeshFileHeader)) {
+        throw std::runtime_error("truncated mesh file: " + file_path);
+    }
+    std::memcpy(&header_, file_.data(), sizeof(header_));
+    if (std::memcmp(header_.magic, mesh_file_magic, sizeof(header_.magic)) != 0 || header_.version != mesh_file_version) {
+        throw std::runtime_error("not a mesh file or unsupported version: " + file_path);
+    }
+    if ((header_.index_size != 2 && header_.index_size != 4) || header_.index_count % 3 != 0 || header_.index_count == 0 ||
+        header_.vertex_count == 0 || header_.attribute_count == 0 || header_.attribute_count > mesh_file_max_attributes) {
+        throw std::runtime_error("invalid mesh file header: " + file_path);
+    }
+    uint32_t locations = 0;
+    for (uint32_t i = 0; i < header_.attribute_count; ++i) {
+        const MeshFileAttribute& attribute = header_.attributes[i];
+        uint32_t size = formatSize(attribute.format);
+        if (size == 0 || size_t(attribute.offset) + size > header_.vertex_stride) {
+            throw std::runtime_error("invalid vertex attribute " + std::to_string(i) + " in mesh file: " + file_path);
+        }
+        if (attribute.location >= mesh_shader_location_count || attribute.format != mesh_shader_formats[attribute.location]) {
+            throw std::runtime_error("vertex attribute " + std::to_string(i) + " does not match the mesh shader inputs: " + file_path);
+        }
+        if (locations & (1u << attribute.location)) {
+            throw std::runtime_error("duplicate vertex attribute location " + std::to_string(attribute.location) +
+                                     " in mesh file: " + file_path);
+        }
+        locations |= 1u << attribute.location;
+    }
+    if (locations != (1u << mesh_shader_location_count) - 1) {
+        throw std::runtime_error("mesh file lacks vertex attributes the mesh shader reads: " + file_path);
+    }
+    if (header_.vertex_data_offset % mesh_file_alignment != 0 || header_.index_data_offset % mesh_file_alignment != 0 ||
+        header_.vertex_data_offset > file_.size() || vertexDataSize() > file_.size() - header_.vertex_data_offset ||
+        header_.index_data_offset > file_.size() || indexDataSize() > file_.size() - header_.index_data_offset) {
+        throw std::runtime_error("mesh file data is out of bounds: " + file_path);
+    }
+    // Out of range indices would make the GPU fetch outside the vertex buffer.
+    bool in_range = header_.index_size == 2
+        ? indicesInRange<uint16_t>(indexData(), header_.index_count, header_.vertex_count)
+        : indicesInRange<uint32_t>(indexData(), header_.index_count, header_.vertex_count);
+    if (!in_range) {
+        throw std::runtime_error("mesh file index out of range: " + file_path);
+    }
+}
+
+VkVertexInputBindingDescription meshVertexBinding(const MeshFileHeader& header, uint32_t binding)
+{
+    VkVertexInputBindingDescription description{};
+    description.binding = binding;
+    description.stride = header.vertex_stride;
+    description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return description;
+}
+
+std::vector<VkVertexInputAttributeDescription> meshVertexAttributes(const MeshFileHeader& header, uint32_t binding)
+{
+    std::vector<VkVertexInputAttributeDescription> descriptions;
+    for (uint32_t i = 0; i < header.attribute_count; ++i) {
+        VkVertexInputAttributeDescription description{};
+        description.location = header.attributes[i].location;
+        description.binding = binding;
+        description.format = static_cast<VkFormat>(header.attributes[i].format);
+        description.offset = header.attributes[i].offset;
+        descriptions.push_back(description);
+    }
+    return descriptions;
+}
+
+VkIndexType meshIndexType(const MeshFileHeader& header)
+{
+    return header.index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
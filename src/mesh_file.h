@@ -0,0 +1,93 @@
+#pragma once
+
+#include "mesh_data.h"
+#include "utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+constexpr uint32_t mesh_file_max_attributes = 4;
+
+struct MeshFileAttribute
+{
+    uint32_t location;
+    // VkFormat the attribute is fetched with.
+    uint32_t format;
+    uint32_t offset;
+};
+
+// Header of the binary mesh files written by meshtool. Vertex and index data
+// follow at 16 byte aligned offsets, already in the layout the GPU reads, so
+// loading is a memory map and a copy into the upload buffer.
+struct MeshFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    // 2 or 4 bytes per index.
+    uint32_t index_size;
+    uint32_t vertex_stride;
+    uint32_t attribute_count;
+    MeshFileAttribute attributes[mesh_file_max_attributes];
+    // Positions are stored as UNORM16; the object space position is
+    // position_offset + unorm * position_scale.
+    float position_offset[3];
+    float position_scale[3];
+    // Bounding sphere, for placing the camera.
+    float center[3];
+    float radius;
+    uint64_t vertex_data_offset;
+    uint64_t index_data_offset;
+};
+
+// Quantized vertex written by packMesh(): 16 bytes instead of the 40 of MeshVertex.
+struct PackedVertex
+{
+    uint16_t position[4];
+    // Octahedral encoding of the unit normal, SNORM16.
+    int16_t normal[2];
+    uint8_t color[4];
+};
+
+struct PackedMesh
+{
+    MeshFileHeader header;
+    std::vector<PackedVertex> vertices;
+    // index_size bytes per index.
+    std::vector<uint8_t> indices;
+};
+
+// Quantizes the vertices and picks 16-bit indices when the vertex count allows.
+// Does not reorder anything; run the mesh optimizer first.
+PackedMesh packMesh(const MeshData& mesh);
+void writeMeshFile(const std::string& file_path, const PackedMesh& mesh);
+
+void encodeOctahedral(const float normal[3], int16_t encoded[2]);
+void decodeOctahedral(const int16_t encoded[2], float normal[3]);
+void unpackPosition(const MeshFileHeader& header, const PackedVertex& vertex, float position[3]);
+
+// A mesh file mapped into memory. The constructor only validates the header,
+// its attribute table against the inputs of mesh.vert, and the index range;
+// vertex and index data are handed out as they are stored.
+class MeshFile {
+public:
+    explicit MeshFile(const std::string& file_path);
+
+    const MeshFileHeader& header() const { return header_; }
+    const void* vertexData() const { return file_.data() + header_.vertex_data_offset; }
+    size_t vertexDataSize() const { return size_t(header_.vertex_count) * header_.vertex_stride; }
+    const void* indexData() const { return file_.data() + header_.index_data_offset; }
+    size_t indexDataSize() const { return size_t(header_.index_count) * header_.index_size; }
+
+private:
+    utils::MappedFile file_;
+    MeshFileHeader header_{};
+};
+
+// Vertex input state for binding the file's vertex data as one interleaved buffer.
+VkVertexInputBindingDescription meshVertexBinding(const MeshFileHeader& header, uint32_t binding);
+std::vector<VkVertexInputAttributeDescription> meshVertexAttributes(const MeshFileHeader& header, uint32_t binding);
+VkIndexType meshIndexType(const MeshFileHeader& header);
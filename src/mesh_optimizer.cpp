@@ -0,0 +1,212 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Tuning from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation". The
+// modelled cache is an LRU larger than any real FIFO so the order also works
+// well on hardware with bigger caches.
+constexpr size_t model_cache_size = 32;
+constexpr float cache_decay_power = 1.5f;
+constexpr float last_triangle_score = 0.75f;
+constexpr float valence_boost_scale = 2.0f;
+constexpr float valence_boost_power = 0.5f;
+constexpr uint32_t no_triangle = ~0u;
+
+float vertexScore(int cache_position, uint32_t remaining_triangles)
+{
+    if (remaining_triangles == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        // The three vertices of the last triangle get a fixed score so the next
+        // triangle does not simply reuse the same edge in a strip.
+        if (cache_position < 3) {
+            score = last_triangle_score;
+        } else {
+            float scaler = 1.0f - static_cast<float>(cache_position - 3) / (model_cache_size - 3);
+            score = std::pow(scaler, cache_decay_power);
+        }
+    }
+    // Vertices with few triangles left are finished off first so they can leave the cache.
+    score += valence_boost_scale * std::pow(static_cast<float>(remaining_triangles), -valence_boost_power);
+    return score;
+}
+
+void checkIndices(const uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+    if (index_count % 3 != 0) {
+        throw std::invalid_argument("index count is not a multiple of 3");
+    }
+    for (size_t i = 0; i < index_count; ++i) {
+        if (indices[i] >= vertex_count) {
+            throw std::invalid_argument("index out of range: " + std::to_string(indices[i]));
+        }
+    }
+}
+
+} // namespace
+
+void optimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+    checkIndices(indices, index_count, vertex_count);
+    const size_t triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // Vertex -> triangle adjacency. The first remaining[v] entries of a vertex's
+    // range are the triangles not emitted yet.
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (size_t i = 0; i < index_count; ++i) {
+        ++offsets[indices[i] + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    std::vector<uint32_t> adjacency(index_count);
+    for (size_t i = 0; i < index_count; ++i) {
+        uint32_t v = indices[i];
+        adjacency[offsets[v] + remaining[v]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        vertex_score[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    uint32_t best = no_triangle;
+    float best_score = -1.0f;
+    for (size_t t = 0; t < triangle_count; ++t) {
+        const uint32_t* tri = &indices[t * 3];
+        triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+        if (triangle_score[t] > best_score) {
+            best_score = triangle_score[t];
+            best = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(index_count);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    cache.reserve(model_cache_size + 3);
+    new_cache.reserve(model_cache_size + 3);
+    size_t next_unemitted = 0;
+
+    for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        // Nothing in the cache has triangles left: continue with the first
+        // triangle in input order, which keeps the input's locality.
+        if (best == no_triangle) {
+            while (emitted[next_unemitted]) {
+                ++next_unemitted;
+            }
+            best = static_cast<uint32_t>(next_unemitted);
+        }
+        const uint32_t tri[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+        result.insert(result.end(), tri, tri + 3);
+        emitted[best] = true;
+
+        for (uint32_t v: tri) {
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            uint32_t* it = std::find(begin, end, best);
+            if (it != end) {
+                *it = *(end - 1);
+                --remaining[v];
+            }
+        }
+
+        new_cache.assign(tri, tri + 3);
+        for (uint32_t v: cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < new_cache.size(); ++i) {
+            uint32_t v = new_cache[i];
+            cache_position[v] = i < model_cache_size ? static_cast<int>(i) : -1;
+            vertex_score[v] = vertexScore(cache_position[v], remaining[v]);
+        }
+
+        // Only triangles touching the cache changed score; the best of them is
+        // the next one to emit.
+        best = no_triangle;
+        best_score = -1.0f;
+        for (uint32_t v: new_cache) {
+            for (uint32_t i = 0; i < remaining[v]; ++i) {
+                uint32_t t = adjacency[offsets[v] + i];
+                const uint32_t* other = &indices[t * 3];
+                triangle_score[t] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+        if (new_cache.size() > model_cache_size) {
+            new_cache.resize(model_cache_size);
+        }
+        cache.swap(new_cache);
+    }
+    std::memcpy(indices, result.data(), index_count * sizeof(uint32_t));
+}
+
+size_t optimizeVertexFetch(void* vertices, uint32_t* indices, size_t index_count, size_t vertex_count, size_t vertex_size)
+{
+    checkIndices(indices, index_count, vertex_count);
+    constexpr uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertex_count, unused);
+    uint32_t next = 0;
+    for (size_t i = 0; i < index_count; ++i) {
+        uint32_t& target = remap[indices[i]];
+        if (target == unused) {
+            target = next++;
+        }
+        indices[i] = target;
+    }
+
+    uint8_t* data = static_cast<uint8_t*>(vertices);
+    std::vector<uint8_t> original(data, data + vertex_count * vertex_size);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        if (remap[v] != unused) {
+            std::memcpy(data + remap[v] * vertex_size, original.data() + v * vertex_size, vertex_size);
+        }
+    }
+    return next;
+}
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size)
+{
+    checkIndices(indices, index_count, vertex_count);
+    // A vertex is in the FIFO if fewer than cache_size misses happened since it was loaded.
+    std::vector<uint32_t> loaded_at(vertex_count, 0);
+    std::vector<bool> referenced(vertex_count, false);
+    uint32_t timestamp = cache_size + 1;
+    size_t misses = 0;
+    size_t unique_vertices = 0;
+    for (size_t i = 0; i < index_count; ++i) {
+        uint32_t v = indices[i];
+        if (timestamp - loaded_at[v] > cache_size) {
+            loaded_at[v] = timestamp++;
+            ++misses;
+        }
+        if (!referenced[v]) {
+            referenced[v] = true;
+            ++unique_vertices;
+        }
+    }
+    VertexCacheStats stats{};
+    stats.acmr = index_count ? static_cast<float>(misses) / (index_count / 3) : 0.0f;
+    stats.atvr = unique_vertices ? static_cast<float>(misses) / unique_vertices : 0.0f;
+    return stats;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct VertexCacheStats
+{
+    // Average cache miss ratio: vertex shader invocations per triangle. 0.5 is
+    // the ideal for a regular grid, 3 means no reuse at all.
+    float acmr;
+    // Average transform to vertex ratio: invocations per referenced vertex, 1 is ideal.
+    float atvr;
+};
+
+// Reorders triangles so consecutive ones share vertices still in the
+// post-transform cache, using Forsyth's linear-speed cache optimization. The
+// triangles keep their winding; the vertex buffer is not touched.
+void optimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count);
+
+// Renumbers vertices in the order the indices first reference them and moves
+// the vertex data accordingly, so vertex fetch walks memory front to back.
+// Unreferenced vertices are dropped. Returns the new vertex count.
+size_t optimizeVertexFetch(void* vertices, uint32_t* indices, size_t index_count, size_t vertex_count, size_t vertex_size);
+
+// Simulates a FIFO post-transform cache of cache_size entries.
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size = 16);
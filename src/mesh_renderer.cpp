@@ -0,0 +1,348 @@
+#include "mesh_renderer.h"
+
+#include "utils.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Matches MeshDecode in mesh.vert.
+struct MeshPushConstants
+{
+    float position_offset[4];
+    float position_scale[4];
+    // Pushed on its own for every instance.
+    float model[16];
+};
+
+// Matches Material in mesh.vert, one per material_stride bytes of the buffer.
+struct MaterialUniforms
+{
+    float color[4];
+};
+
+// The largest minUniformBufferOffsetAlignment a device may require.
+constexpr VkDeviceSize material_stride = 256;
+
+constexpr float material_colors[MeshRenderer::material_count][4] = {
+    { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.9f, 0.4f, 0.3f, 1.0f }, { 0.4f, 0.8f, 0.4f, 1.0f }, { 0.3f, 0.5f, 0.9f, 1.0f },
+    { 0.9f, 0.8f, 0.3f, 1.0f }, { 0.7f, 0.4f, 0.9f, 1.0f }, { 0.3f, 0.8f, 0.8f, 1.0f }, { 0.6f, 0.6f, 0.6f, 1.0f },
+};
+
+constexpr Mat4 identity_transform{ { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                     0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+
+std::string shaderPath(const char* name)
+{
+#if defined(_WIN32)
+    return std::string("shaders\\") + name;
+#else
+    return std::string("shaders/") + name;
+#endif
+}
+
+} // namespace
+
+MeshRenderer::MeshRenderer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                           VkCommandPool command_pool, VkPipelineCache pipeline_cache, VkRenderPass render_pass,
+                           VkDescriptorSetLayout frame_set_layout, const MeshFile& mesh)
+    : device_{device}
+    , header_{mesh.header()}
+{
+    try {
+        // The mapped file pages are read straight into the staging buffer.
+        vertex_buffer_ = utils::createDeviceLocalBuffer(device_, mem_props, queue, command_pool, mesh.vertexData(),
+                                                        mesh.vertexDataSize(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        index_buffer_ = utils::createDeviceLocalBuffer(device_, mem_props, queue, command_pool, mesh.indexData(),
+                                                       mesh.indexDataSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        createMaterials(mem_props, queue, command_pool);
+        createPipelines(pipeline_cache, render_pass, frame_set_layout);
+    } catch (...) {
+        release();
+        throw;
+    }
+    std::cout << "Mesh renderer created: " << header_.vertex_count << " vertices, " << triangleCount() << " triangles, "
+              << header_.vertex_stride << " byte vertices, " << header_.index_size * 8 << "-bit indices" << std::endl;
+}
+
+MeshRenderer::~MeshRenderer()
+{
+    release();
+}
+
+void MeshRenderer::release()
+{
+    for (VkPipeline& pipeline: pipelines_) {
+        vkDestroyPipeline(device_, pipeline, nullptr);
+        pipeline = VK_NULL_HANDLE;
+    }
+    vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+    vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+    vkDestroyDescriptorSetLayout(device_, material_set_layout_, nullptr);
+    pipeline_layout_ = VK_NULL_HANDLE;
+    descriptor_pool_ = VK_NULL_HANDLE;
+    material_set_layout_ = VK_NULL_HANDLE;
+    utils::destroyBuffer(device_, material_buffer_);
+    utils::destroyBuffer(device_, index_buffer_);
+    utils::destroyBuffer(device_, vertex_buffer_);
+}
+
+VkShaderModule MeshRenderer::loadShaderModule(const char* name)
+{
+    std::vector<char> code = utils::readFile(shaderPath(name));
+    VkShaderModuleCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = code.size();
+    create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+    VkResult res = vkCreateShaderModule(device_, &create_info, nullptr, &shader_module);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error(std::string("failed to create shader module ") + name + ", error: " + std::to_string(res));
+    }
+    return shader_module;
+}
+
+void MeshRenderer::createMaterials(const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue, VkCommandPool command_pool)
+{
+    std::vector<char> data(material_stride * material_count);
+    for (uint32_t m = 0; m < material_count; ++m) {
+        MaterialUniforms material{};
+        for (int c = 0; c < 4; ++c) {
+            material.color[c] = material_colors[m][c];
+        }
+        std::memcpy(data.data() + m * material_stride, &material, sizeof(material));
+    }
+    material_buffer_ = utils::createDeviceLocalBuffer(device_, mem_props, queue, command_pool, data.data(), data.size(),
+                                                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 1;
+    layout_info.pBindings = &binding;
+    VkResult res = vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &material_set_layout_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create material descriptor set layout, error: " + std::to_string(res));
+    }
+
+    VkDescriptorPoolSize pool_size{};
+    pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    pool_size.descriptorCount = material_count;
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = material_count;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    res = vkCreateDescriptorPool(device_, &pool_info, nullptr, &descriptor_pool_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create material descriptor pool, error: " + std::to_string(res));
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(material_count, material_set_layout_);
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool_;
+    alloc_info.descriptorSetCount = material_count;
+    alloc_info.pSetLayouts = layouts.data();
+    res = vkAllocateDescriptorSets(device_, &alloc_info, material_sets_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate material descriptor sets, error: " + std::to_string(res));
+    }
+
+    VkDescriptorBufferInfo buffer_infos[material_count]{};
+    VkWriteDescriptorSet writes[material_count]{};
+    for (uint32_t m = 0; m < material_count; ++m) {
+        buffer_infos[m] = { material_buffer_.buffer, m * material_stride, sizeof(MaterialUniforms) };
+        writes[m].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[m].dstSet = material_sets_[m];
+        writes[m].dstBinding = 0;
+        writes[m].descriptorCount = 1;
+        writes[m].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[m].pBufferInfo = &buffer_infos[m];
+    }
+    vkUpdateDescriptorSets(device_, material_count, writes, 0, nullptr);
+}
+
+void MeshRenderer::createPipelines(VkPipelineCache pipeline_cache, VkRenderPass render_pass, VkDescriptorSetLayout frame_set_layout)
+{
+    const VkDescriptorSetLayout set_layouts[] = { frame_set_layout, material_set_layout_ };
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(MeshPushConstants);
+
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 2;
+    layout_info.pSetLayouts = set_layouts;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    VkResult res = vkCreatePipelineLayout(device_, &layout_info, nullptr, &pipeline_layout_);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create mesh pipeline layout, error: " + std::to_string(res));
+    }
+
+    VkShaderModule vert_module = loadShaderModule("mesh_vert.spv");
+    VkShaderModule frag_module = VK_NULL_HANDLE;
+    try {
+        frag_module = loadShaderModule("frag.spv");
+    } catch (...) {
+        vkDestroyShaderModule(device_, vert_module, nullptr);
+        throw;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert_module;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag_module;
+    stages[1].pName = "main";
+
+    VkDynamicState dynamic_states[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamic_state_info{};
+    dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state_info.dynamicStateCount = 2;
+    dynamic_state_info.pDynamicStates = dynamic_states;
+
+    VkVertexInputBindingDescription vertex_binding = meshVertexBinding(header_, 0);
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes = meshVertexAttributes(header_, 0);
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_state_info{};
+    vertex_input_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_state_info.vertexBindingDescriptionCount = 1;
+    vertex_input_state_info.pVertexBindingDescriptions = &vertex_binding;
+    vertex_input_state_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_attributes.size());
+    vertex_input_state_info.pVertexAttributeDescriptions = vertex_attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_state_info{};
+    input_assembly_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly_state_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly_state_info.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewport_state_info{};
+    viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state_info.viewportCount = 1;
+    viewport_state_info.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer_info{};
+    rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer_info.lineWidth = 1.0f;
+    rasterizer_info.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisample_state_info{};
+    multisample_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample_state_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisample_state_info.minSampleShading = 1.0f;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment{};
+    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo color_blend_info{};
+    color_blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend_info.logicOpEnable = VK_FALSE;
+    color_blend_info.attachmentCount = 1;
+    color_blend_info.pAttachments = &color_blend_attachment;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info{};
+    depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil_info.depthTestEnable = VK_TRUE;
+    depth_stencil_info.depthWriteEnable = VK_TRUE;
+    depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkGraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = &vertex_input_state_info;
+    pipeline_info.pInputAssemblyState = &input_assembly_state_info;
+    pipeline_info.pViewportState = &viewport_state_info;
+    pipeline_info.pRasterizationState = &rasterizer_info;
+    pipeline_info.pMultisampleState = &multisample_state_info;
+    pipeline_info.pDepthStencilState = &depth_stencil_info;
+    pipeline_info.pColorBlendState = &color_blend_info;
+    pipeline_info.pDynamicState = &dynamic_state_info;
+    pipeline_info.layout = pipeline_layout_;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+    pipeline_info.basePipelineIndex = -1;
+
+    // One pipeline per cull mode; two-sided materials draw back faces too.
+    const VkCullModeFlags cull_modes[pipeline_count] = { VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_NONE };
+    for (uint32_t p = 0; p < pipeline_count && res == VK_SUCCESS; ++p) {
+        rasterizer_info.cullMode = cull_modes[p];
+        res = vkCreateGraphicsPipelines(device_, pipeline_cache, 1, &pipeline_info, nullptr, &pipelines_[p]);
+    }
+    vkDestroyShaderModule(device_, frag_module, nullptr);
+    vkDestroyShaderModule(device_, vert_module, nullptr);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create mesh pipeline, error: " + std::to_string(res));
+    }
+}
+
+void MeshRenderer::recordDraw(VkCommandBuffer command_buffer, VkDescriptorSet frame_set, uint32_t frame_uniforms_offset)
+{
+    recordBindFrame(command_buffer, frame_set, frame_uniforms_offset);
+    recordBindPipeline(command_buffer, 0);
+    recordBindMaterial(command_buffer, 0);
+    recordBindMesh(command_buffer);
+    recordInstance(command_buffer, identity_transform);
+}
+
+void MeshRenderer::recordBindFrame(VkCommandBuffer command_buffer, VkDescriptorSet frame_set, uint32_t frame_uniforms_offset)
+{
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &frame_set,
+                            1, &frame_uniforms_offset);
+}
+
+void MeshRenderer::recordBindPipeline(VkCommandBuffer command_buffer, uint32_t pipeline)
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines_[pipeline]);
+}
+
+void MeshRenderer::recordBindMaterial(VkCommandBuffer command_buffer, uint32_t material)
+{
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 1, 1, &material_sets_[material],
+                            0, nullptr);
+}
+
+void MeshRenderer::recordBindMesh(VkCommandBuffer command_buffer)
+{
+    MeshPushConstants push_constants{};
+    for (int c = 0; c < 3; ++c) {
+        push_constants.position_offset[c] = header_.position_offset[c];
+        push_constants.position_scale[c] = header_.position_scale[c];
+    }
+    vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       offsetof(MeshPushConstants, model), &push_constants);
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer_.buffer, &offset);
+    vkCmdBindIndexBuffer(command_buffer, index_buffer_.buffer, 0, meshIndexType(header_));
+}
+
+void MeshRenderer::recordInstance(VkCommandBuffer command_buffer, const Mat4& model)
+{
+    vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, offsetof(MeshPushConstants, model),
+                       sizeof(model.m), model.m);
+    vkCmdDrawIndexed(command_buffer, header_.index_count, 1, 0, 0, 0);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "camera.h"
+#include "mesh_file.h"
+#include "scene.h"
+#include "vk_utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <stdint.h>
+
+// Draws a mesh file written by meshtool. Vertex and index data are uploaded as
+// stored; the vertex input layout comes from the file's attribute table and the
+// shader decodes the quantized attributes.
+//
+// Materials tint the mesh. Odd materials are two-sided and use the pipeline
+// that does not cull back faces; both pipelines share one layout, with the
+// frame set at set 0 and the material at set 1.
+class MeshRenderer {
+public:
+    static constexpr uint32_t material_count = scene_material_count;
+    static constexpr uint32_t pipeline_count = scene_pipeline_count;
+
+public:
+    // frame_set_layout is the application's set 0 layout holding FrameUniforms
+    // with a dynamic offset at binding 0.
+    MeshRenderer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                 VkCommandPool command_pool, VkPipelineCache pipeline_cache, VkRenderPass render_pass,
+                 VkDescriptorSetLayout frame_set_layout, const MeshFile& mesh);
+    ~MeshRenderer();
+    MeshRenderer(const MeshRenderer&) = delete;
+    MeshRenderer& operator=(const MeshRenderer&) = delete;
+
+public:
+    // Must be recorded inside the render pass, after viewport and scissor are set.
+    void recordDraw(VkCommandBuffer command_buffer, VkDescriptorSet frame_set, uint32_t frame_uniforms_offset);
+    // Separate binds for drawing many instances: the frame set once, then
+    // pipeline, material and mesh whenever they change, then recordInstance().
+    void recordBindFrame(VkCommandBuffer command_buffer, VkDescriptorSet frame_set, uint32_t frame_uniforms_offset);
+    void recordBindPipeline(VkCommandBuffer command_buffer, uint32_t pipeline);
+    void recordBindMaterial(VkCommandBuffer command_buffer, uint32_t material);
+    void recordBindMesh(VkCommandBuffer command_buffer);
+    void recordInstance(VkCommandBuffer command_buffer, const Mat4& model);
+
+    uint32_t triangleCount() const { return header_.index_count / 3; }
+    // Bounding sphere of the mesh, for placing the camera.
+    const float* center() const { return header_.center; }
+    float radius() const { return header_.radius; }
+
+private:
+    void release();
+    void createMaterials(const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue, VkCommandPool command_pool);
+    void createPipelines(VkPipelineCache pipeline_cache, VkRenderPass render_pass, VkDescriptorSetLayout frame_set_layout);
+    VkShaderModule loadShaderModule(const char* name);
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    MeshFileHeader header_{};
+    utils::Buffer vertex_buffer_;
+    utils::Buffer index_buffer_;
+    utils::Buffer material_buffer_;
+    VkDescriptorSetLayout material_set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+    VkDescriptorSet material_sets_[material_count] = {};
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline pipelines_[pipeline_count] = {};
+};
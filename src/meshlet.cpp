@@ -0,0 +1,403 @@
+#include "meshlet.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+constexpr char meshlet_file_magic[4] = { 'M', 'L', 'T', '1' };
+constexpr uint32_t meshlet_file_version = 1;
+
+struct MeshletFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t meshlet_count;
+    uint32_t vertex_count;
+    uint32_t vertex_index_count;
+    uint32_t triangle_index_count;
+    uint32_t max_vertices;
+    uint32_t max_triangles;
+};
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+Vec3 operator-(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+Vec3 operator+(Vec3 a, Vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+Vec3 operator*(Vec3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+Vec3 cross(Vec3 a, Vec3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+float length(Vec3 a) { return std::sqrt(dot(a, a)); }
+
+Vec3 normalize(Vec3 a)
+{
+    float len = length(a);
+    return len > 0.0f ? a * (1.0f / len) : Vec3{ 0.0f, 0.0f, 0.0f };
+}
+
+Vec3 loadPosition(const float* positions, uint32_t index)
+{
+    return { positions[index * 3 + 0], positions[index * 3 + 1], positions[index * 3 + 2] };
+}
+
+// Ritter's bounding sphere: not minimal, but within a few percent and linear.
+void computeSphere(const std::vector<Vec3>& points, MeshletBounds& bounds)
+{
+    auto farthest = [&](Vec3 from) {
+        size_t best = 0;
+        float best_distance = -1.0f;
+        for (size_t i = 0; i < points.size(); ++i) {
+            float d = dot(points[i] - from, points[i] - from);
+            if (d > best_distance) {
+                best_distance = d;
+                best = i;
+            }
+        }
+        return points[best];
+    };
+    Vec3 a = farthest(points[0]);
+    Vec3 b = farthest(a);
+    Vec3 center = (a + b) * 0.5f;
+    float radius = length(b - a) * 0.5f;
+    for (const Vec3& p: points) {
+        float d = length(p - center);
+        if (d > radius) {
+            float new_radius = (radius + d) * 0.5f;
+            center = center + (p - center) * ((new_radius - radius) / d);
+            radius = new_radius;
+        }
+    }
+    bounds.center[0] = center.x;
+    bounds.center[1] = center.y;
+    bounds.center[2] = center.z;
+    bounds.radius = radius;
+}
+
+// Normal cone over the meshlet's triangles. The apex is pushed back along the
+// axis until it lies behind every triangle plane, which makes the back-face
+// test conservative for cameras at any distance.
+void computeCone(const std::vector<Vec3>& triangle_points, MeshletBounds& bounds)
+{
+    size_t triangle_count = triangle_points.size() / 3;
+    std::vector<Vec3> normals;
+    normals.reserve(triangle_count);
+    Vec3 axis{ 0.0f, 0.0f, 0.0f };
+    for (size_t i = 0; i < triangle_count; ++i) {
+        const Vec3* t = &triangle_points[i * 3];
+        Vec3 n = normalize(cross(t[1] - t[0], t[2] - t[0]));
+        normals.push_back(n);
+        axis = axis + n;
+    }
+    axis = normalize(axis);
+
+    float min_dot = 1.0f;
+    for (const Vec3& n: normals) {
+        if (length(n) > 0.0f) {
+            min_dot = std::min(min_dot, dot(n, axis));
+        }
+    }
+
+    Vec3 center{ bounds.center[0], bounds.center[1], bounds.center[2] };
+    std::memcpy(bounds.cone_axis, &axis, sizeof(bounds.cone_axis));
+    bounds.padding = 0.0f;
+    // A cone wider than ~84 degrees rejects almost nothing; disable the test.
+    if (min_dot <= 0.1f || length(axis) == 0.0f) {
+        std::memcpy(bounds.cone_apex, &center, sizeof(bounds.cone_apex));
+        bounds.cone_cutoff = 1.0f;
+        return;
+    }
+
+    float max_t = 0.0f;
+    for (size_t i = 0; i < triangle_count; ++i) {
+        float dn = dot(normals[i], axis);
+        if (dn <= 0.0f) {
+            continue;
+        }
+        float t = dot(center - triangle_points[i * 3], normals[i]) / dn;
+        max_t = std::max(max_t, t);
+    }
+    Vec3 apex = center - axis * max_t;
+    std::memcpy(bounds.cone_apex, &apex, sizeof(bounds.cone_apex));
+    bounds.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+MeshletBounds computeBounds(const MeshletData& data, const Meshlet& meshlet)
+{
+    std::vector<Vec3> points;
+    points.reserve(meshlet.vertex_count);
+    for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+        points.push_back(loadPosition(data.positions.data(), data.vertex_indices[meshlet.vertex_offset + i]));
+    }
+    std::vector<Vec3> triangle_points;
+    triangle_points.reserve(meshlet.triangle_count * 3);
+    for (uint32_t i = 0; i < meshlet.triangle_count * 3; ++i) {
+        triangle_points.push_back(points[data.triangle_indices[meshlet.triangle_offset + i]]);
+    }
+    MeshletBounds bounds{};
+    computeSphere(points, bounds);
+    computeCone(triangle_points, bounds);
+    return bounds;
+}
+
+template <typename T>
+void append(std::vector<char>& out, const T* data, size_t count)
+{
+    const char* bytes = reinterpret_cast<const char*>(data);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+}
+
+template <typename T>
+void extract(const std::vector<char>& in, size_t& cursor, std::vector<T>& out, size_t count, const std::string& file_path)
+{
+    if (in.size() - cursor < count * sizeof(T)) {
+        throw std::runtime_error("truncated meshlet file: " + file_path);
+    }
+    out.resize(count);
+    std::memcpy(out.data(), in.data() + cursor, count * sizeof(T));
+    cursor += count * sizeof(T);
+}
+
+} // namespace
+
+MeshletData buildMeshlets(const uint32_t* indices, size_t index_count, const float* positions, size_t vertex_count,
+                          size_t position_stride)
+{
+    if (index_count % 3 != 0) {
+        throw std::runtime_error("index count is not a multiple of 3");
+    }
+
+    MeshletData data{};
+    data.positions.resize(vertex_count * 3);
+    for (size_t i = 0; i < vertex_count; ++i) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + i * position_stride);
+        data.positions[i * 3 + 0] = p[0];
+        data.positions[i * 3 + 1] = p[1];
+        data.positions[i * 3 + 2] = p[2];
+    }
+
+    const size_t triangle_count = index_count / 3;
+    for (size_t i = 0; i < index_count; ++i) {
+        if (indices[i] >= vertex_count) {
+            throw std::runtime_error("vertex index out of range");
+        }
+    }
+
+    // Vertex -> triangle adjacency in CSR form, so clusters can grow across
+    // shared vertices instead of following the index order.
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for (size_t i = 0; i < index_count; ++i) {
+        ++adjacency_offsets[indices[i] + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        adjacency_offsets[v + 1] += adjacency_offsets[v];
+    }
+    std::vector<uint32_t> adjacency(index_count);
+    {
+        std::vector<uint32_t> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (size_t i = 0; i < index_count; ++i) {
+            adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    constexpr uint8_t unused = 0xff;
+    std::vector<uint8_t> local_index(vertex_count, unused);
+    std::vector<bool> emitted(triangle_count, false);
+    size_t next_in_order = 0;
+    Meshlet current{};
+    // Running sum of the cluster's vertex positions, for its centroid.
+    Vec3 position_sum{ 0.0f, 0.0f, 0.0f };
+
+    auto newVertices = [&](size_t triangle) {
+        const uint32_t* t = &indices[triangle * 3];
+        return uint32_t(local_index[t[0]] == unused) + uint32_t(local_index[t[1]] == unused) + uint32_t(local_index[t[2]] == unused);
+    };
+    auto fits = [&](size_t triangle) {
+        return current.vertex_count + newVertices(triangle) <= meshlet_max_vertices && current.triangle_count < meshlet_max_triangles;
+    };
+    auto finish = [&]() {
+        if (current.triangle_count == 0) {
+            return;
+        }
+        for (uint32_t i = 0; i < current.vertex_count; ++i) {
+            local_index[data.vertex_indices[current.vertex_offset + i]] = unused;
+        }
+        position_sum = Vec3{ 0.0f, 0.0f, 0.0f };
+        data.meshlets.push_back(current);
+        current.vertex_offset = static_cast<uint32_t>(data.vertex_indices.size());
+        current.triangle_offset = static_cast<uint32_t>(data.triangle_indices.size());
+        current.vertex_count = 0;
+        current.triangle_count = 0;
+    };
+    auto triangleCenter = [&](size_t triangle) {
+        const uint32_t* t = &indices[triangle * 3];
+        Vec3 sum = loadPosition(data.positions.data(), t[0]) + loadPosition(data.positions.data(), t[1]) +
+                   loadPosition(data.positions.data(), t[2]);
+        return sum * (1.0f / 3.0f);
+    };
+    // The best continuation is the unemitted triangle touching the cluster that
+    // adds the fewest new vertices, and among those the one closest to the
+    // cluster's centroid so clusters grow round rather than along strips.
+    auto pickAdjacent = [&]() -> std::optional<size_t> {
+        std::optional<size_t> best;
+        uint32_t best_new = 3;
+        float best_distance = 0.0f;
+        Vec3 centroid = position_sum * (1.0f / std::max(current.vertex_count, 1u));
+        for (uint32_t i = 0; i < current.vertex_count; ++i) {
+            uint32_t v = data.vertex_indices[current.vertex_offset + i];
+            for (uint32_t a = adjacency_offsets[v]; a < adjacency_offsets[v + 1]; ++a) {
+                size_t triangle = adjacency[a];
+                if (emitted[triangle]) {
+                    continue;
+                }
+                uint32_t added = newVertices(triangle);
+                if (added > best_new || !fits(triangle)) {
+                    continue;
+                }
+                Vec3 offset = triangleCenter(triangle) - centroid;
+                float distance = dot(offset, offset);
+                if (!best || added < best_new || distance < best_distance) {
+                    best = triangle;
+                    best_new = added;
+                    best_distance = distance;
+                }
+            }
+        }
+        return best;
+    };
+
+    for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        std::optional<size_t> triangle = pickAdjacent();
+        if (!triangle) {
+            while (emitted[next_in_order]) {
+                ++next_in_order;
+            }
+            triangle = next_in_order;
+            // Start a new cluster when nothing connected fits, unless the
+            // cluster is small enough that a disconnected piece is worth adding.
+            if (!fits(*triangle) || current.vertex_count > meshlet_max_vertices / 2) {
+                finish();
+            }
+        }
+        emitted[*triangle] = true;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[*triangle * 3 + k];
+            if (local_index[v] == unused) {
+                local_index[v] = static_cast<uint8_t>(current.vertex_count++);
+                data.vertex_indices.push_back(v);
+                position_sum = position_sum + loadPosition(data.positions.data(), v);
+            }
+            data.triangle_indices.push_back(local_index[v]);
+        }
+        ++current.triangle_count;
+    }
+    finish();
+
+    data.bounds.reserve(data.meshlets.size());
+    for (const Meshlet& meshlet: data.meshlets) {
+        data.bounds.push_back(computeBounds(data, meshlet));
+    }
+    return data;
+}
+
+std::vector<uint32_t> flattenMeshletIndices(const MeshletData& data)
+{
+    std::vector<uint32_t> indices;
+    indices.reserve(data.triangle_indices.size());
+    for (const Meshlet& meshlet: data.meshlets) {
+        for (uint32_t i = 0; i < meshlet.triangle_count * 3; ++i) {
+            indices.push_back(data.vertex_indices[meshlet.vertex_offset + data.triangle_indices[meshlet.triangle_offset + i]]);
+        }
+    }
+    return indices;
+}
+
+bool isMeshletVisible(const MeshletBounds& bounds, const float camera_position[3], const float frustum_planes[6][4])
+{
+    for (int i = 0; i < 6; ++i) {
+        const float* plane = frustum_planes[i];
+        float distance = plane[0] * bounds.center[0] + plane[1] * bounds.center[1] + plane[2] * bounds.center[2] + plane[3];
+        if (distance < -bounds.radius) {
+            return false;
+        }
+    }
+    Vec3 apex{ bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2] };
+    Vec3 axis{ bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2] };
+    Vec3 camera{ camera_position[0], camera_position[1], camera_position[2] };
+    return dot(normalize(apex - camera), axis) < bounds.cone_cutoff;
+}
+
+void writeMeshlets(const std::string& file_path, const MeshletData& data)
+{
+    MeshletFileHeader header{};
+    std::memcpy(header.magic, meshlet_file_magic, sizeof(header.magic));
+    header.version = meshlet_file_version;
+    header.meshlet_count = static_cast<uint32_t>(data.meshlets.size());
+    header.vertex_count = static_cast<uint32_t>(data.positions.size() / 3);
+    header.vertex_index_count = static_cast<uint32_t>(data.vertex_indices.size());
+    header.triangle_index_count = static_cast<uint32_t>(data.triangle_indices.size());
+    header.max_vertices = meshlet_max_vertices;
+    header.max_triangles = meshlet_max_triangles;
+
+    std::vector<char> out;
+    append(out, &header, 1);
+    append(out, data.meshlets.data(), data.meshlets.size());
+    append(out, data.bounds.data(), data.bounds.size());
+    append(out, data.vertex_indices.data(), data.vertex_indices.size());
+    append(out, data.positions.data(), data.positions.size());
+    append(out, data.triangle_indices.data(), data.triangle_indices.size());
+    utils::writeFile(file_path, out.data(), out.size());
+}
+
+MeshletData readMeshlets(const std::string& file_path)
+{
+    std::vector<char> in = utils::readFile(file_path);
+    if (in.size() < sizeof(MeshletFileHeader)) {
+        throw std::runtime_error("truncated meshlet file: " + file_path);
+    }
+    MeshletFileHeader header{};
+    std::memcpy(&header, in.data(), sizeof(header));
+    if (std::memcmp(header.magic, meshlet_file_magic, sizeof(header.magic)) != 0 || header.version != meshlet_file_version) {
+        throw std::runtime_error("not a meshlet file or unsupported version: " + file_path);
+    }
+    if (header.max_vertices > meshlet_max_vertices || header.max_triangles > meshlet_max_triangles) {
+        throw std::runtime_error("meshlet limits exceed what this build supports: " + file_path);
+    }
+
+    MeshletData data{};
+    size_t cursor = sizeof(header);
+    extract(in, cursor, data.meshlets, header.meshlet_count, file_path);
+    extract(in, cursor, data.bounds, header.meshlet_count, file_path);
+    extract(in, cursor, data.vertex_indices, header.vertex_index_count, file_path);
+    extract(in, cursor, data.positions, size_t(header.vertex_count) * 3, file_path);
+    extract(in, cursor, data.triangle_indices, header.triangle_index_count, file_path);
+
+    for (const Meshlet& meshlet: data.meshlets) {
+        // The mesh shader writes each meshlet into fixed size output arrays.
+        if (meshlet.vertex_count > header.max_vertices || meshlet.triangle_count > header.max_triangles) {
+            throw std::runtime_error("meshlet exceeds the file's limits: " + file_path);
+        }
+        if (size_t(meshlet.vertex_offset) + meshlet.vertex_count > data.vertex_indices.size() ||
+            size_t(meshlet.triangle_offset) + size_t(meshlet.triangle_count) * 3 > data.triangle_indices.size()) {
+            throw std::runtime_error("corrupt meshlet ranges: " + file_path);
+        }
+        for (uint32_t i = 0; i < meshlet.triangle_count * 3; ++i) {
+            if (data.triangle_indices[meshlet.triangle_offset + i] >= meshlet.vertex_count) {
+                throw std::runtime_error("corrupt meshlet triangle: " + file_path);
+            }
+        }
+    }
+    for (uint32_t index: data.vertex_indices) {
+        if (index >= header.vertex_count) {
+            throw std::runtime_error("corrupt meshlet vertex index: " + file_path);
+        }
+    }
+    return data;
+}
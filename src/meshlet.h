@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Limits chosen to fit NVIDIA's and AMD's preferred mesh shader output sizes;
+// 124 triangles keeps the primitive index block at 372 bytes (< 384).
+inline constexpr uint32_t meshlet_max_vertices = 64;
+inline constexpr uint32_t meshlet_max_triangles = 124;
+
+// Matches the std430 layout of the Meshlet struct in the shaders.
+struct Meshlet
+{
+    uint32_t vertex_offset;   // into MeshletData::vertex_indices
+    uint32_t triangle_offset; // into MeshletData::triangle_indices (3 bytes per triangle)
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+};
+
+// Culling data for one meshlet, std430 compatible. A meshlet is back facing
+// when dot(normalize(cone_apex - camera_position), cone_axis) >= cone_cutoff;
+// cone_cutoff is 1 when the normals are too spread to cull.
+struct MeshletBounds
+{
+    float center[3];
+    float radius;
+    float cone_apex[3];
+    float padding;
+    float cone_axis[3];
+    float cone_cutoff;
+};
+
+struct MeshletData
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    std::vector<uint32_t> vertex_indices;  // meshlet local -> mesh vertex
+    std::vector<uint8_t> triangle_indices; // meshlet local vertex triplets
+    std::vector<float> positions;          // xyz per mesh vertex
+};
+
+// Splits an indexed triangle list into meshlets of at most
+// meshlet_max_vertices / meshlet_max_triangles. Each meshlet grows across shared
+// vertices, always taking the adjacent triangle that adds the fewest new
+// vertices, which keeps clusters compact for culling and maximizes reuse.
+MeshletData buildMeshlets(const uint32_t* indices, size_t index_count, const float* positions, size_t vertex_count,
+                          size_t position_stride);
+
+// Expands the meshlet triangles back to a flat index list in meshlet order.
+// Meshlet i occupies indices [triangle_offset, triangle_offset + 3 * triangle_count).
+std::vector<uint32_t> flattenMeshletIndices(const MeshletData& data);
+
+// CPU reference of the cluster test performed by the culling shaders.
+bool isMeshletVisible(const MeshletBounds& bounds, const float camera_position[3], const float frustum_planes[6][4]);
+
+void writeMeshlets(const std::string& file_path, const MeshletData& data);
+MeshletData readMeshlets(const std::string& file_path);
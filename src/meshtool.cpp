@@ -0,0 +1,576 @@
+// Offline mesh preprocessing. Builds the files loaded by the renderer at
+// runtime so that no mesh processing happens during startup.
+
+#include "camera.h"
+#include "draw_queue.h"
+#include "frame_pacer.h"
+#include "job_system.h"
+#include "mesh_data.h"
+#include "mesh_file.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void printUsage()
+{
+    std::cout << "Usage: meshtool <command> [args]" << std::endl
+              << "\timport <input.obj> <output.mesh>   optimize and quantize a mesh for --mesh" << std::endl
+              << "\tmeshlets <input.obj> <output.mlt>  split a mesh into culling clusters" << std::endl
+              << "\tbench [<segments>]                 time the meshlet builder and the cache optimizer on a generated sphere (default 512)" << std::endl
+              << "\tcheck                              verify meshlet limits, bounds and cone culling without a GPU" << std::endl
+              << "\tscene-bench [<instances>]          time scene updates, CPU culling and draw sorting (default 100k and 1M)" << std::endl
+              << "\tpacer-bench                        simulate frame pacing at 60 and 144 Hz and check its latency and misses" << std::endl;
+}
+
+void printMeshletStats(const MeshletData& data, size_t triangle_count)
+{
+    size_t vertex_refs = data.vertex_indices.size();
+    size_t bytes = data.meshlets.size() * (sizeof(Meshlet) + sizeof(MeshletBounds)) + vertex_refs * sizeof(uint32_t) +
+                   data.triangle_indices.size() + data.positions.size() * sizeof(float);
+    std::cout << "Meshlets: " << data.meshlets.size() << std::endl
+              << "\tavg vertices:  " << static_cast<double>(vertex_refs) / data.meshlets.size() << " / " << meshlet_max_vertices << std::endl
+              << "\tavg triangles: " << static_cast<double>(triangle_count) / data.meshlets.size() << " / " << meshlet_max_triangles << std::endl
+              << "\tvertex refs per mesh vertex: " << static_cast<double>(vertex_refs) / (data.positions.size() / 3) << std::endl
+              << "\tsize: " << bytes / 1024 << " KiB" << std::endl;
+}
+
+// Meshlets reorder triangles, so compare them as sets, each rotated to start at
+// its lowest index to keep the winding intact.
+bool sameTriangles(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    auto canonical = [](const std::vector<uint32_t>& indices) {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        triangles.reserve(indices.size() / 3);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            std::array<uint32_t, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+            std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+            triangles.push_back(t);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    };
+    return a.size() == b.size() && canonical(a) == canonical(b);
+}
+
+// Verifies that the file round-trips and still describes the input triangles.
+void verifyMeshlets(const std::string& path, const MeshletData& data, const std::vector<uint32_t>& indices)
+{
+    MeshletData loaded = readMeshlets(path);
+    if (loaded.meshlets.size() != data.meshlets.size() || loaded.triangle_indices != data.triangle_indices ||
+        loaded.vertex_indices != data.vertex_indices) {
+        throw std::runtime_error("meshlet file does not match the built data: " + path);
+    }
+    if (!sameTriangles(flattenMeshletIndices(loaded), indices)) {
+        throw std::runtime_error("meshlets do not reproduce the input triangles: " + path);
+    }
+}
+
+void printCacheStats(const char* label, const std::vector<uint32_t>& indices, size_t vertex_count)
+{
+    VertexCacheStats stats = analyzeVertexCache(indices.data(), indices.size(), vertex_count);
+    std::cout << label << ": ACMR " << stats.acmr << ", ATVR " << stats.atvr << std::endl;
+}
+
+// Maps the written file back and checks that it decodes to the optimized mesh
+// within the quantization error.
+void verifyMeshFile(const std::string& path, const MeshData& mesh)
+{
+    MeshFile file(path);
+    const MeshFileHeader& header = file.header();
+    if (header.vertex_count != mesh.vertices.size() || header.index_count != mesh.indices.size()) {
+        throw std::runtime_error("mesh file does not match the imported mesh: " + path);
+    }
+    for (size_t i = 0; i < mesh.indices.size(); ++i) {
+        uint32_t index = header.index_size == 2 ? static_cast<const uint16_t*>(file.indexData())[i]
+                                                : static_cast<const uint32_t*>(file.indexData())[i];
+        if (index != mesh.indices[i]) {
+            throw std::runtime_error("mesh file indices do not match the imported mesh: " + path);
+        }
+    }
+    const PackedVertex* vertices = static_cast<const PackedVertex*>(file.vertexData());
+    float max_position_error = 0.0f;
+    float max_normal_error = 0.0f;
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        float position[3];
+        float normal[3];
+        unpackPosition(header, vertices[i], position);
+        decodeOctahedral(vertices[i].normal, normal);
+        float dot = 0.0f;
+        for (int c = 0; c < 3; ++c) {
+            max_position_error = std::max(max_position_error, std::fabs(position[c] - mesh.vertices[i].position[c]));
+            dot += normal[c] * mesh.vertices[i].normal[c];
+        }
+        max_normal_error = std::max(max_normal_error, std::acos(std::min(1.0f, dot)));
+    }
+    std::cout << "\tmax position error: " << max_position_error << " (" << max_position_error / (2.0f * header.radius)
+              << " of the size), max normal error: " << max_normal_error * 57.2958f << " degrees" << std::endl;
+}
+
+int importCommand(const std::string& input, const std::string& output)
+{
+    auto start = Clock::now();
+    MeshData mesh = loadObj(input);
+    std::cout << "Loaded " << input << ": " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3
+              << " triangles in " << elapsedMs(start) << " ms" << std::endl;
+    printCacheStats("Input", mesh.indices, mesh.vertices.size());
+
+    start = Clock::now();
+    optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    size_t vertex_count = optimizeVertexFetch(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(),
+                                              mesh.vertices.size(), sizeof(MeshVertex));
+    mesh.vertices.resize(vertex_count);
+    std::cout << "Optimized in " << elapsedMs(start) << " ms" << std::endl;
+    printCacheStats("Optimized", mesh.indices, mesh.vertices.size());
+
+    PackedMesh packed = packMesh(mesh);
+    writeMeshFile(output, packed);
+    size_t before = mesh.vertices.size() * sizeof(MeshVertex) + mesh.indices.size() * sizeof(uint32_t);
+    size_t after = packed.vertices.size() * sizeof(PackedVertex) + packed.indices.size();
+    std::cout << "Wrote " << output << ": " << sizeof(PackedVertex) << " byte vertices, " << packed.header.index_size * 8
+              << "-bit indices, " << before / 1024 << " KiB -> " << after / 1024 << " KiB" << std::endl;
+    verifyMeshFile(output, mesh);
+    return EXIT_SUCCESS;
+}
+
+int buildCommand(const std::string& input, const std::string& output)
+{
+    auto start = Clock::now();
+    MeshData mesh = loadObj(input);
+    std::cout << "Loaded " << input << ": " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3
+              << " triangles in " << elapsedMs(start) << " ms" << std::endl;
+
+    start = Clock::now();
+    MeshletData data = buildMeshlets(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position,
+                                     mesh.vertices.size(), sizeof(MeshVertex));
+    std::cout << "Built meshlets in " << elapsedMs(start) << " ms" << std::endl;
+    printMeshletStats(data, mesh.indices.size() / 3);
+
+    writeMeshlets(output, data);
+    verifyMeshlets(output, data, mesh.indices);
+    std::cout << "Wrote " << output << std::endl;
+    return EXIT_SUCCESS;
+}
+
+// Unit UV sphere.
+void generateSphere(uint32_t segments, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    const float pi = 3.14159265f;
+    for (uint32_t i = 0; i <= segments; ++i) {
+        for (uint32_t j = 0; j <= segments; ++j) {
+            float theta = pi * i / segments;
+            float phi = 2.0f * pi * j / segments;
+            positions.push_back(std::sin(theta) * std::cos(phi));
+            positions.push_back(std::cos(theta));
+            positions.push_back(std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (uint32_t i = 0; i < segments; ++i) {
+        for (uint32_t j = 0; j < segments; ++j) {
+            uint32_t a = i * (segments + 1) + j;
+            uint32_t b = a + segments + 1;
+            indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+}
+
+int benchCommand(uint32_t segments)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    generateSphere(segments, positions, indices);
+    const size_t triangle_count = indices.size() / 3;
+    std::cout << "Sphere: " << positions.size() / 3 << " vertices, " << triangle_count << " triangles" << std::endl;
+
+    constexpr int runs = 5;
+    double best_ms = 0.0;
+    MeshletData data;
+    for (int run = 0; run < runs; ++run) {
+        auto start = Clock::now();
+        data = buildMeshlets(indices.data(), indices.size(), positions.data(), positions.size() / 3, 3 * sizeof(float));
+        double ms = elapsedMs(start);
+        best_ms = run == 0 ? ms : std::min(best_ms, ms);
+    }
+    std::cout << "Build: " << best_ms << " ms (best of " << runs << "), "
+              << triangle_count / best_ms / 1000.0 << " Mtri/s" << std::endl;
+    printMeshletStats(data, triangle_count);
+    if (!sameTriangles(flattenMeshletIndices(data), indices)) {
+        throw std::runtime_error("meshlets do not reproduce the input triangles");
+    }
+
+    // CPU reference of the GPU cluster test, from a camera close enough to cut
+    // into the sphere so both frustum and cone culling reject clusters.
+    const float eye[3] = { 0.0f, 0.3f, 1.6f };
+    const float center[3] = { 0.4f, 0.0f, 0.0f };
+    Camera camera = makeCamera(eye, center, 0.8f, 16.0f / 9.0f, 0.05f, 10.0f);
+    size_t visible = 0;
+    auto start = Clock::now();
+    for (const MeshletBounds& bounds: data.bounds) {
+        visible += isMeshletVisible(bounds, camera.position, camera.frustum_planes);
+    }
+    double cull_ms = elapsedMs(start);
+    std::cout << "Cull: " << visible << "/" << data.meshlets.size() << " visible, " << cull_ms << " ms" << std::endl;
+
+    VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), positions.size() / 3);
+    std::vector<uint32_t> optimized;
+    best_ms = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        optimized = indices;
+        start = Clock::now();
+        optimizeVertexCache(optimized.data(), optimized.size(), positions.size() / 3);
+        double ms = elapsedMs(start);
+        best_ms = run == 0 ? ms : std::min(best_ms, ms);
+    }
+    VertexCacheStats after = analyzeVertexCache(optimized.data(), optimized.size(), positions.size() / 3);
+    std::cout << "Vertex cache: " << best_ms << " ms (best of " << runs << "), ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    if (!sameTriangles(optimized, indices)) {
+        throw std::runtime_error("vertex cache optimization changed the triangles");
+    }
+    return EXIT_SUCCESS;
+}
+
+// Throws unless every meshlet fits the mesh shader's output arrays, its bounding
+// sphere holds all of its vertices, and a cone test rejecting it from a camera
+// implies that all of its triangles face away from that camera.
+void checkMeshlets(const char* label, const MeshletData& data, const std::vector<uint32_t>& indices)
+{
+    if (!sameTriangles(flattenMeshletIndices(data), indices)) {
+        throw std::runtime_error(std::string(label) + ": meshlets do not reproduce the input triangles");
+    }
+    auto position = [&](const Meshlet& meshlet, uint32_t local) {
+        return &data.positions[size_t(data.vertex_indices[meshlet.vertex_offset + local]) * 3];
+    };
+    for (size_t i = 0; i < data.meshlets.size(); ++i) {
+        const Meshlet& meshlet = data.meshlets[i];
+        const MeshletBounds& bounds = data.bounds[i];
+        if (meshlet.vertex_count > meshlet_max_vertices || meshlet.triangle_count > meshlet_max_triangles) {
+            throw std::runtime_error(std::string(label) + ": meshlet " + std::to_string(i) + " exceeds the limits");
+        }
+        for (uint32_t v = 0; v < meshlet.vertex_count; ++v) {
+            const float* p = position(meshlet, v);
+            float distance = std::sqrt((p[0] - bounds.center[0]) * (p[0] - bounds.center[0]) +
+                                       (p[1] - bounds.center[1]) * (p[1] - bounds.center[1]) +
+                                       (p[2] - bounds.center[2]) * (p[2] - bounds.center[2]));
+            if (distance > bounds.radius * 1.0001f + 1e-6f) {
+                throw std::runtime_error(std::string(label) + ": bounds of meshlet " + std::to_string(i) +
+                                         " do not enclose its vertices");
+            }
+        }
+    }
+
+    // Cameras on spheres around the mesh, from just outside its surface to far
+    // away. The frustum planes accept everything, leaving only the cone test.
+    const float open_planes[6][4] = { { 0, 0, 0, 1 }, { 0, 0, 0, 1 }, { 0, 0, 0, 1 },
+                                      { 0, 0, 0, 1 }, { 0, 0, 0, 1 }, { 0, 0, 0, 1 } };
+    constexpr uint32_t directions = 64;
+    size_t back_facing = 0;
+    size_t cone_culled = 0;
+    for (float distance: { 1.05f, 1.5f, 4.0f, 50.0f }) {
+        for (uint32_t d = 0; d < directions; ++d) {
+            // Fibonacci sphere directions.
+            float y = 1.0f - 2.0f * (d + 0.5f) / directions;
+            float ring = std::sqrt(1.0f - y * y);
+            float phi = 2.39996323f * d;
+            const float camera[3] = { distance * ring * std::cos(phi), distance * y, distance * ring * std::sin(phi) };
+            for (size_t i = 0; i < data.meshlets.size(); ++i) {
+                const Meshlet& meshlet = data.meshlets[i];
+                bool culled = !isMeshletVisible(data.bounds[i], camera, open_planes);
+                for (uint32_t t = 0; t < meshlet.triangle_count; ++t) {
+                    const uint8_t* local = &data.triangle_indices[meshlet.triangle_offset + t * 3];
+                    const float* a = position(meshlet, local[0]);
+                    const float* b = position(meshlet, local[1]);
+                    const float* c = position(meshlet, local[2]);
+                    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                    const float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                                              e1[0] * e2[1] - e1[1] * e2[0] };
+                    float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                    if (length == 0.0f) {
+                        continue;
+                    }
+                    // Signed distance of the camera to the triangle's plane.
+                    float facing = (normal[0] * (camera[0] - a[0]) + normal[1] * (camera[1] - a[1]) +
+                                    normal[2] * (camera[2] - a[2])) / length;
+                    back_facing += facing <= 0.0f;
+                    cone_culled += culled;
+                    if (culled && facing > 1e-5f) {
+                        throw std::runtime_error(std::string(label) + ": cone test rejects meshlet " + std::to_string(i) +
+                                                 " with a triangle facing the camera");
+                    }
+                }
+            }
+        }
+    }
+    if (cone_culled == 0) {
+        throw std::runtime_error(std::string(label) + ": cone test never rejected a meshlet");
+    }
+    std::cout << label << ": " << data.meshlets.size() << " meshlets ok, cone test rejects " << cone_culled << " of "
+              << back_facing << " back facing triangles" << std::endl;
+}
+
+int checkCommand()
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    generateSphere(64, positions, indices);
+    MeshletData data = buildMeshlets(indices.data(), indices.size(), positions.data(), positions.size() / 3, 3 * sizeof(float));
+    checkMeshlets("Sphere", data, indices);
+
+    // The same triangles in a fixed random order, which leaves the builder
+    // fewer connected triangles to grow meshlets from.
+    std::vector<uint32_t> order(indices.size() / 3);
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937{ 1 });
+    std::vector<uint32_t> shuffled;
+    shuffled.reserve(indices.size());
+    for (uint32_t triangle: order) {
+        shuffled.insert(shuffled.end(), { indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2] });
+    }
+    data = buildMeshlets(shuffled.data(), shuffled.size(), positions.data(), positions.size() / 3, 3 * sizeof(float));
+    checkMeshlets("Shuffled sphere", data, shuffled);
+    return EXIT_SUCCESS;
+}
+
+int sceneBenchCommand(uint32_t instance_count, JobSystem& jobs)
+{
+    constexpr int runs = 5;
+    auto best = [](auto&& func) {
+        double best_ms = 0.0;
+        for (int run = 0; run < runs; ++run) {
+            auto start = Clock::now();
+            func();
+            double ms = elapsedMs(start);
+            best_ms = run == 0 ? ms : std::min(best_ms, ms);
+        }
+        return best_ms;
+    };
+
+    Scene scene;
+    const float mesh_center[3] = {};
+    auto start = Clock::now();
+    GridScene grid = buildGridScene(scene, instance_count, mesh_center, 1.0f, scene_material_count);
+    std::cout << "Scene: " << scene.size() << " nodes, " << grid.groups.size() << " groups, built in " << elapsedMs(start)
+              << " ms (" << Scene::simdPath() << ")" << std::endl;
+
+    start = Clock::now();
+    uint32_t moved = scene.updateTransforms();
+    std::cout << "Update all: " << moved << " nodes, " << elapsedMs(start) << " ms" << std::endl;
+    // One group in eight spins, as with --scene.
+    float time = 0.0f;
+    double update_ms = best([&] {
+        animateGridScene(scene, grid, time += 0.1f, 8);
+        moved = scene.updateTransforms();
+    });
+    std::cout << "Update 1/8 of the groups: " << moved << " nodes, " << update_ms << " ms (best of " << runs << ")" << std::endl;
+
+    // Same camera as --scene: inside the grid, so about half of it is culled.
+    Camera camera = makeOrbitCamera(grid.center, grid.radius * 0.25f, 0.3f, 16.0f / 9.0f);
+    std::vector<NodeId> visible;
+    std::vector<NodeId> reference;
+    for (CullTest test: { CullTest::sphere, CullTest::box }) {
+        reference.clear();
+        for (NodeId node = 0; node < scene.size(); ++node) {
+            if (scene.mesh(node) != Scene::no_mesh && scene.isVisible(camera.frustum_planes, test, node)) {
+                reference.push_back(node);
+            }
+        }
+        double single_ms = best([&] { scene.cull(camera.frustum_planes, test, nullptr, visible); });
+        if (visible != reference) {
+            throw std::runtime_error("vector culling differs from the scalar reference");
+        }
+        double jobs_ms = best([&] { scene.cull(camera.frustum_planes, test, &jobs, visible); });
+        if (visible != reference) {
+            throw std::runtime_error("culling with jobs differs from the scalar reference");
+        }
+        std::cout << "Cull " << (test == CullTest::sphere ? "spheres" : "boxes") << ": " << visible.size() << "/"
+                  << instance_count << " visible, " << single_ms << " ms (" << scene.size() / single_ms / 1000.0
+                  << " Mnode/s), " << jobs_ms << " ms on " << jobs.threadCount() + 1 << " threads" << std::endl;
+    }
+
+    // Draw keys of the visible nodes as --scene builds them.
+    DrawQueue queue;
+    auto fill = [&] { queueSceneDraws(scene, visible, camera, grid.radius, queue); };
+    fill();
+    DrawQueue::BindStats unsorted = queue.bindStats();
+    std::vector<std::pair<uint64_t, uint32_t>> reference_draws;
+    for (size_t i = 0; i < queue.size(); ++i) {
+        reference_draws.emplace_back(queue.keys()[i], queue.payloads()[i]);
+    }
+    double sort_ms = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        fill();
+        start = Clock::now();
+        queue.sort();
+        double ms = elapsedMs(start);
+        sort_ms = run == 0 ? ms : std::min(sort_ms, ms);
+    }
+    start = Clock::now();
+    std::stable_sort(reference_draws.begin(), reference_draws.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    double std_sort_ms = elapsedMs(start);
+    for (size_t i = 0; i < queue.size(); ++i) {
+        if (queue.keys()[i] != reference_draws[i].first || queue.payloads()[i] != reference_draws[i].second) {
+            throw std::runtime_error("radix sort differs from std::stable_sort");
+        }
+    }
+    DrawQueue::BindStats sorted = queue.bindStats();
+    std::cout << "Sort " << queue.size() << " draws: " << sort_ms << " ms (best of " << runs << "), std::stable_sort "
+              << std_sort_ms << " ms" << std::endl
+              << "Binds: " << sorted.pipeline_binds << " pipeline, " << sorted.material_binds << " material, "
+              << sorted.mesh_binds << " mesh (unsorted " << unsorted.pipeline_binds << ", " << unsorted.material_binds
+              << ", " << unsorted.mesh_binds << ")" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+struct PacerRun
+{
+    double avg_latency_ms = 0.0;
+    double max_latency_ms = 0.0;
+    double miss_rate = 0.0;
+    double start_delay_ms = 0.0;
+};
+
+// Drives the pacer the way the renderer does with the software present
+// estimate, on a simulated clock: each frame renders for work_ms plus a random
+// part of up to jitter_ms, then waits for its vblank and the start delay.
+PacerRun simulatePacer(const FramePacerSettings& settings, double work_ms, double jitter_ms, uint32_t frame_count)
+{
+    auto toDuration = [](double ms) {
+        return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    };
+    FramePacer pacer{settings};
+    std::mt19937 random{ 1 };
+    std::uniform_real_distribution<double> jitter{ 0.0, jitter_ms };
+    PacerRun run{};
+    uint32_t measured = 0;
+    uint32_t missed = 0;
+    FramePacer::Clock::time_point now{};
+    for (uint64_t frame = 0; frame < frame_count; ++frame) {
+        if (frame > 0) {
+            FramePacer::Clock::time_point presented = pacer.estimatePresent(now);
+            std::optional<FrameLatency> latency = pacer.framePresented(frame - 1, presented);
+            if (!latency) {
+                throw std::runtime_error("frame pacer lost a started frame");
+            }
+            run.avg_latency_ms += latency->latency_ms;
+            run.max_latency_ms = std::max(run.max_latency_ms, latency->latency_ms);
+            missed += latency->missed;
+            ++measured;
+            now = std::max(now, pacer.startTime(presented));
+        }
+        pacer.frameStarted(frame, now);
+        now += toDuration(work_ms + jitter(random));
+    }
+    run.avg_latency_ms /= measured;
+    run.miss_rate = static_cast<double>(missed) / measured;
+    run.start_delay_ms = pacer.startDelayMs();
+    return run;
+}
+
+// Checks that pacing cuts latency against starting every frame right after the
+// previous present, without missing more than an occasional vblank, and that it
+// backs off entirely when frames do not fit a refresh.
+int pacerBenchCommand()
+{
+    struct Case
+    {
+        double refresh_hz;
+        double work_ms;
+        double jitter_ms;
+    };
+    constexpr uint32_t frame_count = 3600;
+    for (Case c: { Case{ 60.0, 4.0, 1.0 }, Case{ 60.0, 10.0, 2.0 }, Case{ 144.0, 2.0, 0.5 }, Case{ 60.0, 20.0, 1.0 } }) {
+        FramePacerSettings settings{};
+        settings.refresh_period_ms = 1000.0 / c.refresh_hz;
+        PacerRun paced = simulatePacer(settings, c.work_ms, c.jitter_ms, frame_count);
+        // A margin of a whole period keeps the start delay at 0.
+        FramePacerSettings unpaced_settings = settings;
+        unpaced_settings.margin_ms = settings.refresh_period_ms;
+        PacerRun unpaced = simulatePacer(unpaced_settings, c.work_ms, c.jitter_ms, frame_count);
+        std::cout << c.refresh_hz << " Hz, " << c.work_ms << "+" << c.jitter_ms << " ms of work: latency avg "
+                  << paced.avg_latency_ms << " ms, max " << paced.max_latency_ms << " ms (unpaced " << unpaced.avg_latency_ms
+                  << " ms), " << paced.miss_rate * 100.0 << "% missed, start delay " << paced.start_delay_ms << " ms"
+                  << std::endl;
+
+        if (c.work_ms + c.jitter_ms > settings.refresh_period_ms) {
+            if (paced.start_delay_ms != 0.0) {
+                throw std::runtime_error("frame pacer delays frames that do not fit a refresh");
+            }
+            continue;
+        }
+        if (paced.miss_rate > 0.02) {
+            throw std::runtime_error("frame pacer misses more than 2% of the vblanks");
+        }
+        if (unpaced.miss_rate != 0.0) {
+            throw std::runtime_error("frames miss their vblank without pacing");
+        }
+        // Once settled, a frame reaches the display within the margin of its work.
+        if (paced.avg_latency_ms > c.work_ms + c.jitter_ms + settings.margin_ms ||
+            paced.avg_latency_ms >= unpaced.avg_latency_ms) {
+            throw std::runtime_error("frame pacing does not reduce the latency");
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        std::string command = argc > 1 ? argv[1] : "";
+        if (command == "import" && argc == 4) {
+            return importCommand(argv[2], argv[3]);
+        }
+        if (command == "meshlets" && argc == 4) {
+            return buildCommand(argv[2], argv[3]);
+        }
+        if (command == "bench" && argc <= 3) {
+            uint32_t segments = argc == 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 512;
+            return benchCommand(std::max(segments, 2u));
+        }
+        if (command == "check" && argc == 2) {
+            return checkCommand();
+        }
+        if (command == "pacer-bench" && argc == 2) {
+            return pacerBenchCommand();
+        }
+        if (command == "scene-bench" && argc <= 3) {
+            JobSystem jobs;
+            if (argc == 3) {
+                return sceneBenchCommand(std::max(static_cast<uint32_t>(std::stoul(argv[2])), 1u), jobs);
+            }
+            for (uint32_t instance_count: { 100000u, 1000000u }) {
+                sceneBenchCommand(instance_count, jobs);
+            }
+            return EXIT_SUCCESS;
+        }
+        printUsage();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,206 @@
+#include "options.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+bool matchOption(std::string_view arg, std::string_view name, std::string_view& value)
+{
+    if (arg.substr(0, name.size()) != name || arg.size() <= name.size() || arg[name.size()] != '=') {
+        return false;
+    }
+    value = arg.substr(name.size() + 1);
+    return true;
+}
+
+uint32_t parseUint(std::string_view name, std::string_view value)
+{
+    try {
+        size_t pos = 0;
+        unsigned long result = std::stoul(std::string{value}, &pos);
+        if (pos != value.size()) {
+            throw std::invalid_argument{"trailing characters"};
+        }
+        return static_cast<uint32_t>(result);
+    } catch (const std::exception&) {
+        throw std::runtime_error("invalid value for " + std::string{name} + ": " + std::string{value});
+    }
+}
+
+double parseDouble(std::string_view name, std::string_view value)
+{
+    try {
+        size_t pos = 0;
+        double result = std::stod(std::string{value}, &pos);
+        if (pos != value.size()) {
+            throw std::invalid_argument{"trailing characters"};
+        }
+        return result;
+    } catch (const std::exception&) {
+        throw std::runtime_error("invalid value for " + std::string{name} + ": " + std::string{value});
+    }
+}
+
+void printUsage()
+{
+    std::cout << "Usage: vulkan-api [options]" << std::endl
+              << "\t--size=<W>x<H>            window size (default 800x600)" << std::endl
+              << "\t--window=<W>x<H>[@<Hz>]   open another window mirroring the view, optionally at its own rate; repeatable" << std::endl
+              << "\t--capture=<sink>:<target> read back every frame: raw:<file>, png:<prefix>, pipe:<command>" << std::endl
+              << "\t--capture-ring=<N>        readback buffers in flight or queued for the sink (default 3)" << std::endl
+              << "\t--dynamic-resolution[=<ms>] scale the render resolution to a GPU frame budget (default 16 ms)" << std::endl
+              << "\t--min-scale=<F>           lowest dynamic resolution scale (default 0.5)" << std::endl
+              << "\t--draw-instances=<N>      draw the triangle N times per frame" << std::endl
+              << "\t--variant-bench[=<N>]     time every triangle pipeline variant for N frames each (default 240)" << std::endl
+              << "\t--meshlets=<file>         draw a meshlet file built by meshtool with GPU cluster culling" << std::endl
+              << "\t--mesh=<file>             draw a mesh file imported by meshtool" << std::endl
+              << "\t--scene=<count>           draw <count> instances of --mesh from a CPU culled scene" << std::endl
+              << "\t--no-mesh-shaders         cull meshlets in compute and draw indirect even with mesh shader support" << std::endl
+              << "\t--occlusion-culling       cull meshlets against a depth pyramid of a depth prepass (compute path)" << std::endl
+              << "\t--textures=<dir>          stream the KTX2 textures in a directory" << std::endl
+              << "\t--texture-budget=<MiB>    cap streamed texture memory (default: device memory budget)" << std::endl
+              << "\t--texture-upload=<MiB>    texture data uploaded per frame (default 8)" << std::endl
+              << "\t--low-latency[=<mode>]    pace frames to the display: auto, present-wait or software (default auto)" << std::endl
+              << "\t--latency-log=<file>      write the latency of every frame as CSV, needs --low-latency" << std::endl;
+}
+
+} // namespace
+
+AppOptions parseOptions(int argc, char** argv)
+{
+    AppOptions options{};
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        std::string_view value;
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(EXIT_SUCCESS);
+        } else if (matchOption(arg, "--size", value)) {
+            auto x = value.find('x');
+            if (x == std::string_view::npos) {
+                throw std::runtime_error("invalid value for --size: " + std::string{value});
+            }
+            options.window_width = parseUint("--size", value.substr(0, x));
+            options.window_height = parseUint("--size", value.substr(x + 1));
+            if (options.window_width == 0 || options.window_height == 0) {
+                throw std::runtime_error("--size must be positive");
+            }
+        } else if (matchOption(arg, "--window", value)) {
+            WindowOptions window{};
+            auto at = value.find('@');
+            if (at != std::string_view::npos) {
+                window.rate_hz = parseDouble("--window", value.substr(at + 1));
+                if (window.rate_hz <= 0.0) {
+                    throw std::runtime_error("--window rate must be positive");
+                }
+                value = value.substr(0, at);
+            }
+            auto x = value.find('x');
+            if (x == std::string_view::npos) {
+                throw std::runtime_error("invalid value for --window: " + std::string{value});
+            }
+            window.width = parseUint("--window", value.substr(0, x));
+            window.height = parseUint("--window", value.substr(x + 1));
+            if (window.width == 0 || window.height == 0) {
+                throw std::runtime_error("--window size must be positive");
+            }
+            options.extra_windows.push_back(window);
+        } else if (matchOption(arg, "--capture", value)) {
+            options.capture = std::string{value};
+        } else if (matchOption(arg, "--capture-ring", value)) {
+            options.capture_ring_size = parseUint("--capture-ring", value);
+            if (options.capture_ring_size < 2) {
+                throw std::runtime_error("--capture-ring must be at least 2");
+            }
+        } else if (arg == "--dynamic-resolution") {
+            options.dynamic_resolution_budget_ms = 16.0;
+        } else if (matchOption(arg, "--dynamic-resolution", value)) {
+            options.dynamic_resolution_budget_ms = parseDouble("--dynamic-resolution", value);
+            if (options.dynamic_resolution_budget_ms <= 0.0) {
+                throw std::runtime_error("--dynamic-resolution budget must be positive");
+            }
+        } else if (matchOption(arg, "--min-scale", value)) {
+            options.dynamic_resolution_min_scale = static_cast<float>(parseDouble("--min-scale", value));
+            if (options.dynamic_resolution_min_scale <= 0.0f || options.dynamic_resolution_min_scale > 1.0f) {
+                throw std::runtime_error("--min-scale must be in (0, 1]");
+            }
+        } else if (matchOption(arg, "--draw-instances", value)) {
+            options.draw_instances = std::max(1u, parseUint("--draw-instances", value));
+        } else if (arg == "--variant-bench") {
+            options.variant_bench_frames = 240;
+        } else if (matchOption(arg, "--variant-bench", value)) {
+            options.variant_bench_frames = parseUint("--variant-bench", value);
+            if (options.variant_bench_frames < 8) {
+                throw std::runtime_error("--variant-bench needs at least 8 frames per variant");
+            }
+        } else if (matchOption(arg, "--meshlets", value)) {
+            options.meshlets = std::string{value};
+        } else if (matchOption(arg, "--mesh", value)) {
+            options.mesh = std::string{value};
+        } else if (matchOption(arg, "--scene", value)) {
+            options.scene_instances = parseUint("--scene", value);
+        } else if (arg == "--no-mesh-shaders") {
+            options.mesh_shaders = false;
+        } else if (arg == "--occlusion-culling") {
+            options.occlusion_culling = true;
+        } else if (matchOption(arg, "--textures", value)) {
+            options.textures = std::string{value};
+        } else if (matchOption(arg, "--texture-budget", value)) {
+            options.texture_budget_mib = parseUint("--texture-budget", value);
+        } else if (matchOption(arg, "--texture-upload", value)) {
+            options.texture_upload_mib = parseUint("--texture-upload", value);
+            if (options.texture_upload_mib == 0) {
+                throw std::runtime_error("--texture-upload must be at least 1");
+            }
+        } else if (arg == "--low-latency") {
+            options.low_latency = LatencyMode::automatic;
+        } else if (matchOption(arg, "--low-latency", value)) {
+            if (value == "auto") {
+                options.low_latency = LatencyMode::automatic;
+            } else if (value == "present-wait") {
+                options.low_latency = LatencyMode::present_wait;
+            } else if (value == "software") {
+                options.low_latency = LatencyMode::software;
+            } else {
+                throw std::runtime_error("invalid value for --low-latency: " + std::string{value});
+            }
+        } else if (matchOption(arg, "--latency-log", value)) {
+            options.latency_log = std::string{value};
+        } else {
+            printUsage();
+            throw std::runtime_error("unknown option: " + std::string{arg});
+        }
+    }
+    if (!options.mesh.empty() && !options.meshlets.empty()) {
+        throw std::runtime_error("--mesh and --meshlets cannot be combined");
+    }
+    if (options.variant_bench_frames > 0 && (!options.mesh.empty() || !options.meshlets.empty())) {
+        throw std::runtime_error("--variant-bench times the triangle and cannot be combined with --mesh or --meshlets");
+    }
+    if (options.scene_instances > 0 && options.mesh.empty()) {
+        throw std::runtime_error("--scene needs --mesh");
+    }
+    if (options.occlusion_culling && options.meshlets.empty()) {
+        throw std::runtime_error("--occlusion-culling needs --meshlets");
+    }
+    if (options.occlusion_culling && options.dynamic_resolution_budget_ms > 0.0) {
+        throw std::runtime_error("--occlusion-culling builds its pyramid at full resolution and cannot be combined with --dynamic-resolution");
+    }
+    if (!options.extra_windows.empty() && options.low_latency != LatencyMode::off) {
+        throw std::runtime_error("--low-latency paces a single display and cannot be combined with --window");
+    }
+    if (!options.extra_windows.empty() && !options.capture.empty()) {
+        throw std::runtime_error("--capture reads back every frame of the main window and cannot be combined with --window");
+    }
+    if (!options.latency_log.empty() && options.low_latency == LatencyMode::off) {
+        throw std::runtime_error("--latency-log needs --low-latency");
+    }
+    if (options.low_latency != LatencyMode::off && !options.capture.empty()) {
+        throw std::runtime_error("--low-latency paces frames to the display and cannot be combined with --capture");
+    }
+    return options;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum class LatencyMode
+{
+    // Frames start on a fixed timer, with up to max_frames_in_flight queued.
+    off,
+    // Present wait when the device supports it, the software estimate otherwise.
+    automatic,
+    present_wait,
+    software,
+};
+
+struct WindowOptions
+{
+    uint32_t width = 800;
+    uint32_t height = 600;
+    // Frames per second drawn into the window; 0 draws it with every frame.
+    double rate_hz = 0.0;
+};
+
+struct AppOptions
+{
+    uint32_t window_width = 800;
+    uint32_t window_height = 600;
+    // Additional windows showing the same view, presented together with the
+    // main window from one device.
+    std::vector<WindowOptions> extra_windows;
+    // "<sink>:<target>", see createCaptureSink(). Empty disables frame capture.
+    std::string capture;
+    // Number of readback buffers in flight; frames are handed to the sink once
+    // the GPU is done with them, so this bounds how far capture may lag behind.
+    uint32_t capture_ring_size = 3;
+    // Render into an offscreen target scaled to hold this GPU frame time; 0 renders
+    // straight into the swap chain at full resolution.
+    double dynamic_resolution_budget_ms = 0.0;
+    float dynamic_resolution_min_scale = 0.5f;
+    // Instances of the triangle drawn per frame, to put the GPU under load.
+    uint32_t draw_instances = 1;
+    // Frames to draw with each triangle pipeline variant, cycling through all of
+    // them and reporting their GPU times; 0 draws the default variant only.
+    uint32_t variant_bench_frames = 0;
+    // Meshlet file written by meshtool; replaces the triangle with a culled
+    // cluster mesh seen from an orbiting camera.
+    std::string meshlets;
+    // Use VK_EXT_mesh_shader for the meshlets when the device supports it,
+    // otherwise (or when false) cull in compute and draw indirect.
+    bool mesh_shaders = true;
+    // Two-phase occlusion culling of the meshlets against a depth pyramid built
+    // from a depth prepass; uses the compute path.
+    bool occlusion_culling = false;
+    // Mesh file written by "meshtool import"; replaces the triangle with the
+    // quantized mesh seen from an orbiting camera.
+    std::string mesh;
+    // Draw this many instances of the mesh from a generated scene, transformed
+    // and frustum culled on the CPU every frame; 0 draws the mesh once.
+    uint32_t scene_instances = 0;
+    // Directory whose *.ktx2 files are streamed in, coarsest mips first.
+    std::string textures;
+    // Cap for streamed texture memory in MiB; 0 follows the device memory budget.
+    uint32_t texture_budget_mib = 0;
+    // Texture data copied to the GPU per frame, in MiB.
+    uint32_t texture_upload_mib = 8;
+    // Starts frames just in time for their vblank with a FIFO swap chain, see
+    // FramePacer, and reports the latency from frame start to present.
+    LatencyMode low_latency = LatencyMode::off;
+    // CSV file receiving the latency of every presented frame.
+    std::string latency_log;
+};
+
+AppOptions parseOptions(int argc, char** argv);
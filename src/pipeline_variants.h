@@ -0,0 +1,128 @@
+#pragma once
+
+#include "vulkan/vulkan_core.h"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+
+// Compile-time description of the boolean specialization constants of a shader
+// pair. Features is a plain struct of VkBool32 members; member i is declared in
+// GLSL as "layout(constant_id = i) const bool ...", so a driver compiling a
+// variant sees constants and folds the disabled paths away. Features also lists
+// the member names in a static constexpr names array, for reports.
+template <typename Features>
+struct SpecializationLayout
+{
+    static_assert(std::is_trivially_copyable_v<Features> && sizeof(Features) % sizeof(VkBool32) == 0,
+                  "features must be a struct of VkBool32 members");
+    static constexpr uint32_t count = sizeof(Features) / sizeof(VkBool32);
+    static_assert(count > 0 && count <= 8, "variants are enumerated up front, keep the feature count small");
+    static_assert(std::size(Features::names) == count, "every feature needs a name");
+
+    static constexpr std::array<VkSpecializationMapEntry, count> entries()
+    {
+        std::array<VkSpecializationMapEntry, count> result{};
+        for (uint32_t i = 0; i < count; ++i) {
+            result[i] = { i, static_cast<uint32_t>(i * sizeof(VkBool32)), sizeof(VkBool32) };
+        }
+        return result;
+    }
+};
+
+// Graphics pipelines for every combination of Features, built the first time a
+// combination is asked for. Variants are identified by a key with bit i set when
+// feature i is enabled. The create function gets the specialization info to put
+// on the shader stages; constant IDs a stage does not declare are ignored.
+template <typename Features>
+class PipelineVariants {
+public:
+    using Layout = SpecializationLayout<Features>;
+    using CreateFunc = std::function<VkPipeline(const VkSpecializationInfo&)>;
+    static constexpr uint32_t variant_count = 1u << Layout::count;
+
+public:
+    PipelineVariants(VkDevice device, CreateFunc create)
+        : device_{device}
+        , create_{std::move(create)}
+    {
+    }
+    ~PipelineVariants()
+    {
+        for (auto pipeline: pipelines_) {
+            vkDestroyPipeline(device_, pipeline, nullptr);
+        }
+    }
+    PipelineVariants(const PipelineVariants&) = delete;
+    PipelineVariants& operator=(const PipelineVariants&) = delete;
+
+public:
+    static uint32_t key(const Features& features)
+    {
+        std::array<VkBool32, Layout::count> values;
+        std::memcpy(values.data(), &features, sizeof(features));
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < Layout::count; ++i) {
+            result |= values[i] ? 1u << i : 0u;
+        }
+        return result;
+    }
+    static Features features(uint32_t key)
+    {
+        std::array<VkBool32, Layout::count> values;
+        for (uint32_t i = 0; i < Layout::count; ++i) {
+            values[i] = (key >> i) & 1u ? VK_TRUE : VK_FALSE;
+        }
+        Features result;
+        std::memcpy(&result, values.data(), sizeof(result));
+        return result;
+    }
+    // "rotation+vertex_colors", or "none".
+    static std::string name(uint32_t key)
+    {
+        std::string result;
+        for (uint32_t i = 0; i < Layout::count; ++i) {
+            if ((key >> i) & 1u) {
+                result += (result.empty() ? "" : "+") + std::string(Features::names[i]);
+            }
+        }
+        return result.empty() ? "none" : result;
+    }
+
+    VkPipeline get(const Features& features) { return get(key(features)); }
+    VkPipeline get(uint32_t key)
+    {
+        if (key >= variant_count) {
+            throw std::out_of_range("pipeline variant key out of range: " + std::to_string(key));
+        }
+        if (pipelines_[key] == VK_NULL_HANDLE) {
+            static constexpr auto entries = Layout::entries();
+            const Features values = features(key);
+            VkSpecializationInfo info{};
+            info.mapEntryCount = Layout::count;
+            info.pMapEntries = entries.data();
+            info.dataSize = sizeof(values);
+            info.pData = &values;
+            auto start = std::chrono::steady_clock::now();
+            pipelines_[key] = create_(info);
+            build_ms_[key] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        return pipelines_[key];
+    }
+
+    bool built(uint32_t key) const { return pipelines_[key] != VK_NULL_HANDLE; }
+    // Time the create function took for the variant, 0 if it has not been built.
+    double buildMs(uint32_t key) const { return build_ms_[key]; }
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    CreateFunc create_;
+    std::array<VkPipeline, variant_count> pipelines_{};
+    std::array<double, variant_count> build_ms_{};
+};
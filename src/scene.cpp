@@ -0,0 +1,359 @@
+#include "scene.h"
+
+#include "draw_queue.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// SSE2 is part of x86-64; AVX2 only when the compiler targets it (ENABLE_AVX2).
+#if defined(__AVX2__)
+#define SCENE_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Nodes per cull() batch; a multiple of the widest vector.
+constexpr uint32_t cull_batch = 16384;
+constexpr uint32_t grid_group_size = 8;
+
+// Rotation about +Y followed by a translation.
+Mat4 makeTransform(float x, float y, float z, float angle)
+{
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+    return Mat4{ { c, 0.0f, -s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, s, 0.0f, c, 0.0f, x, y, z, 1.0f } };
+}
+
+// out = a * b. The vector paths keep the scalar summation order.
+void multiplyInto(const Mat4& a, const Mat4& b, Mat4& out)
+{
+#if defined(SCENE_AVX2)
+    // Two result columns per iteration: each 128-bit half broadcasts one
+    // column's elements of b against the columns of a.
+    const __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a.m));
+    const __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a.m + 4));
+    const __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a.m + 8));
+    const __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a.m + 12));
+    for (int c = 0; c < 4; c += 2) {
+        __m256 columns = _mm256_loadu_ps(b.m + c * 4);
+        __m256 sum = _mm256_mul_ps(a0, _mm256_permute_ps(columns, 0x00));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(a1, _mm256_permute_ps(columns, 0x55)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(a2, _mm256_permute_ps(columns, 0xaa)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(a3, _mm256_permute_ps(columns, 0xff)));
+        _mm256_storeu_ps(out.m + c * 4, sum);
+    }
+#elif defined(SCENE_SSE)
+    const __m128 a0 = _mm_loadu_ps(a.m);
+    const __m128 a1 = _mm_loadu_ps(a.m + 4);
+    const __m128 a2 = _mm_loadu_ps(a.m + 8);
+    const __m128 a3 = _mm_loadu_ps(a.m + 12);
+    for (int c = 0; c < 4; ++c) {
+        const float* column = b.m + c * 4;
+        __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+        _mm_storeu_ps(out.m + c * 4, sum);
+    }
+#else
+    out = multiply(a, b);
+#endif
+}
+
+} // namespace
+
+const char* Scene::simdPath()
+{
+#if defined(SCENE_AVX2)
+    return "AVX2";
+#elif defined(SCENE_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+NodeId Scene::addNode(NodeId parent, const Mat4& local, const float local_center[3], const float local_extents[3],
+                      uint32_t mesh, uint32_t material)
+{
+    if (parent != no_node && parent >= size()) {
+        throw std::invalid_argument("scene node parent has to be added before its children");
+    }
+    const NodeId node = size();
+    parents_.push_back(parent);
+    meshes_.push_back(mesh);
+    materials_.push_back(material);
+    flags_.push_back(flag_dirty | (mesh != no_mesh ? flag_drawable : 0));
+    local_.push_back(local);
+    world_.push_back(local);
+    for (int c = 0; c < 3; ++c) {
+        local_center_[c].push_back(local_center[c]);
+        local_extents_[c].push_back(local_extents[c]);
+        center_[c].push_back(0.0f);
+        extents_[c].push_back(0.0f);
+    }
+    radius_.push_back(0.0f);
+    first_dirty_ = std::min(first_dirty_, node);
+    return node;
+}
+
+void Scene::setLocalTransform(NodeId node, const Mat4& local)
+{
+    local_[node] = local;
+    flags_[node] |= flag_dirty;
+    first_dirty_ = std::min(first_dirty_, node);
+}
+
+uint32_t Scene::updateTransforms()
+{
+    if (first_dirty_ == no_node) {
+        return 0;
+    }
+    uint32_t moved = 0;
+    for (NodeId node = first_dirty_; node < size(); ++node) {
+        const NodeId parent = parents_[node];
+        // Parents before first_dirty_ did not move; their flag is from an
+        // earlier update.
+        const bool parent_moved = parent != no_node && parent >= first_dirty_ && (flags_[parent] & flag_moved);
+        if (!(flags_[node] & flag_dirty) && !parent_moved) {
+            flags_[node] &= ~flag_moved;
+            continue;
+        }
+        if (parent == no_node) {
+            world_[node] = local_[node];
+        } else {
+            multiplyInto(world_[parent], local_[node], world_[node]);
+        }
+        updateBounds(node);
+        flags_[node] = (flags_[node] & ~flag_dirty) | flag_moved;
+        ++moved;
+    }
+    first_dirty_ = no_node;
+    return moved;
+}
+
+// Transforms the node box by the world matrix; the new extents are the box's
+// reach along each world axis.
+void Scene::updateBounds(NodeId node)
+{
+    const float* m = world_[node].m;
+    const float local_center[3] = { local_center_[0][node], local_center_[1][node], local_center_[2][node] };
+    const float local_extents[3] = { local_extents_[0][node], local_extents_[1][node], local_extents_[2][node] };
+    float radius_squared = 0.0f;
+    for (int r = 0; r < 3; ++r) {
+        float center = m[12 + r];
+        float extent = 0.0f;
+        for (int c = 0; c < 3; ++c) {
+            center += m[c * 4 + r] * local_center[c];
+            extent += std::abs(m[c * 4 + r]) * local_extents[c];
+        }
+        center_[r][node] = center;
+        extents_[r][node] = extent;
+        radius_squared += extent * extent;
+    }
+    radius_[node] = std::sqrt(radius_squared);
+}
+
+void Scene::worldSphere(NodeId node, float center[3], float& radius) const
+{
+    for (int c = 0; c < 3; ++c) {
+        center[c] = center_[c][node];
+    }
+    radius = radius_[node];
+}
+
+bool Scene::isVisible(const float frustum_planes[6][4], CullTest test, NodeId node) const
+{
+    for (int i = 0; i < 6; ++i) {
+        const float* plane = frustum_planes[i];
+        float distance = plane[0] * center_[0][node] + plane[1] * center_[1][node] + plane[2] * center_[2][node] + plane[3];
+        float reach = test == CullTest::sphere ? radius_[node]
+                                               : std::abs(plane[0]) * extents_[0][node] + std::abs(plane[1]) * extents_[1][node] +
+                                                     std::abs(plane[2]) * extents_[2][node];
+        if (distance + reach < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Scene::cullRange(const float frustum_planes[6][4], CullTest test, NodeId first, NodeId last,
+                      std::vector<NodeId>& visible) const
+{
+    // mask has one bit per node from the vector test; drawable is checked after.
+    auto append = [&](NodeId node, int mask, uint32_t width) {
+        for (uint32_t lane = 0; lane < width; ++lane) {
+            if (((mask >> lane) & 1) && (flags_[node + lane] & flag_drawable)) {
+                visible.push_back(node + lane);
+            }
+        }
+    };
+    const bool sphere = test == CullTest::sphere;
+    NodeId node = first;
+
+#if defined(SCENE_AVX2)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 planes[6][4];
+        __m256 abs_normals[6][3];
+        for (int i = 0; i < 6; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                planes[i][c] = _mm256_set1_ps(frustum_planes[i][c]);
+            }
+            for (int c = 0; c < 3; ++c) {
+                abs_normals[i][c] = _mm256_set1_ps(std::abs(frustum_planes[i][c]));
+            }
+        }
+        for (; last - node >= 8; node += 8) {
+            const __m256 x = _mm256_loadu_ps(&center_[0][node]);
+            const __m256 y = _mm256_loadu_ps(&center_[1][node]);
+            const __m256 z = _mm256_loadu_ps(&center_[2][node]);
+            const __m256 radius = _mm256_loadu_ps(&radius_[node]);
+            const __m256 ex = _mm256_loadu_ps(&extents_[0][node]);
+            const __m256 ey = _mm256_loadu_ps(&extents_[1][node]);
+            const __m256 ez = _mm256_loadu_ps(&extents_[2][node]);
+            __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+            for (int i = 0; i < 6; ++i) {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(planes[i][0], x), _mm256_mul_ps(planes[i][1], y));
+                distance = _mm256_add_ps(_mm256_add_ps(distance, _mm256_mul_ps(planes[i][2], z)), planes[i][3]);
+                __m256 reach = radius;
+                if (!sphere) {
+                    reach = _mm256_add_ps(_mm256_mul_ps(abs_normals[i][0], ex), _mm256_mul_ps(abs_normals[i][1], ey));
+                    reach = _mm256_add_ps(reach, _mm256_mul_ps(abs_normals[i][2], ez));
+                }
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+            }
+            append(node, _mm256_movemask_ps(inside), 8);
+        }
+    }
+#endif
+#if defined(SCENE_SSE)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        __m128 planes[6][4];
+        __m128 abs_normals[6][3];
+        for (int i = 0; i < 6; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                planes[i][c] = _mm_set1_ps(frustum_planes[i][c]);
+            }
+            for (int c = 0; c < 3; ++c) {
+                abs_normals[i][c] = _mm_set1_ps(std::abs(frustum_planes[i][c]));
+            }
+        }
+        for (; last - node >= 4; node += 4) {
+            const __m128 x = _mm_loadu_ps(&center_[0][node]);
+            const __m128 y = _mm_loadu_ps(&center_[1][node]);
+            const __m128 z = _mm_loadu_ps(&center_[2][node]);
+            const __m128 radius = _mm_loadu_ps(&radius_[node]);
+            const __m128 ex = _mm_loadu_ps(&extents_[0][node]);
+            const __m128 ey = _mm_loadu_ps(&extents_[1][node]);
+            const __m128 ez = _mm_loadu_ps(&extents_[2][node]);
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            for (int i = 0; i < 6; ++i) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(planes[i][0], x), _mm_mul_ps(planes[i][1], y));
+                distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(planes[i][2], z)), planes[i][3]);
+                __m128 reach = radius;
+                if (!sphere) {
+                    reach = _mm_add_ps(_mm_mul_ps(abs_normals[i][0], ex), _mm_mul_ps(abs_normals[i][1], ey));
+                    reach = _mm_add_ps(reach, _mm_mul_ps(abs_normals[i][2], ez));
+                }
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+            }
+            append(node, _mm_movemask_ps(inside), 4);
+        }
+    }
+#endif
+    for (; node < last; ++node) {
+        if ((flags_[node] & flag_drawable) && isVisible(frustum_planes, test, node)) {
+            visible.push_back(node);
+        }
+    }
+}
+
+void Scene::cull(const float frustum_planes[6][4], CullTest test, JobSystem* jobs, std::vector<NodeId>& visible)
+{
+    visible.clear();
+    if (!jobs || size() <= cull_batch) {
+        cullRange(frustum_planes, test, 0, size(), visible);
+        return;
+    }
+    batch_visible_.resize((size() + cull_batch - 1) / cull_batch);
+    jobs->parallelFor(size(), cull_batch, [&](uint32_t first, uint32_t last) {
+        std::vector<NodeId>& batch = batch_visible_[first / cull_batch];
+        batch.clear();
+        cullRange(frustum_planes, test, first, last, batch);
+    });
+    for (const auto& batch: batch_visible_) {
+        visible.insert(visible.end(), batch.begin(), batch.end());
+    }
+}
+
+GridScene buildGridScene(Scene& scene, uint32_t instance_count, const float mesh_center[3], float mesh_radius,
+                         uint32_t material_count)
+{
+    const uint32_t per_group = grid_group_size * grid_group_size;
+    const uint32_t group_count = (instance_count + per_group - 1) / per_group;
+    const uint32_t groups_per_row = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(group_count))));
+    const float spacing = mesh_radius * 2.5f;
+    const float group_width = spacing * grid_group_size;
+    const float grid_offset = (groups_per_row - 1) * group_width * 0.5f;
+    const float mesh_extents[3] = { mesh_radius, mesh_radius, mesh_radius };
+    const float no_extents[3] = {};
+    const float origin[3] = {};
+
+    GridScene grid{};
+    grid.groups.reserve(group_count);
+    const NodeId root = scene.addNode(no_node, makeTransform(0.0f, 0.0f, 0.0f, 0.0f), origin, no_extents);
+    for (uint32_t g = 0; g < group_count; ++g) {
+        float x = (g % groups_per_row) * group_width - grid_offset;
+        float z = (g / groups_per_row) * group_width - grid_offset;
+        NodeId group = scene.addNode(root, makeTransform(x, 0.0f, z, 0.0f), origin, no_extents);
+        grid.groups.push_back(group);
+        const uint32_t count = std::min(per_group, instance_count - g * per_group);
+        for (uint32_t i = 0; i < count; ++i) {
+            float offset_x = ((i % grid_group_size) - (grid_group_size - 1) * 0.5f) * spacing;
+            float offset_z = ((i / grid_group_size) - (grid_group_size - 1) * 0.5f) * spacing;
+            scene.addNode(group, makeTransform(offset_x, 0.0f, offset_z, i * 0.7f), mesh_center, mesh_extents, 0,
+                          i % material_count);
+        }
+    }
+    grid.center[0] = 0.0f;
+    grid.center[1] = mesh_center[1];
+    grid.center[2] = 0.0f;
+    grid.radius = (grid_offset + group_width * 0.5f) * std::sqrt(2.0f) + mesh_radius;
+    return grid;
+}
+
+void animateGridScene(Scene& scene, const GridScene& grid, float time, uint32_t stride)
+{
+    for (size_t g = 0; g < grid.groups.size(); g += stride) {
+        const Mat4& local = scene.localTransform(grid.groups[g]);
+        scene.setLocalTransform(grid.groups[g], makeTransform(local.m[12], local.m[13], local.m[14], time + g));
+    }
+}
+
+void queueSceneDraws(const Scene& scene, const std::vector<NodeId>& visible, const Camera& camera, float depth_range,
+                     DrawQueue& queue)
+{
+    const float* view = camera.view.m;
+    queue.clear();
+    for (NodeId node: visible) {
+        float center[3];
+        float radius = 0.0f;
+        scene.worldSphere(node, center, radius);
+        float view_depth = -(view[2] * center[0] + view[6] * center[1] + view[10] * center[2] + view[14]);
+        DrawKeyFields fields{};
+        fields.material = scene.material(node);
+        fields.pipeline = scenePipeline(fields.material);
+        fields.mesh = scene.mesh(node);
+        fields.depth = quantizeDrawDepth(view_depth / depth_range);
+        queue.push(packDrawKey(fields), node);
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "camera.h"
+
+#include <stdint.h>
+#include <vector>
+
+class DrawQueue;
+class JobSystem;
+
+using NodeId = uint32_t;
+constexpr NodeId no_node = ~0u;
+
+enum class CullTest
+{
+    // World bounding sphere: four values per node, the cheaper test.
+    sphere,
+    // World axis aligned box: six values per node, rejects more.
+    box,
+};
+
+// Data-oriented scene store. Every node attribute lives in its own array
+// indexed by NodeId, and nodes are added after their parents, so one pass in
+// index order sees every parent's world transform before its children.
+//
+// Nodes with a mesh are drawn with their material. Groups without one only
+// carry transforms.
+// setLocalTransform() marks a node dirty. updateTransforms() recomputes the
+// dirty nodes and everything below them, starting at the first dirty index.
+// cull() writes the drawable nodes inside a frustum, in node order, to a
+// compact list.
+class Scene {
+public:
+    static constexpr uint32_t no_mesh = ~0u;
+
+    // Name of the vector path compiled in: "AVX2", "SSE" or "scalar".
+    static const char* simdPath();
+
+public:
+    // Parent must already exist; local_center and local_extents describe the
+    // node's box in its own space.
+    NodeId addNode(NodeId parent, const Mat4& local, const float local_center[3], const float local_extents[3],
+                   uint32_t mesh = no_mesh, uint32_t material = 0);
+    void setLocalTransform(NodeId node, const Mat4& local);
+    // Returns the number of nodes whose world transform changed.
+    uint32_t updateTransforms();
+
+    // Culls against world space planes, pointing inside as in Camera. With
+    // jobs the nodes are split into batches that run on the workers and on the
+    // calling thread, which must not be a worker itself.
+    void cull(const float frustum_planes[6][4], CullTest test, JobSystem* jobs, std::vector<NodeId>& visible);
+    // Appends the visible drawable nodes in [first, last).
+    void cullRange(const float frustum_planes[6][4], CullTest test, NodeId first, NodeId last,
+                   std::vector<NodeId>& visible) const;
+    // Reference test of a single node, without SIMD.
+    bool isVisible(const float frustum_planes[6][4], CullTest test, NodeId node) const;
+
+    uint32_t size() const { return static_cast<uint32_t>(parents_.size()); }
+    NodeId parent(NodeId node) const { return parents_[node]; }
+    uint32_t mesh(NodeId node) const { return meshes_[node]; }
+    uint32_t material(NodeId node) const { return materials_[node]; }
+    const Mat4& localTransform(NodeId node) const { return local_[node]; }
+    const Mat4& worldTransform(NodeId node) const { return world_[node]; }
+    // World bounding sphere, valid after updateTransforms().
+    void worldSphere(NodeId node, float center[3], float& radius) const;
+
+private:
+    enum Flags : uint8_t
+    {
+        flag_dirty = 1,
+        // World transform recomputed by the last update.
+        flag_moved = 2,
+        flag_drawable = 4,
+    };
+
+    void updateBounds(NodeId node);
+
+private:
+    std::vector<NodeId> parents_;
+    std::vector<uint32_t> meshes_;
+    std::vector<uint32_t> materials_;
+    std::vector<uint8_t> flags_;
+    std::vector<Mat4> local_;
+    std::vector<Mat4> world_;
+    // Node space box.
+    std::vector<float> local_center_[3];
+    std::vector<float> local_extents_[3];
+    // World box, one array per component so the tests load 4 or 8 nodes at
+    // once; the sphere encloses the box.
+    std::vector<float> center_[3];
+    std::vector<float> extents_[3];
+    std::vector<float> radius_;
+    NodeId first_dirty_ = no_node;
+    // Per batch results of cull() with jobs, kept to reuse their memory.
+    std::vector<std::vector<NodeId>> batch_visible_;
+};
+
+// Generated scene for --scene and "meshtool scene-bench": instances of mesh 0
+// in groups of 64 on a square grid, every group a child of one root.
+// Neighbouring instances cycle through material_count materials, the worst
+// case for drawing in scene order.
+struct GridScene
+{
+    std::vector<NodeId> groups;
+    // Bounding sphere of the whole grid, for placing the camera.
+    float center[3];
+    float radius;
+};
+
+// mesh_center and mesh_radius are the bounding sphere of the instanced mesh.
+GridScene buildGridScene(Scene& scene, uint32_t instance_count, const float mesh_center[3], float mesh_radius,
+                         uint32_t material_count = 1);
+// Spins every stride-th group about its vertical axis, so only those groups
+// and their instances are dirty.
+void animateGridScene(Scene& scene, const GridScene& grid, float time, uint32_t stride);
+
+// Materials of --scene, as MeshRenderer creates them. Odd materials are
+// two-sided and drawn with the second pipeline, which keeps back faces.
+constexpr uint32_t scene_material_count = 8;
+constexpr uint32_t scene_pipeline_count = 2;
+inline uint32_t scenePipeline(uint32_t material) { return material % scene_pipeline_count; }
+
+// Refills queue with a draw per visible node, keyed by the pipeline and
+// material of the node, its mesh and its view depth over depth_range, so that
+// the draws of one state go front to back. The payload is the node.
+void queueSceneDraws(const Scene& scene, const std::vector<NodeId>& visible, const Camera& camera, float depth_range,
+                     DrawQueue& queue);
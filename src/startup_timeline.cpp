@@ -0,0 +1,131 @@
+#include "startup_timeline.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
+namespace {
+
+double toMs(StartupTimeline::clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+} // namespace
+
+StartupTimeline::Scope::Scope(StartupTimeline& timeline, std::string name, std::string waited_on)
+    : timeline_{timeline}, name_{std::move(name)}, waited_on_{std::move(waited_on)}, begin_{clock::now()}
+{
+}
+
+StartupTimeline::Scope::~Scope()
+{
+    timeline_.record(std::move(name_), begin_, clock::now(), std::move(waited_on_));
+}
+
+StartupTimeline::StartupTimeline()
+    : origin_{clock::now()}, main_thread_{std::this_thread::get_id()}
+{
+}
+
+void StartupTimeline::record(std::string name, clock::time_point begin, clock::time_point end, std::string waited_on)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    events_.push_back(Event{std::move(name), std::this_thread::get_id(), begin, end, std::move(waited_on)});
+}
+
+void StartupTimeline::print(std::ostream& os) const
+{
+    std::vector<Event> events;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        events = events_;
+    }
+    if (events.empty()) {
+        return;
+    }
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.begin < b.begin;
+    });
+
+    clock::time_point last_end = origin_;
+    int last = 0;
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (events[i].end > last_end) {
+            last_end = events[i].end;
+            last = static_cast<int>(i);
+        }
+    }
+    const double total_ms = toMs(last_end - origin_);
+
+    // The event matching filter that ends last at or before time.
+    auto latestBefore = [&events](clock::time_point time, auto filter) {
+        int found = -1;
+        for (size_t i = 0; i < events.size(); ++i) {
+            if (events[i].end <= time && filter(events[i]) && (found < 0 || events[i].end >= events[found].end)) {
+                found = static_cast<int>(i);
+            }
+        }
+        return found;
+    };
+    std::vector<bool> critical(events.size(), false);
+    std::vector<bool> visited(events.size(), false);
+    for (int current = last; current >= 0 && !visited[current]; ) {
+        visited[current] = true;
+        const Event& event = events[current];
+        if (!event.waited_on.empty()) {
+            int target = latestBefore(event.end, [&event](const Event& e) { return e.name == event.waited_on; });
+            if (target >= 0 && events[target].end > event.begin) {
+                // The wait blocked, so the path runs through the event it waited on.
+                current = target;
+                continue;
+            }
+        }
+        critical[current] = true;
+        int previous = latestBefore(event.begin, [&event](const Event& e) { return e.thread == event.thread; });
+        if (previous < 0 && event.thread != main_thread_) {
+            // The first event of a worker: back to where the main thread started it.
+            previous = latestBefore(event.begin, [this](const Event& e) { return e.thread == main_thread_; });
+        }
+        current = previous;
+    }
+
+    std::map<std::thread::id, int> thread_labels;
+    thread_labels[main_thread_] = 0;
+
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    constexpr int bar_width = 40;
+    double critical_ms = 0.0;
+    double worker_ms = 0.0;
+    os << "Startup timeline (" << std::fixed << std::setprecision(2) << total_ms << " ms, * = critical path):" << std::endl;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const Event& event = events[i];
+        auto label = thread_labels.emplace(event.thread, static_cast<int>(thread_labels.size())).first->second;
+        const bool on_path = critical[i];
+        const double begin_ms = toMs(event.begin - origin_);
+        const double duration_ms = toMs(event.end - event.begin);
+        if (on_path) {
+            critical_ms += duration_ms;
+            if (event.thread != main_thread_) {
+                worker_ms += duration_ms;
+            }
+        }
+
+        int bar_begin = total_ms > 0.0 ? static_cast<int>(begin_ms / total_ms * bar_width) : 0;
+        int bar_len = total_ms > 0.0 ? std::max(1, static_cast<int>(duration_ms / total_ms * bar_width)) : 1;
+        bar_begin = std::min(bar_begin, bar_width - 1);
+        bar_len = std::min(bar_len, bar_width - bar_begin);
+        std::string bar(bar_width, ' ');
+        bar.replace(bar_begin, bar_len, bar_len, on_path ? '#' : '=');
+
+        os << "\t" << (on_path ? '*' : ' ')
+           << " [" << bar << "] "
+           << std::setw(8) << begin_ms << " +" << std::setw(8) << duration_ms << " ms"
+           << "  " << (label == 0 ? std::string{"main"} : "worker " + std::to_string(label))
+           << "  " << event.name << std::endl;
+    }
+    os << "\tcritical path: " << critical_ms << " ms measured, of which on workers: " << worker_ms << " ms" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
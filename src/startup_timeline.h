@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Records named [begin, end) intervals from any thread during startup and prints
+// them as a timeline. The critical path is found by walking back from the event
+// that ends last: through the events of its thread, back to the main thread
+// where a worker was started, and into the worker event a wait recorded with
+// measureWait() actually blocked on.
+class StartupTimeline {
+public:
+    using clock = std::chrono::steady_clock;
+
+    class Scope {
+    public:
+        Scope(StartupTimeline& timeline, std::string name, std::string waited_on = {});
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StartupTimeline& timeline_;
+        std::string name_;
+        std::string waited_on_;
+        clock::time_point begin_;
+    };
+
+public:
+    StartupTimeline();
+
+    template <typename Func>
+    auto measure(std::string name, Func&& func)
+    {
+        Scope scope{*this, std::move(name)};
+        return func();
+    }
+
+    // Measures func as a wait for the event named waited_on, usually recorded on
+    // a worker thread.
+    template <typename Func>
+    auto measureWait(std::string name, std::string waited_on, Func&& func)
+    {
+        Scope scope{*this, std::move(name), std::move(waited_on)};
+        return func();
+    }
+
+    void record(std::string name, clock::time_point begin, clock::time_point end, std::string waited_on = {});
+    void print(std::ostream& os) const;
+
+private:
+    struct Event
+    {
+        std::string name;
+        std::thread::id thread;
+        clock::time_point begin;
+        clock::time_point end;
+        std::string waited_on;
+    };
+
+    clock::time_point origin_;
+    std::thread::id main_thread_;
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+};
@@ -0,0 +1,518 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Copy offsets have to be a multiple of 4 and of the texel block size, which is
+// at most 16 bytes for every format the streamer accepts.
+constexpr VkDeviceSize staging_alignment = 16;
+// The budget only changes when allocations change, so it is not worth a driver
+// call every frame.
+constexpr uint64_t memory_cap_update_interval = 60;
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+double toMiB(VkDeviceSize bytes)
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+TextureStreamer::TextureStreamer(VkPhysicalDevice physical_device, VkDevice device,
+                                 const VkPhysicalDeviceMemoryProperties& mem_props, bool memory_budget, JobSystem& jobs,
+                                 const TextureStreamerConfig& config)
+    : physical_device_(physical_device)
+    , device_(device)
+    , mem_props_(mem_props)
+    , memory_budget_(memory_budget)
+    , jobs_(jobs)
+    , config_(config)
+{
+    if (config_.upload_budget == 0 || config_.frame_count == 0) {
+        throw std::invalid_argument("texture streamer needs an upload budget and at least one frame slot");
+    }
+    // Textures go to the largest device local heap.
+    for (uint32_t i = 0; i < mem_props_.memoryHeapCount; ++i) {
+        if ((mem_props_.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+            mem_props_.memoryHeaps[i].size > mem_props_.memoryHeaps[heap_index_].size) {
+            heap_index_ = i;
+        }
+    }
+    try {
+        for (uint32_t i = 0; i < config_.frame_count; ++i) {
+            staging_.push_back(utils::createBuffer(device_, mem_props_, config_.upload_budget, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+        }
+    } catch (...) {
+        for (auto& buffer: staging_) {
+            utils::destroyBuffer(device_, buffer);
+        }
+        throw;
+    }
+    updateMemoryCap();
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    for (auto& texture: textures_) {
+        if (texture->promotion && texture->promotion->started) {
+            utils::destroyImage(device_, texture->promotion->image);
+        }
+        if (texture->image.image != VK_NULL_HANDLE) {
+            utils::destroyImage(device_, texture->image);
+        }
+    }
+    retired_.flush();
+    for (auto& buffer: staging_) {
+        utils::destroyBuffer(device_, buffer);
+    }
+}
+
+TextureStreamer::TextureId TextureStreamer::addTexture(const std::string& path)
+{
+    auto texture = std::make_unique<Texture>();
+    texture->path = path;
+    texture->info = readKtx2Info(path);
+    const Ktx2Info& info = texture->info;
+    VkFormatProperties format_props{};
+    vkGetPhysicalDeviceFormatProperties(physical_device_, info.format, &format_props);
+    if (!(format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        throw std::runtime_error("texture format " + std::to_string(info.format) + " cannot be sampled on this device: " + path);
+    }
+    if (info.levelRowPitch(0) > config_.upload_budget) {
+        throw std::runtime_error("texture rows are larger than the upload budget: " + path);
+    }
+    texture->tail_level = info.levelCount() - 1;
+    while (texture->tail_level > 0) {
+        VkExtent2D extent = info.levelExtent(texture->tail_level - 1);
+        if (std::max(extent.width, extent.height) > config_.tail_size) {
+            break;
+        }
+        --texture->tail_level;
+    }
+    texture->resident_level = info.levelCount();
+    texture->committed_level = info.levelCount();
+
+    if (textures_.empty()) {
+        first_added_ = std::chrono::steady_clock::now();
+    }
+    textures_.push_back(std::move(texture));
+    tails_ready_ms_.reset();
+    return static_cast<TextureId>(textures_.size() - 1);
+}
+
+void TextureStreamer::touch(TextureId id, uint64_t frame_number)
+{
+    Texture& texture = *textures_.at(id);
+    texture.last_used = std::max(texture.last_used, frame_number);
+}
+
+VkImageView TextureStreamer::view(TextureId id) const
+{
+    return textures_.at(id)->image.view;
+}
+
+uint32_t TextureStreamer::residentLevel(TextureId id) const
+{
+    return textures_.at(id)->resident_level;
+}
+
+void TextureStreamer::recordUpdate(VkCommandBuffer command_buffer, uint32_t frame_slot, uint64_t frame_number)
+{
+    if (frame_number % memory_cap_update_interval == 0) {
+        updateMemoryCap();
+    }
+    pollDecodes();
+    // The budget shrinks when other allocations grow; give memory back, coldest first.
+    if (committed_bytes_ > memory_cap_) {
+        makeRoom(command_buffer, 0, nullptr, 0, frame_number);
+    }
+    recordUploads(command_buffer, frame_slot, frame_number);
+    startDecodes(command_buffer, frame_number);
+}
+
+void TextureStreamer::retire(uint64_t frames_completed)
+{
+    retired_.collect(frames_completed);
+}
+
+void TextureStreamer::retireImage(const utils::Image& image, VkDeviceSize bytes, uint64_t frame_number)
+{
+    retired_.push(frame_number, [this, image = image, bytes]() mutable {
+        utils::destroyImage(device_, image);
+        allocated_bytes_ -= bytes;
+    });
+}
+
+void TextureStreamer::pollDecodes()
+{
+    auto it = std::remove_if(decoding_.begin(), decoding_.end(), [&](TextureId id) {
+        Texture& texture = *textures_[id];
+        if (texture.decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+        auto promotion = std::make_unique<Promotion>();
+        // Rethrows read and decompression errors on the render thread.
+        promotion->levels = texture.decode.get();
+        promotion->first_level = texture.committed_level;
+        promotion->upload_level = texture.committed_level;
+        texture.promotion = std::move(promotion);
+        uploads_.push_back(id);
+        return true;
+    });
+    decoding_.erase(it, decoding_.end());
+}
+
+void TextureStreamer::startDecodes(VkCommandBuffer command_buffer, uint64_t frame_number)
+{
+    const size_t max_decodes = std::max<size_t>(2, jobs_.threadCount() * 2);
+    if (decoding_.size() >= max_decodes) {
+        return;
+    }
+
+    std::vector<TextureId> candidates;
+    for (TextureId id = 0; id < textures_.size(); ++id) {
+        const Texture& texture = *textures_[id];
+        if (!texture.busy() && texture.committed_level > 0) {
+            candidates.push_back(id);
+        }
+    }
+    // Missing tails first, then the most recently used textures, smallest next
+    // level first so resolution grows evenly across the scene.
+    auto next_size = [&](const Texture& texture) {
+        return texture.info.levelSize(texture.committed_level - 1);
+    };
+    std::sort(candidates.begin(), candidates.end(), [&](TextureId a, TextureId b) {
+        const Texture& ta = *textures_[a];
+        const Texture& tb = *textures_[b];
+        bool a_tail = ta.committed_level == ta.info.levelCount();
+        bool b_tail = tb.committed_level == tb.info.levelCount();
+        if (a_tail != b_tail) {
+            return a_tail;
+        }
+        if (ta.last_used != tb.last_used) {
+            return ta.last_used > tb.last_used;
+        }
+        return next_size(ta) < next_size(tb);
+    });
+
+    for (TextureId id: candidates) {
+        if (decoding_.size() >= max_decodes) {
+            break;
+        }
+        Texture& texture = *textures_[id];
+        const uint32_t last_level = texture.committed_level;
+        const uint32_t first_level = last_level == texture.info.levelCount() ? texture.tail_level : last_level - 1;
+        const VkDeviceSize extra = levelsSize(texture, first_level) - levelsSize(texture, last_level);
+        if (!makeRoom(command_buffer, extra, &texture, first_level, frame_number)) {
+            continue;
+        }
+        committed_bytes_ += extra;
+        texture.committed_level = first_level;
+        texture.decode = jobs_.submit([path = texture.path, info = texture.info, first_level, last_level] {
+            std::vector<std::vector<uint8_t>> levels;
+            for (uint32_t level = first_level; level < last_level; ++level) {
+                levels.push_back(readKtx2Level(path, info, level));
+            }
+            return levels;
+        });
+        decoding_.push_back(id);
+    }
+}
+
+void TextureStreamer::recordUploads(VkCommandBuffer command_buffer, uint32_t frame_slot, uint64_t frame_number)
+{
+    utils::Buffer& staging = staging_[frame_slot];
+    uint8_t* mapped = static_cast<uint8_t*>(staging.mapped);
+    VkDeviceSize offset = 0;
+    size_t finished = 0;
+    std::vector<VkBufferImageCopy> regions;
+
+    for (TextureId id: uploads_) {
+        Texture& texture = *textures_[id];
+        Promotion& promotion = *texture.promotion;
+        const Ktx2Info& info = texture.info;
+        if (!promotion.started) {
+            startPromotion(command_buffer, texture);
+        }
+
+        regions.clear();
+        const uint32_t end_level = promotion.first_level + static_cast<uint32_t>(promotion.levels.size());
+        while (promotion.upload_level < end_level) {
+            const uint32_t level = promotion.upload_level;
+            const VkExtent2D extent = info.levelExtent(level);
+            const VkDeviceSize row_pitch = info.levelRowPitch(level);
+            const uint32_t rows = info.levelBlockRows(level);
+            offset = alignUp(offset, staging_alignment);
+            const VkDeviceSize space = offset < staging.size ? staging.size - offset : 0;
+            const uint32_t band = static_cast<uint32_t>(std::min<VkDeviceSize>(rows - promotion.upload_row, space / row_pitch));
+            if (band == 0) {
+                break;
+            }
+
+            std::vector<uint8_t>& data = promotion.levels[level - promotion.first_level];
+            std::memcpy(mapped + offset, data.data() + promotion.upload_row * row_pitch, band * row_pitch);
+            const uint32_t y = promotion.upload_row * info.block.height;
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level - promotion.first_level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, static_cast<int32_t>(y), 0};
+            region.imageExtent = {extent.width, std::min(band * info.block.height, extent.height - y), 1};
+            regions.push_back(region);
+
+            offset += band * row_pitch;
+            uploaded_bytes_ += band * row_pitch;
+            promotion.upload_row += band;
+            if (promotion.upload_row == rows) {
+                data = {};
+                promotion.upload_row = 0;
+                ++promotion.upload_level;
+            }
+        }
+        if (!regions.empty()) {
+            vkCmdCopyBufferToImage(command_buffer, staging.buffer, promotion.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(regions.size()), regions.data());
+        }
+        if (promotion.upload_level < end_level) {
+            break;
+        }
+        finishPromotion(command_buffer, texture, frame_number);
+        ++finished;
+    }
+    uploads_.erase(uploads_.begin(), uploads_.begin() + finished);
+}
+
+void TextureStreamer::startPromotion(VkCommandBuffer command_buffer, Texture& texture)
+{
+    Promotion& promotion = *texture.promotion;
+    promotion.image = createLevelsImage(texture, promotion.first_level, promotion.image_bytes);
+    allocated_bytes_ += promotion.image_bytes;
+    promotion.started = true;
+
+    utils::imageBarrier(command_buffer, promotion.image.image,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    if (texture.image.image == VK_NULL_HANDLE) {
+        return;
+    }
+    // The current image stays in use until the promotion is complete, so it goes
+    // back to being sampled right after its levels are copied.
+    utils::imageBarrier(command_buffer, texture.image.image,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    copyLevels(command_buffer, texture, texture.image, texture.resident_level, promotion.image, promotion.first_level,
+               texture.resident_level);
+    utils::imageBarrier(command_buffer, texture.image.image,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void TextureStreamer::finishPromotion(VkCommandBuffer command_buffer, Texture& texture, uint64_t frame_number)
+{
+    Promotion& promotion = *texture.promotion;
+    utils::imageBarrier(command_buffer, promotion.image.image,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    if (texture.image.image != VK_NULL_HANDLE) {
+        retireImage(texture.image, texture.image_bytes, frame_number);
+    } else if (++tails_resident_ == textures_.size()) {
+        using ms = std::chrono::duration<double, std::milli>;
+        tails_ready_ms_ = ms(std::chrono::steady_clock::now() - first_added_).count();
+    }
+    texture.image = promotion.image;
+    texture.image_bytes = promotion.image_bytes;
+    texture.resident_level = promotion.first_level;
+    texture.promotion.reset();
+}
+
+bool TextureStreamer::makeRoom(VkCommandBuffer command_buffer, VkDeviceSize extra, const Texture* requester,
+                               uint32_t requested_level, uint64_t frame_number)
+{
+    // Evictions are planned before any is recorded, so no level is given up for
+    // a promotion that would still not fit.
+    std::vector<std::pair<Texture*, uint32_t>> plan;
+    auto planned_level = [&plan](const Texture& texture) {
+        for (const auto& [victim, level]: plan) {
+            if (victim == &texture) {
+                return level;
+            }
+        }
+        return texture.resident_level;
+    };
+
+    VkDeviceSize committed = committed_bytes_;
+    while (committed + extra > memory_cap_) {
+        // Only levels above the tail are evicted, and only from textures that are
+        // idle. Against a requester, a texture touched in the same frame is only
+        // colder if it would still be finer after the promotion, which keeps two
+        // textures from trading the same memory back and forth.
+        Texture* victim = nullptr;
+        uint32_t victim_level = 0;
+        for (auto& candidate: textures_) {
+            Texture& texture = *candidate;
+            const uint32_t level = planned_level(texture);
+            if (texture.busy() || level >= texture.tail_level) {
+                continue;
+            }
+            if (requester && !(texture.last_used < requester->last_used ||
+                               (texture.last_used == requester->last_used && level < requested_level))) {
+                continue;
+            }
+            if (!victim || texture.last_used < victim->last_used ||
+                (texture.last_used == victim->last_used && level < victim_level)) {
+                victim = &texture;
+                victim_level = level;
+            }
+        }
+        if (!victim) {
+            return false;
+        }
+        committed -= victim->info.levelSize(victim_level);
+        auto it = std::find_if(plan.begin(), plan.end(), [victim](const auto& entry) { return entry.first == victim; });
+        if (it != plan.end()) {
+            it->second = victim_level + 1;
+        } else {
+            plan.emplace_back(victim, victim_level + 1);
+        }
+    }
+    for (const auto& [victim, level]: plan) {
+        evictLevels(command_buffer, *victim, level, frame_number);
+    }
+    return true;
+}
+
+void TextureStreamer::evictLevels(VkCommandBuffer command_buffer, Texture& texture, uint32_t first_level, uint64_t frame_number)
+{
+    VkDeviceSize image_bytes = 0;
+    utils::Image image = createLevelsImage(texture, first_level, image_bytes);
+    allocated_bytes_ += image_bytes;
+
+    utils::imageBarrier(command_buffer, image.image,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    utils::imageBarrier(command_buffer, texture.image.image,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    copyLevels(command_buffer, texture, texture.image, texture.resident_level, image, first_level, first_level);
+    utils::imageBarrier(command_buffer, image.image,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    // The old image is not sampled again after this frame, so it stays in the
+    // transfer layout until it is destroyed.
+    retireImage(texture.image, texture.image_bytes, frame_number);
+    committed_bytes_ -= levelsSize(texture, texture.resident_level) - levelsSize(texture, first_level);
+    evictions_ += first_level - texture.resident_level;
+    texture.image = image;
+    texture.image_bytes = image_bytes;
+    texture.resident_level = first_level;
+    texture.committed_level = first_level;
+}
+
+utils::Image TextureStreamer::createLevelsImage(const Texture& texture, uint32_t first_level, VkDeviceSize& image_bytes)
+{
+    const Ktx2Info& info = texture.info;
+    utils::Image image = utils::createImage(device_, mem_props_, info.levelExtent(first_level), info.format,
+                                            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                                VK_IMAGE_USAGE_SAMPLED_BIT,
+                                            VK_IMAGE_ASPECT_COLOR_BIT, info.levelCount() - first_level);
+    VkMemoryRequirements mem_reqs{};
+    vkGetImageMemoryRequirements(device_, image.image, &mem_reqs);
+    image_bytes = mem_reqs.size;
+    return image;
+}
+
+void TextureStreamer::copyLevels(VkCommandBuffer command_buffer, const Texture& texture, const utils::Image& src,
+                                 uint32_t src_first, const utils::Image& dst, uint32_t dst_first, uint32_t first_level)
+{
+    std::vector<VkImageCopy> regions;
+    for (uint32_t level = first_level; level < texture.info.levelCount(); ++level) {
+        const VkExtent2D extent = texture.info.levelExtent(level);
+        VkImageCopy region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - src_first, 0, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - dst_first, 0, 1};
+        region.extent = {extent.width, extent.height, 1};
+        regions.push_back(region);
+    }
+    vkCmdCopyImage(command_buffer, src.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void TextureStreamer::updateMemoryCap()
+{
+    // Without VK_EXT_memory_budget there is no telling what else lives in the
+    // heap, so stay well clear of its size.
+    VkDeviceSize device_cap = mem_props_.memoryHeaps[heap_index_].size / 2;
+    if (memory_budget_) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 props{};
+        props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        props.pNext = &budget;
+        vkGetPhysicalDeviceMemoryProperties2(physical_device_, &props);
+        // heapUsage includes the streamer's own images; everything else in the
+        // heap has to keep fitting in the budget next to them.
+        const VkDeviceSize usage = budget.heapUsage[heap_index_];
+        const VkDeviceSize other_usage = usage - std::min(usage, allocated_bytes_);
+        const VkDeviceSize usable = budget.heapBudget[heap_index_] / 10 * 9;
+        device_cap = usable > other_usage ? usable - other_usage : 0;
+    }
+    memory_cap_ = config_.memory_cap ? std::min(config_.memory_cap, device_cap) : device_cap;
+}
+
+VkDeviceSize TextureStreamer::levelsSize(const Texture& texture, uint32_t first_level) const
+{
+    VkDeviceSize size = 0;
+    for (uint32_t level = first_level; level < texture.info.levelCount(); ++level) {
+        size += texture.info.levelSize(level);
+    }
+    return size;
+}
+
+TextureStreamer::Stats TextureStreamer::stats() const
+{
+    Stats result{};
+    result.textures = textures_.size();
+    result.tails_resident = tails_resident_;
+    for (const auto& texture: textures_) {
+        result.fully_resident += texture->resident_level == 0;
+    }
+    result.committed_bytes = committed_bytes_;
+    result.allocated_bytes = allocated_bytes_;
+    result.memory_cap = memory_cap_;
+    result.uploaded_bytes = uploaded_bytes_;
+    result.evictions = evictions_;
+    result.tails_ready_ms = tails_ready_ms_;
+    return result;
+}
+
+void TextureStreamer::printStats(std::ostream& os) const
+{
+    Stats s = stats();
+    os << "Textures: " << s.tails_resident << "/" << s.textures << " with tails, " << s.fully_resident << " fully resident, "
+       << toMiB(s.committed_bytes) << "/" << toMiB(s.memory_cap) << " MiB committed, "
+       << toMiB(s.allocated_bytes) << " MiB allocated, " << toMiB(s.uploaded_bytes) << " MiB uploaded, "
+       << s.evictions << " evictions";
+    if (s.tails_ready_ms) {
+        os << ", tails ready after " << *s.tails_ready_ms << " ms";
+    }
+    os << std::endl;
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "deletion_queue.h"
+#include "job_system.h"
+#include "ktx2.h"
+#include "vk_utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct TextureStreamerConfig
+{
+    // Upper bound for streamed texture memory. 0 leaves it to the device budget.
+    VkDeviceSize memory_cap = 0;
+    // Bytes copied out of staging memory per frame.
+    VkDeviceSize upload_budget = VkDeviceSize(8) << 20;
+    uint32_t frame_count = 2;
+    // Levels whose larger side is at most this many texels form the mip tail,
+    // which is loaded in one go before any texture gets finer levels.
+    uint32_t tail_size = 64;
+};
+
+// Streams KTX2 textures in mip order, coarsest first. Every texture gets its
+// mip tail before any texture gets a finer level, so a scene with far more
+// texture data than VRAM becomes drawable after reading only a fraction of it.
+// Levels are read and decompressed on the job system; the render thread only
+// copies finished data to the GPU, at most upload_budget bytes per frame, in
+// bands of block rows.
+//
+// A texture's resident levels always live in one image holding levels
+// [residentLevel(), levelCount). Adding or evicting a level creates an image
+// of the new size, copies the shared levels on the GPU and swaps it in once
+// complete; the old image is destroyed when the frames using it have
+// retired. Resident bytes are kept under a cap derived from VK_EXT_memory_budget
+// when available, evicting the finest levels of the least recently touched
+// textures first. Textures are expected to be sampled in fragment shaders.
+class TextureStreamer {
+public:
+    using TextureId = uint32_t;
+
+    struct Stats
+    {
+        size_t textures = 0;
+        size_t tails_resident = 0;
+        size_t fully_resident = 0;
+        // Tightly packed size of the resident levels and those on their way.
+        VkDeviceSize committed_bytes = 0;
+        // Memory the images really take, including ones waiting to retire.
+        VkDeviceSize allocated_bytes = 0;
+        VkDeviceSize memory_cap = 0;
+        VkDeviceSize uploaded_bytes = 0;
+        // Evicted levels.
+        uint64_t evictions = 0;
+        // Time from the first addTexture() until every texture had its tail.
+        std::optional<double> tails_ready_ms;
+    };
+
+public:
+    // memory_budget tells whether VK_EXT_memory_budget is enabled on the device.
+    TextureStreamer(VkPhysicalDevice physical_device, VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props,
+                    bool memory_budget, JobSystem& jobs, const TextureStreamerConfig& config);
+    ~TextureStreamer();
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+public:
+    // Reads the file header only; no level data is loaded until recordUpdate().
+    // Throws for files that cannot be streamed or sampled on this device.
+    TextureId addTexture(const std::string& path);
+    // Marks the texture as used by frame_number. Eviction prefers textures that
+    // were touched least recently.
+    void touch(TextureId id, uint64_t frame_number);
+    // VK_NULL_HANDLE until the mip tail is resident. The view changes whenever a
+    // level is added or evicted, so fetch it after recordUpdate() every frame.
+    VkImageView view(TextureId id) const;
+    // Finest resident level, levelCount when nothing is resident yet.
+    uint32_t residentLevel(TextureId id) const;
+
+    // Collects finished decodes, records uploads and evictions and starts new
+    // decodes. Must be recorded outside of a render pass, after the previous
+    // submission using frame_slot has completed.
+    void recordUpdate(VkCommandBuffer command_buffer, uint32_t frame_slot, uint64_t frame_number);
+    // Destroys images replaced before frames_completed.
+    void retire(uint64_t frames_completed);
+
+    Stats stats() const;
+    void printStats(std::ostream& os) const;
+
+private:
+    struct Promotion
+    {
+        utils::Image image;
+        VkDeviceSize image_bytes = 0;
+        // Decoded data for levels [first_level, first_level + levels.size()).
+        uint32_t first_level = 0;
+        std::vector<std::vector<uint8_t>> levels;
+        uint32_t upload_level = 0;
+        uint32_t upload_row = 0;
+        bool started = false;
+    };
+
+    struct Texture
+    {
+        std::string path;
+        Ktx2Info info;
+        // First level of the mip tail.
+        uint32_t tail_level = 0;
+        utils::Image image;
+        VkDeviceSize image_bytes = 0;
+        uint32_t resident_level = 0;
+        // Finest level that is resident or being decoded or uploaded.
+        uint32_t committed_level = 0;
+        uint64_t last_used = 0;
+        std::future<std::vector<std::vector<uint8_t>>> decode;
+        std::unique_ptr<Promotion> promotion;
+
+        bool busy() const { return decode.valid() || promotion; }
+    };
+
+    void pollDecodes();
+    void startDecodes(VkCommandBuffer command_buffer, uint64_t frame_number);
+    void recordUploads(VkCommandBuffer command_buffer, uint32_t frame_slot, uint64_t frame_number);
+    void startPromotion(VkCommandBuffer command_buffer, Texture& texture);
+    void finishPromotion(VkCommandBuffer command_buffer, Texture& texture, uint64_t frame_number);
+    // Frees committed memory until extra more bytes fit under the cap, evicting
+    // only textures that are colder than the one asking, or evicts nothing and
+    // returns false. Without a requester any texture may be evicted.
+    bool makeRoom(VkCommandBuffer command_buffer, VkDeviceSize extra, const Texture* requester, uint32_t requested_level,
+                  uint64_t frame_number);
+    // Drops the levels finer than first_level.
+    void evictLevels(VkCommandBuffer command_buffer, Texture& texture, uint32_t first_level, uint64_t frame_number);
+    utils::Image createLevelsImage(const Texture& texture, uint32_t first_level, VkDeviceSize& image_bytes);
+    void copyLevels(VkCommandBuffer command_buffer, const Texture& texture, const utils::Image& src, uint32_t src_first,
+                    const utils::Image& dst, uint32_t dst_first, uint32_t first_level);
+    // Destroys the image once frame_number has completed.
+    void retireImage(const utils::Image& image, VkDeviceSize bytes, uint64_t frame_number);
+    void updateMemoryCap();
+    VkDeviceSize levelsSize(const Texture& texture, uint32_t first_level) const;
+
+private:
+    VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties mem_props_{};
+    bool memory_budget_ = false;
+    uint32_t heap_index_ = 0;
+    JobSystem& jobs_;
+    TextureStreamerConfig config_;
+
+    std::vector<std::unique_ptr<Texture>> textures_;
+    std::vector<TextureId> decoding_;
+    // Textures with decoded data waiting for upload, in decode order.
+    std::vector<TextureId> uploads_;
+    std::vector<utils::Buffer> staging_;
+    DeletionQueue retired_;
+
+    VkDeviceSize committed_bytes_ = 0;
+    VkDeviceSize allocated_bytes_ = 0;
+    VkDeviceSize memory_cap_ = 0;
+    VkDeviceSize uploaded_bytes_ = 0;
+    uint64_t evictions_ = 0;
+    std::chrono::steady_clock::time_point first_added_{};
+    size_t tails_resident_ = 0;
+    std::optional<double> tails_ready_ms_;
+};
@@ -1,4 +1,5 @@
 #include "triangle.h"
+#include "camera.h"
 #include "utils.h"
 #include "vulkan/vulkan_core.h"
 
@@ -7,6 +8,8 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -15,6 +18,8 @@
 #include <limits>
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <future>
 
 inline static const std::vector<const char*> validation_layers = {
     "VK_LAYER_KHRONOS_validation"
@@ -30,67 +35,194 @@ inline static const std::vector<const char*> device_extensions = {
     inline static constexpr bool enable_validation_layers = true;
 #endif
 
-TriangleApplication::~TriangleApplication()
+inline static const std::string pipeline_cache_path = "pipeline_cache.bin";
+
+inline static constexpr uint32_t max_frames_in_flight = 2;
+// Longest wait for a present before the pacer gives up on that frame, so a
+// minimized or occluded window does not stall the loop.
+inline static constexpr uint64_t present_wait_timeout_ns = 100'000'000;
+// Room for one FrameUniforms plus per-object data added later.
+inline static constexpr VkDeviceSize uniform_bytes_per_frame = 64 * 1024;
+
+bool DeviceCapabilities::hasExtension(std::string_view name) const
 {
-    vkDestroySemaphore(device_, semaphore_image_available_, nullptr);
-    vkDestroySemaphore(device_, semaphore_render_finished_, nullptr);
-    vkDestroyFence(device_, fence_in_flight_, nullptr);
-    vkDestroyCommandPool(device_, command_pool_, nullptr);
-    for (auto framebuffer: swap_chain_framebuffers_) {
-        vkDestroyFramebuffer(device_, framebuffer, nullptr);
+    for (const auto& ext: extensions) {
+        if (std::string_view{ext.extensionName} == name) {
+            return true;
+        }
     }
-    vkDestroyPipeline(device_, graphics_pipeline_, nullptr);
-    vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
-    vkDestroyRenderPass(device_, render_pass_, nullptr);
-    for (auto image_view: swap_chain_image_views_) {
-        vkDestroyImageView(device_, image_view, nullptr);
+    return false;
+}
+
+bool DeviceCapabilities::supportsMeshShaders() const
+{
+    // The mesh shading SPIR-V needs version 1.4, which is core from Vulkan 1.2.
+    return properties.apiVersion >= VK_API_VERSION_1_2 && hasExtension(VK_EXT_MESH_SHADER_EXTENSION_NAME) &&
+           mesh_shader_features.taskShader && mesh_shader_features.meshShader;
+}
+
+bool DeviceCapabilities::supportsMemoryBudget() const
+{
+    // The budget is read through vkGetPhysicalDeviceMemoryProperties2, core from Vulkan 1.1.
+    return properties.apiVersion >= VK_API_VERSION_1_1 && hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+}
+
+bool DeviceCapabilities::supportsPresentWait() const
+{
+    return properties.apiVersion >= VK_API_VERSION_1_1 && hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+           hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME) && present_id_features.presentId &&
+           present_wait_features.presentWait;
+}
+
+TriangleApplication::TriangleApplication(AppOptions options)
+    : options_{std::move(options)}
+{
+}
+
+TriangleApplication::~TriangleApplication()
+{
+    // Members release their objects in reverse order of declaration. The GPU has
+    // to be done with all of them first, also when initialization or a frame threw.
+    if (device_ != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device_);
     }
-    vkDestroySwapchainKHR(device_, swap_chain_, nullptr);
-    vkDestroyDevice(device_, nullptr);
-    vkDestroySurfaceKHR(instance_, surface_, nullptr);
-    vkDestroyInstance(instance_, nullptr);
-    glfwDestroyWindow(window_);
-    glfwTerminate();
+    savePipelineCache();
 }
 
 void TriangleApplication::run() 
 {
-    initWindow();
     initVulkan();
     mainLoop();
 }
 
-
-void TriangleApplication::initWindow() 
+void TriangleApplication::initGlfw()
 {
     int rv = glfwInit();
+    glfw_.initialized = rv == GLFW_TRUE;
     if (rv != GLFW_TRUE) {
         std::cerr << "Failed to init GLFW" << std::endl;
-        return;
     }
+}
+
+void TriangleApplication::initWindow() 
+{
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    window_ = glfwCreateWindow(800, 600, "Vulkan", nullptr, nullptr);
-    if (!window_) {
-        std::cerr << "Failed to create window!" << std::endl;
+    std::vector<WindowOptions> windows{{options_.window_width, options_.window_height, 0.0}};
+    windows.insert(windows.end(), options_.extra_windows.begin(), options_.extra_windows.end());
+    outputs_.resize(windows.size());
+    for (size_t i = 0; i < windows.size(); ++i) {
+        std::string title = i == 0 ? "Vulkan" : "Vulkan " + std::to_string(i + 1);
+        outputs_[i].window.reset(glfwCreateWindow(static_cast<int>(windows[i].width), static_cast<int>(windows[i].height),
+                                                  title.c_str(), nullptr, nullptr));
+        if (!outputs_[i].window) {
+            std::cerr << "Failed to create window!" << std::endl;
+        }
+        if (windows[i].rate_hz > 0.0) {
+            outputs_[i].interval = std::chrono::duration_cast<WindowOutput::Clock::duration>(
+                std::chrono::duration<double>(1.0 / windows[i].rate_hz));
+        }
     }
 }
 
 void TriangleApplication::initVulkan() 
 {
-    enumExtensions();
-    createInstance();
-    createSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-    createSwapChain();
-    createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createFramebuffers();
-    createCommandPool();
-    createCommandBuffer();
-    createSyncObjects();
+    // Work that does not depend on the instance or the device is started on
+    // worker threads up front and joined only where its result is consumed, so it
+    // overlaps the serial instance -> surface -> device -> pipeline chain.
+    auto layers_future = std::async(std::launch::async, [this] {
+        return timeline_.measure("check validation layers", [this] {
+            return !enable_validation_layers || checkValidationLayerSupport();
+        });
+    });
+    auto shaders_future = std::async(std::launch::async, [this] {
+        timeline_.measure("load shaders", [this] { loadShaders(); });
+    });
+    auto cache_future = std::async(std::launch::async, [this] {
+        return timeline_.measure("load pipeline cache", [] {
+            return utils::readFileIfExists(pipeline_cache_path);
+        });
+    });
+    std::future<MeshletData> meshlets_future;
+    if (!options_.meshlets.empty()) {
+        meshlets_future = std::async(std::launch::async, [this] {
+            return timeline_.measure("load meshlets", [this] { return readMeshlets(options_.meshlets); });
+        });
+    }
+    std::future<std::unique_ptr<MeshFile>> mesh_future;
+    if (!options_.mesh.empty()) {
+        mesh_future = std::async(std::launch::async, [this] {
+            return timeline_.measure("map mesh", [this] { return std::make_unique<MeshFile>(options_.mesh); });
+        });
+    }
+
+    // glfwInit() has to finish before the instance extension query, but the window
+    // itself (which GLFW requires on the main thread) is created while the instance
+    // is being built.
+    timeline_.measure("glfwInit", [this] { initGlfw(); });
+    auto instance_future = std::async(std::launch::async, [this, &layers_future] {
+        timeline_.measure("enumerate extensions", [this] { enumExtensions(); });
+        if (!layers_future.get()) {
+            throw std::runtime_error("validation layers requested, but not available!");
+        }
+        timeline_.measure("createInstance", [this] { createInstance(); });
+    });
+    timeline_.measure("initWindow", [this] { initWindow(); });
+    timeline_.measureWait("wait instance", "createInstance", [&instance_future] { instance_future.get(); });
+
+    timeline_.measure("createSurface", [this] { createSurface(); });
+    timeline_.measure("pickPhysicalDevice", [this] { pickPhysicalDevice(); });
+    timeline_.measure("createLogicalDevice", [this] { createLogicalDevice(); });
+    timeline_.measure("createSwapChain", [this] { createSwapChains(); });
+    timeline_.measure("createImageViews", [this] {
+        for (auto& output: outputs_) {
+            createImageViews(output);
+        }
+    });
+    timeline_.measure("createRenderPass", [this] { createRenderPass(); });
+    timeline_.measure("createDescriptorSetLayout", [this] { createDescriptorSetLayout(); });
+    if (options_.dynamic_resolution_budget_ms > 0.0) {
+        timeline_.measure("createOffscreenTarget", [this] { createOffscreenTarget(); });
+    }
+    auto cache_data = timeline_.measureWait("wait pipeline cache", "load pipeline cache", [&cache_future] { return cache_future.get(); });
+    timeline_.measure("createPipelineCache", [this, &cache_data] { createPipelineCache(cache_data); });
+    timeline_.measureWait("wait shaders", "load shaders", [&shaders_future] { shaders_future.get(); });
+    timeline_.measure("createGraphicsPipeline", [this] { createGraphicsPipeline(); });
+    timeline_.measure("createFramebuffers", [this] {
+        for (auto& output: outputs_) {
+            createFramebuffers(output);
+        }
+    });
+    if (options_.occlusion_culling) {
+        timeline_.measure("createDepthPrepass", [this] { createDepthPrepass(); });
+    }
+    timeline_.measure("createCommandPool", [this] { createCommandPool(); });
+    timeline_.measure("createCommandBuffers", [this] { createCommandBuffers(); });
+    timeline_.measure("createSyncObjects", [this] { createSyncObjects(); });
+    timeline_.measure("createUniformRing", [this] { createUniformRing(); });
+    timeline_.measure("createDescriptorSet", [this] { createDescriptorSet(); });
+    if (!options_.capture.empty()) {
+        timeline_.measure("createFrameCapture", [this] { createFrameCapture(); });
+    }
+    timeline_.measure("createGpuTimer", [this] { createGpuTimer(); });
+    if (options_.low_latency != LatencyMode::off) {
+        timeline_.measure("createFramePacer", [this] { createFramePacer(); });
+    }
+    if (meshlets_future.valid()) {
+        auto meshlets = timeline_.measureWait("wait meshlets", "load meshlets", [&meshlets_future] { return meshlets_future.get(); });
+        timeline_.measure("createClusterRenderer", [this, &meshlets] { createClusterRenderer(meshlets); });
+    }
+    if (mesh_future.valid()) {
+        auto mesh = timeline_.measureWait("wait mesh", "map mesh", [&mesh_future] { return mesh_future.get(); });
+        timeline_.measure("createMeshRenderer", [this, &mesh] { createMeshRenderer(*mesh); });
+    }
+    if (options_.scene_instances > 0) {
+        timeline_.measure("createScene", [this] { createScene(); });
+    }
+    if (!options_.textures.empty()) {
+        timeline_.measure("createTextureStreamer", [this] { createTextureStreamer(); });
+    }
+    timeline_.print(std::cout);
 }
 
 void TriangleApplication::enumExtensions() 
@@ -108,9 +240,6 @@ void TriangleApplication::enumExtensions()
 
 void TriangleApplication::createInstance() 
 {
-    if (enable_validation_layers && !checkValidationLayerSupport()) {
-        throw std::runtime_error("validation layers requested, but not available!");
-    }
     VkApplicationInfo app_info{};
     app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     app_info.pApplicationName = "Triangle";
@@ -134,88 +263,288 @@ void TriangleApplication::createInstance()
         create_info.enabledLayerCount = 0;
     } 
 
-    VkResult res = vkCreateInstance(&create_info, nullptr, &instance_);
+    VkInstance instance = VK_NULL_HANDLE;
+    VkResult res = vkCreateInstance(&create_info, nullptr, &instance);
     if (res != VK_SUCCESS) {
         std::cerr << "error: " << res << std::endl;
         throw std::runtime_error("Failed to create VK instance!");
     }
+    instance_ = utils::UniqueInstance(nullptr, instance);
     std::cout << "Instance created" << std::endl;
 }
 
 void TriangleApplication::mainLoop() 
 {
-    while (!glfwWindowShouldClose(window_)) {
+    // Without capture or pacing, the main window is drawn every 33 ms and the
+    // loop sleeps until the next window with a rate of its own is due; windows
+    // without one are drawn whenever the loop runs. Capture runs uncapped so the
+    // reported throughput is the pipeline's, and the frame pacer waits for the
+    // display instead.
+    const bool timed_loop = !frame_capture_ && !frame_pacer_;
+    if (timed_loop) {
+        outputs_.front().interval = std::chrono::milliseconds(33);
+    }
+    while (!glfwWindowShouldClose(outputs_.front().window.get())) {
         glfwPollEvents();
+        closeWindows();
         drawFrame();
-        std::this_thread::sleep_for(std::chrono::milliseconds(33));
+        if (timed_loop) {
+            auto next_frame = outputs_.front().next_frame;
+            for (const auto& output: outputs_) {
+                if (output.interval.count() > 0) {
+                    next_frame = std::min(next_frame, output.next_frame);
+                }
+            }
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+    vkDeviceWaitIdle(device_);
+    printWindowStats();
+    if (frame_capture_) {
+        frame_capture_->consume(frame_number_);
+        frame_capture_->finish();
+        frame_capture_->printStats(std::cout);
+    }
+    if (frame_pacer_) {
+        frame_pacer_->printStats(std::cout);
+    }
+}
+
+void TriangleApplication::closeWindows()
+{
+    // Closing the main window ends the loop; any other window just stops being
+    // drawn. Its swap chain may still be presenting, so the whole output waits
+    // in the deletion queue.
+    for (size_t i = outputs_.size() - 1; i > 0; --i) {
+        if (glfwWindowShouldClose(outputs_[i].window.get())) {
+            glfwHideWindow(outputs_[i].window.get());
+            deletion_queue_.retire(frame_number_, std::move(outputs_[i]));
+            outputs_.erase(outputs_.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+    }
+}
+
+void TriangleApplication::printWindowStats()
+{
+    if (outputs_.size() < 2) {
+        return;
+    }
+    for (size_t i = 0; i < outputs_.size(); ++i) {
+        const WindowOutput& output = outputs_[i];
+        std::cout << "Window " << i + 1 << " (" << output.extent.width << "x" << output.extent.height << "): " << output.frames
+                  << " frames, " << output.skipped << " skipped without a free image" << std::endl;
     }
 }
 
 void TriangleApplication::drawFrame()
 {
-    VkResult res =  vkWaitForFences(device_, 1, &fence_in_flight_, VK_TRUE, UINT64_MAX);
+    const uint32_t frame_slot = static_cast<uint32_t>(frame_number_ % max_frames_in_flight);
+    VkFence fence_in_flight = fences_in_flight_[frame_slot];
+    VkCommandBuffer command_buffer = command_buffers_[frame_slot];
+
+    if (frame_pacer_) {
+        paceFrame();
+    }
+    VkResult res =  vkWaitForFences(device_, 1, &fence_in_flight, VK_TRUE, UINT64_MAX);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to wait for fences, error: " + std::to_string(res));
     }
-    vkResetFences(device_, 1, &fence_in_flight_);
+    // Once this slot's fence is signaled, every frame up to the one that used the
+    // slot last has completed.
+    const uint64_t frames_completed = frame_number_ + 1 >= max_frames_in_flight ? frame_number_ + 1 - max_frames_in_flight : 0;
+    deletion_queue_.collect(frames_completed);
+
+    // Every window that is due acquires an image. With several windows the
+    // acquire does not wait, so a window without a free image (one presenting
+    // FIFO at a lower refresh rate, or minimized) skips this frame instead of
+    // holding up the others. The fence is only reset once an image was acquired,
+    // so a frame skipped entirely leaves it signaled for the next attempt.
+    const auto now = WindowOutput::Clock::now();
+    const uint64_t acquire_timeout = outputs_.size() > 1 ? 0 : UINT64_MAX;
+    bool acquired = false;
+    for (auto& output: outputs_) {
+        output.image_index.reset();
+        if (!output.due(now)) {
+            continue;
+        }
+        uint32_t image_index = 0;
+        res = vkAcquireNextImageKHR(device_, output.swap_chain, acquire_timeout, output.image_available[frame_slot],
+                                    VK_NULL_HANDLE, &image_index);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapChain(output);
+            output.retryLater(now);
+            continue;
+        }
+        if (res == VK_NOT_READY || res == VK_TIMEOUT) {
+            ++output.skipped;
+            output.retryLater(now);
+            continue;
+        }
+        if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire next image, error: " + std::to_string(res));
+        }
+        output.image_index = image_index;
+        output.scheduleNext(now);
+        acquired = true;
+    }
+    if (!acquired) {
+        return;
+    }
+    res = vkResetFences(device_, 1, &fence_in_flight);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to reset fences, error: " + std::to_string(res));
     }
+    if (frame_capture_) {
+        frame_capture_->consume(frames_completed);
+    }
+    updateDynamicResolution(frame_slot);
+    updateVariantBenchmark(frame_slot);
+    printClusterStats(frame_slot);
+    if (texture_streamer_) {
+        texture_streamer_->retire(frames_completed);
+        // Nothing samples the textures yet. A window over half of them, moving on
+        // every 240 frames, stands in for what the camera sees, so the textures
+        // it leaves age and eviction has a least recently used order to follow.
+        if (!textures_.empty()) {
+            const size_t visible = (textures_.size() + 1) / 2;
+            const size_t first = static_cast<size_t>(frame_number_ / 240) % textures_.size();
+            for (size_t i = 0; i < visible; ++i) {
+                texture_streamer_->touch(textures_[(first + i) % textures_.size()], frame_number_);
+            }
+        }
+        if (frame_number_ % 120 == 0) {
+            texture_streamer_->printStats(std::cout);
+        }
+    }
 
-    uint32_t image_index = 0;
-    vkAcquireNextImageKHR(device_, swap_chain_, UINT64_MAX, semaphore_image_available_, VK_NULL_HANDLE, &image_index);
-    if (res != VK_SUCCESS) {
-        throw std::runtime_error("failed to acquire next image, error: " + std::to_string(res));
+    auto aspectOf = [](const WindowOutput& output) {
+        return static_cast<float>(output.extent.width) / static_cast<float>(output.extent.height);
+    };
+    FrameUniforms frame_uniforms{};
+    frame_uniforms.time = static_cast<float>(glfwGetTime());
+    frame_uniforms.aspect = aspectOf(outputs_.front());
+    std::optional<Camera> camera;
+    if (cluster_renderer_ || mesh_renderer_) {
+        const float* center = cluster_renderer_ ? cluster_renderer_->center() : mesh_renderer_->center();
+        float radius = cluster_renderer_ ? cluster_renderer_->radius() : mesh_renderer_->radius();
+        if (scene_) {
+            // Orbit inside the grid so that culling has something to reject.
+            center = grid_.center;
+            radius = grid_.radius * 0.25f;
+        }
+        camera = makeOrbitCamera(center, radius, frame_uniforms.time * 0.5f, frame_uniforms.aspect);
+        std::memcpy(frame_uniforms.view_projection, camera->view_projection.m, sizeof(frame_uniforms.view_projection));
+        std::memcpy(frame_uniforms.camera_position, camera->position, sizeof(camera->position));
+        std::memcpy(frame_uniforms.frustum_planes, camera->frustum_planes, sizeof(frame_uniforms.frustum_planes));
+        std::memcpy(frame_uniforms.previous_view_projection, previous_view_projection_,
+                    sizeof(frame_uniforms.previous_view_projection));
+        std::memcpy(previous_view_projection_, camera->view_projection.m, sizeof(previous_view_projection_));
+        if (scene_) {
+            updateScene(*camera, frame_uniforms.time);
+        }
     }
-    res = vkResetCommandBuffer(command_buffer_, 0);
+    uniform_ring_->beginFrame(frame_slot);
+    frame_uniforms_offset_ = uniform_ring_->push(frame_uniforms);
+    outputs_.front().frame_uniforms_offset = frame_uniforms_offset_;
+    // Other windows look through the main camera at their own aspect ratio.
+    // Culling only used the main window's frustum, so theirs is fitted inside it.
+    for (size_t i = 1; i < outputs_.size(); ++i) {
+        WindowOutput& output = outputs_[i];
+        if (!output.image_index) {
+            continue;
+        }
+        FrameUniforms output_uniforms = frame_uniforms;
+        output_uniforms.aspect = aspectOf(output);
+        if (camera) {
+            Camera fitted = fitCamera(*camera, output_uniforms.aspect);
+            std::memcpy(output_uniforms.view_projection, fitted.view_projection.m, sizeof(output_uniforms.view_projection));
+            std::memcpy(output_uniforms.frustum_planes, fitted.frustum_planes, sizeof(output_uniforms.frustum_planes));
+        }
+        output.frame_uniforms_offset = uniform_ring_->push(output_uniforms);
+    }
+    uniform_ring_->flush();
+
+    res = vkResetCommandBuffer(command_buffer, 0);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to reset command buffer, error: " + std::to_string(res));
     }
-    recordCommandBuffer(command_buffer_, image_index);
+    recordCommandBuffer(command_buffer, frame_slot);
+
+    // One submission draws every acquired window, and one present call shows
+    // them all. The arrays below have an entry per acquired window, in order.
+    std::vector<VkSemaphore> wait_semaphores;
+    std::vector<VkPipelineStageFlags> wait_stages;
+    std::vector<VkSemaphore> signal_semaphores;
+    std::vector<VkSwapchainKHR> swap_chains;
+    std::vector<uint32_t> image_indices;
+    std::vector<WindowOutput*> presented;
+    for (auto& output: outputs_) {
+        if (!output.image_index) {
+            continue;
+        }
+        wait_semaphores.push_back(output.image_available[frame_slot]);
+        // With dynamic resolution the main window's image is first written by the
+        // upscale blit, so the acquire has to be waited on before transfers too.
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        if (dynamic_resolution_ && &output == &outputs_.front()) {
+            wait_stage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        }
+        wait_stages.push_back(wait_stage);
+        signal_semaphores.push_back(output.render_finished[frame_slot]);
+        swap_chains.push_back(output.swap_chain);
+        image_indices.push_back(*output.image_index);
+        presented.push_back(&output);
+    }
 
     VkSubmitInfo submit_info{};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore wait_semaphores[] = {
-        semaphore_image_available_
-    };
-    VkPipelineStageFlags wait_stages[] = {
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-    };
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
+    submit_info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+    submit_info.pWaitSemaphores = wait_semaphores.data();
+    submit_info.pWaitDstStageMask = wait_stages.data();
     submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer_;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = static_cast<uint32_t>(signal_semaphores.size());
+    submit_info.pSignalSemaphores = signal_semaphores.data();
 
-    VkSemaphore signal_semaphores[] = {
-        semaphore_render_finished_
-    };
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = signal_semaphores;
-
-    res = vkQueueSubmit(graphics_queue_, 1, &submit_info, fence_in_flight_);
+    res = vkQueueSubmit(graphics_queue_, 1, &submit_info, fence_in_flight);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer, error: " + std::to_string(res));
     }
 
+    std::vector<VkResult> results(swap_chains.size(), VK_SUCCESS);
     VkPresentInfoKHR present_info{};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = signal_semaphores;
-
-    VkSwapchainKHR swap_chains[] = {
-        swap_chain_
-    };
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = swap_chains;
-    present_info.pImageIndices = &image_index;
-    present_info.pResults = nullptr;
+    present_info.waitSemaphoreCount = static_cast<uint32_t>(signal_semaphores.size());
+    present_info.pWaitSemaphores = signal_semaphores.data();
+    present_info.swapchainCount = static_cast<uint32_t>(swap_chains.size());
+    present_info.pSwapchains = swap_chains.data();
+    present_info.pImageIndices = image_indices.data();
+    present_info.pResults = results.data();
+    // Present IDs have to increase per swap chain and 0 means none.
+    std::vector<uint64_t> present_ids(swap_chains.size(), frame_number_ + 1);
+    VkPresentIdKHR present_id_info{};
+    present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    present_id_info.swapchainCount = static_cast<uint32_t>(present_ids.size());
+    present_id_info.pPresentIds = present_ids.data();
+    if (present_wait_) {
+        present_info.pNext = &present_id_info;
+    }
 
+    // The call returns a single status, but every swap chain reports its own
+    // result: one window going out of date must not cost the others their frame.
     res = vkQueuePresentKHR(present_queue_, &present_info);
-    if (res != VK_SUCCESS) {
+    if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR && res != VK_ERROR_OUT_OF_DATE_KHR) {
         throw std::runtime_error("failed to queue present, error: " + std::to_string(res));
-    }    
+    }
+    if (frame_pacer_ && presented.front() == &outputs_.front() && results.front() != VK_ERROR_OUT_OF_DATE_KHR) {
+        pending_present_ = frame_number_;
+    }
+    ++frame_number_;
+    for (size_t i = 0; i < presented.size(); ++i) {
+        if (results[i] != VK_SUCCESS) {
+            recreateSwapChain(*presented[i]);
+        }
+    }
 }
 
 bool TriangleApplication::checkValidationLayerSupport()
@@ -240,6 +569,19 @@ bool TriangleApplication::checkValidationLayerSupport()
     return true;
 }
 
+void TriangleApplication::loadShaders()
+{
+#if defined(_WIN32)
+    vert_shader_code_ = utils::readFile("shaders\\vert.spv");
+    frag_shader_code_ = utils::readFile("shaders\\frag.spv");
+#elif defined(__linux__)
+    vert_shader_code_ = utils::readFile("shaders/vert.spv");
+    frag_shader_code_ = utils::readFile("shaders/frag.spv");
+#endif
+    std::cout << "vert size: " << vert_shader_code_.size() << std::endl;
+    std::cout << "frag size: " << frag_shader_code_.size() << std::endl;
+}
+
 void TriangleApplication::pickPhysicalDevice()
 {
     uint32_t count = 0;
@@ -250,68 +592,90 @@ void TriangleApplication::pickPhysicalDevice()
     std::vector<VkPhysicalDevice> devices{count};
     vkEnumeratePhysicalDevices(instance_, &count, devices.data());
     for (const auto& device: devices) {
-        if (isSuitableDevice(device)) {
+        DeviceCapabilities caps = queryDeviceCapabilities(device);
+        if (isSuitableDevice(caps)) {
             physical_device_ = device;
+            device_caps_ = std::move(caps);
             break;
         }
     }
     if (physical_device_ == VK_NULL_HANDLE) {
         throw std::runtime_error("failed to find a suitable GPU!");
     }
-    std::cout << "Picked physical device: " << getPhysicalDeviceName(physical_device_) << std::endl;
+    std::cout << "Picked physical device: " << device_caps_.properties.deviceName << std::endl;
 }
 
-std::string TriangleApplication::getPhysicalDeviceName(VkPhysicalDevice device)
+DeviceCapabilities TriangleApplication::queryDeviceCapabilities(VkPhysicalDevice device)
 {
-    VkPhysicalDeviceProperties device_props;
-    vkGetPhysicalDeviceProperties(device, &device_props);
-    return std::string{ device_props.deviceName };
-}
+    DeviceCapabilities caps{};
+    caps.physical_device = device;
+    vkGetPhysicalDeviceProperties(device, &caps.properties);
+    vkGetPhysicalDeviceFeatures(device, &caps.features);
+    vkGetPhysicalDeviceMemoryProperties(device, &caps.memory_properties);
 
-bool TriangleApplication::isSuitableDevice(VkPhysicalDevice physical_device)
-{
-    VkPhysicalDeviceProperties device_props;
-    vkGetPhysicalDeviceProperties(physical_device, &device_props);
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+    caps.extensions.resize(count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, caps.extensions.data());
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    if (caps.properties.apiVersion >= VK_API_VERSION_1_2 && caps.hasExtension(VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+        caps.mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+        caps.mesh_shader_features.pNext = features2.pNext;
+        features2.pNext = &caps.mesh_shader_features;
+    }
+    if (caps.properties.apiVersion >= VK_API_VERSION_1_1 && caps.hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+        caps.hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        caps.present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        caps.present_id_features.pNext = features2.pNext;
+        caps.present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        caps.present_wait_features.pNext = &caps.present_id_features;
+        features2.pNext = &caps.present_wait_features;
+    }
+    if (features2.pNext != nullptr) {
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+        // The capabilities are copied around, so the chain must not outlive this call.
+        caps.mesh_shader_features.pNext = nullptr;
+        caps.present_id_features.pNext = nullptr;
+        caps.present_wait_features.pNext = nullptr;
+    }
+
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
+    caps.queue_family_properties.resize(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, caps.queue_family_properties.data());
 
-    VkPhysicalDeviceFeatures device_feats;
-    vkGetPhysicalDeviceFeatures(physical_device, &device_feats);
-    auto indices = findQueueFamilies(physical_device);
-    bool is_dev_ext_support = isDeviceExtensionSupport(physical_device);
-    bool swap_chain_adequate = false;
-    if (is_dev_ext_support) {
-        SwapChainSupportDetails details = querySwapChainSupport(physical_device);
-        swap_chain_adequate = !details.formats.empty() && !details.present_modes.empty();
+    caps.queue_families = findQueueFamilies(device, caps.queue_family_properties);
+    if (isDeviceExtensionSupport(caps)) {
+        caps.swap_chain_support = querySwapChainSupport(device, outputs_.front().surface);
     }
-    return indices.isComplete() && is_dev_ext_support && swap_chain_adequate;
+    return caps;
 }
 
-bool TriangleApplication::isDeviceExtensionSupport(VkPhysicalDevice device)
+bool TriangleApplication::isSuitableDevice(const DeviceCapabilities& caps)
+{
+    bool swap_chain_adequate = !caps.swap_chain_support.formats.empty() && !caps.swap_chain_support.present_modes.empty();
+    return caps.queue_families.isComplete() && isDeviceExtensionSupport(caps) && swap_chain_adequate;
+}
+
+bool TriangleApplication::isDeviceExtensionSupport(const DeviceCapabilities& caps)
 {
-    uint32_t count = 0;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
-    std::vector<VkExtensionProperties> ext_props{count};
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, ext_props.data());
     std::set<std::string_view> required_exts{device_extensions.begin(), device_extensions.end()};
-    for (const auto& prop: ext_props) {
+    for (const auto& prop: caps.extensions) {
         required_exts.erase(prop.extensionName);
     }
     return required_exts.empty();
 }
 
-QueueFamilyIndices TriangleApplication::findQueueFamilies(VkPhysicalDevice device)
+QueueFamilyIndices TriangleApplication::findQueueFamilies(VkPhysicalDevice device, const std::vector<VkQueueFamilyProperties>& family_props)
 {
     QueueFamilyIndices indices{};
-    uint32_t count = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
-    std::vector<VkQueueFamilyProperties> family_props{count};
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, family_props.data());
     int i = 0;
     for (const auto& prop: family_props) {
         if (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             indices.graphics_family = i;
         }
         VkBool32 present_support{false};
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &present_support);
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, outputs_.front().surface, &present_support);
         if (present_support) {
             indices.present_family = i;
         }
@@ -325,7 +689,7 @@ QueueFamilyIndices TriangleApplication::findQueueFamilies(VkPhysicalDevice devic
 
 void TriangleApplication::createLogicalDevice() 
 {
-    auto indices = findQueueFamilies(physical_device_);
+    const auto& indices = device_caps_.queue_families;
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos{};
     std::set<uint32_t> unique_queue_families = {
         indices.graphics_family.value(), indices.present_family.value()
@@ -341,45 +705,129 @@ void TriangleApplication::createLogicalDevice()
     }
 
     VkPhysicalDeviceFeatures feats{};
+    std::vector<const char*> extensions = device_extensions;
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{};
+    mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    void* feature_chain = nullptr;
 
     VkDeviceCreateInfo device_create_info{};
     device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (!options_.textures.empty()) {
+        feats.textureCompressionBC = device_caps_.features.textureCompressionBC;
+        if (device_caps_.supportsMemoryBudget()) {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+    }
+    if (!options_.meshlets.empty()) {
+        feats.multiDrawIndirect = device_caps_.features.multiDrawIndirect;
+        feats.drawIndirectFirstInstance = device_caps_.features.drawIndirectFirstInstance;
+        if (options_.mesh_shaders && device_caps_.supportsMeshShaders()) {
+            extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+            mesh_shader_features.taskShader = VK_TRUE;
+            mesh_shader_features.meshShader = VK_TRUE;
+            mesh_shader_features.pNext = feature_chain;
+            feature_chain = &mesh_shader_features;
+        }
+    }
+    if (options_.low_latency == LatencyMode::automatic || options_.low_latency == LatencyMode::present_wait) {
+        present_wait_ = device_caps_.supportsPresentWait();
+        if (!present_wait_ && options_.low_latency == LatencyMode::present_wait) {
+            throw std::runtime_error("present wait pacing requested, but the device does not support VK_KHR_present_wait");
+        }
+    }
+    if (present_wait_) {
+        extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        present_id_features.presentId = VK_TRUE;
+        present_id_features.pNext = feature_chain;
+        present_wait_features.presentWait = VK_TRUE;
+        present_wait_features.pNext = &present_id_features;
+        feature_chain = &present_wait_features;
+    }
+    device_create_info.pNext = feature_chain;
     device_create_info.pQueueCreateInfos = queue_create_infos.data();
     device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
     device_create_info.pEnabledFeatures = &feats;
-    device_create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-    device_create_info.ppEnabledExtensionNames = device_extensions.data();
+    device_create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    device_create_info.ppEnabledExtensionNames = extensions.data();
 
-    VkResult res = vkCreateDevice(physical_device_, &device_create_info, nullptr, &device_);
+    VkDevice device = VK_NULL_HANDLE;
+    VkResult res = vkCreateDevice(physical_device_, &device_create_info, nullptr, &device);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("Failed to create device, error: " + std::to_string(res));
     }
+    device_ = utils::UniqueDevice(nullptr, device);
     vkGetDeviceQueue(device_, indices.graphics_family.value(), 0, &graphics_queue_);
     vkGetDeviceQueue(device_, indices.present_family.value(), 0, &present_queue_);
     std::cout << "Logical device created" << std::endl;
 }
 
-void TriangleApplication::createSwapChain()
+void TriangleApplication::createSwapChains()
+{
+    // The device and its present queue were picked for the main window; the
+    // other windows have to be presentable from the same queue.
+    outputs_.front().support = device_caps_.swap_chain_support;
+    for (size_t i = 1; i < outputs_.size(); ++i) {
+        VkBool32 present_support = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(physical_device_, device_caps_.queue_families.present_family.value(),
+                                             outputs_[i].surface, &present_support);
+        if (!present_support) {
+            throw std::runtime_error("window " + std::to_string(i + 1) + " cannot be presented from the device's present queue");
+        }
+        outputs_[i].support = querySwapChainSupport(physical_device_, outputs_[i].surface);
+    }
+    for (auto& output: outputs_) {
+        createSwapChain(output);
+        // Pipelines and the render pass are shared, so every window needs the
+        // main window's format.
+        if (output.format != outputs_.front().format) {
+            throw std::runtime_error("windows have different swap chain formats, the render pass cannot be shared");
+        }
+    }
+}
+
+void TriangleApplication::createSwapChain(WindowOutput& output)
 {
-    SwapChainSupportDetails details = querySwapChainSupport(physical_device_);
+    const SwapChainSupportDetails& details = output.support;
+    const bool main_window = &output == &outputs_.front();
     VkSurfaceFormatKHR surface_format = chooseSwapSurfaceFormat(details.formats);
     VkPresentModeKHR present_mode = chooseSwapPresentMode(details.present_modes);
-    VkExtent2D extent = chooseSwapExtent(details.capabilities);
+    VkExtent2D extent = chooseSwapExtent(details.capabilities, output.window.get());
     uint32_t image_count = details.capabilities.minImageCount + 1;
+    // The frame pacer keeps at most one frame queued, so it needs no spare image.
+    if (options_.low_latency != LatencyMode::off) {
+        image_count = std::max(details.capabilities.minImageCount, 2u);
+    }
     if (details.capabilities.maxImageCount > 0 && image_count > details.capabilities.maxImageCount) {
         image_count = details.capabilities.maxImageCount;
     }
     VkSwapchainCreateInfoKHR create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    create_info.surface = surface_;
+    create_info.surface = output.surface;
     create_info.minImageCount = image_count;
     create_info.imageFormat = surface_format.format;
     create_info.imageColorSpace = surface_format.colorSpace;
     create_info.imageExtent = extent;
     create_info.imageArrayLayers = 1;
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (options_.dynamic_resolution_budget_ms > 0.0 && main_window) {
+        if (!(details.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+            throw std::runtime_error("dynamic resolution requested, but swap chain images cannot be transfer destinations");
+        }
+        create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    if (!options_.capture.empty() && main_window) {
+        if (!(details.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+            throw std::runtime_error("frame capture requested, but swap chain images cannot be transfer sources");
+        }
+        create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
 
-    QueueFamilyIndices indices = findQueueFamilies(physical_device_);
+    const QueueFamilyIndices& indices = device_caps_.queue_families;
     uint32_t queue_family_indices[] = {
             indices.graphics_family.value(), indices.present_family.value()
     };
@@ -396,37 +844,94 @@ void TriangleApplication::createSwapChain()
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
-    VkResult res = vkCreateSwapchainKHR(device_, &create_info, nullptr, &swap_chain_);
+    create_info.oldSwapchain = output.swap_chain;
+    VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
+    VkResult res = vkCreateSwapchainKHR(device_, &create_info, nullptr, &swap_chain);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain, error: " + std::to_string(res));
     }
-    vkGetSwapchainImagesKHR(device_, swap_chain_, &image_count, nullptr);
-    swap_chain_images_.resize(image_count);
-    vkGetSwapchainImagesKHR(device_, swap_chain_, &image_count, swap_chain_images_.data());
-    swap_chain_image_format_ = surface_format.format;
-    swap_chain_extent_ = extent;
+    // A replaced swap chain may still have frames in flight presenting from it.
+    deletion_queue_.retire(frame_number_, std::move(output.swap_chain));
+    output.swap_chain = utils::UniqueSwapchain(device_, swap_chain);
+    vkGetSwapchainImagesKHR(device_, output.swap_chain, &image_count, nullptr);
+    output.images.resize(image_count);
+    vkGetSwapchainImagesKHR(device_, output.swap_chain, &image_count, output.images.data());
+    output.format = surface_format.format;
+    output.extent = extent;
+    if (main_window) {
+        render_extent_ = extent;
+    }
     std::cout << "Swap chain created" << std::endl;
 }
 
+void TriangleApplication::recreateSwapChain(WindowOutput& output)
+{
+    // Nothing waits for the GPU here: the old swap chain, its views and its
+    // framebuffers go to the deletion queue and are destroyed once the frames
+    // already submitted with them have completed.
+    output.support = querySwapChainSupport(physical_device_, output.surface);
+    const VkExtent2D extent = chooseSwapExtent(output.support.capabilities, output.window.get());
+    if (extent.width == 0 || extent.height == 0) {
+        // Minimized; the next acquire fails again and retries.
+        return;
+    }
+    const bool main_window = &output == &outputs_.front();
+    const VkFormat old_format = output.format;
+    const VkExtent2D old_extent = output.extent;
+    createSwapChain(output);
+    // Present IDs are per swap chain; the last one queued on the old chain is
+    // not waited for.
+    if (present_wait_ && main_window) {
+        pending_present_.reset();
+    }
+    if (output.format != old_format) {
+        throw std::runtime_error("swap chain format changed, the render passes no longer match");
+    }
+    createImageViews(output);
+    createFramebuffers(output);
+    if (main_window && depth_pyramid_) {
+        createDepthPrepass();
+    }
+    if (main_window && (output.extent.width != old_extent.width || output.extent.height != old_extent.height)) {
+        if (frame_capture_) {
+            throw std::runtime_error("swap chain size changed while capturing frames");
+        }
+        if (dynamic_resolution_) {
+            deletion_queue_.retire(frame_number_, std::move(offscreen_framebuffer_));
+            deletion_queue_.retire(frame_number_, std::move(offscreen_target_));
+            deletion_queue_.retire(frame_number_, std::move(offscreen_depth_));
+            deletion_queue_.retire(frame_number_, std::move(offscreen_render_pass_));
+            createOffscreenTarget();
+        }
+    }
+    std::cout << "Swap chain recreated (" << output.extent.width << "x" << output.extent.height << ", "
+              << deletion_queue_.size() << " objects waiting for deletion)" << std::endl;
+}
+
 void TriangleApplication::createSurface()
 {
-    VkResult res = glfwCreateWindowSurface(instance_, window_, nullptr, &surface_);
-    if (res != VK_SUCCESS) {
-        throw std::runtime_error("failed to create window surface, error: " + std::to_string(res));
+    for (auto& output: outputs_) {
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+        VkResult res = glfwCreateWindowSurface(instance_, output.window.get(), nullptr, &surface);
+        if (res != VK_SUCCESS) {
+            throw std::runtime_error("failed to create window surface, error: " + std::to_string(res));
+        }
+        output.surface = utils::UniqueSurface(instance_, surface);
     }
     std::cout << "Surface created" << std::endl;
 }
 
-void TriangleApplication::createImageViews()
+void TriangleApplication::createImageViews(WindowOutput& output)
 {
-    swap_chain_image_views_.reserve(swap_chain_images_.size());
-    for (size_t i = 0; i < swap_chain_images_.size(); ++i) {
+    deletion_queue_.retire(frame_number_, std::move(output.image_views));
+    output.image_views.clear();
+    output.image_views.reserve(output.images.size());
+    for (size_t i = 0; i < output.images.size(); ++i) {
         VkImageViewCreateInfo create_info{};
         create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        create_info.image = swap_chain_images_[i];
+        create_info.image = output.images[i];
         create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        create_info.format = swap_chain_image_format_;
+        create_info.format = output.format;
         create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
         create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
         create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -441,44 +946,124 @@ void TriangleApplication::createImageViews()
         if (res != VK_SUCCESS) {
             throw std::runtime_error("failed to create image views, error: " + std::to_string(res));
         }
-        swap_chain_image_views_.push_back(std::move(view));
+        output.image_views.emplace_back(device_, view);
         std::cout << "ImageView created" << std::endl;
     }
 }
 
 void TriangleApplication::createRenderPass() 
+{
+    depth_format_ = findDepthFormat();
+    render_pass_ = createSceneRenderPass(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    if (options_.occlusion_culling) {
+        prepass_render_pass_ = createPrepassRenderPass();
+        // The main window keeps the prepass depth, which the pyramid build read
+        // in compute, and only draws what the prepass has not.
+        load_depth_render_pass_ = createSceneRenderPass(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                        VK_ATTACHMENT_LOAD_OP_LOAD);
+    }
+    std::cout << "RenderPass created" << std::endl;
+}
+
+VkFormat TriangleApplication::findDepthFormat()
+{
+    // Occlusion culling samples the main window's depth to build its pyramid.
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (options_.occlusion_culling) {
+        needed |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    }
+    for (VkFormat format: { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32 }) {
+        VkFormatProperties format_props{};
+        vkGetPhysicalDeviceFormatProperties(physical_device_, format, &format_props);
+        if ((format_props.optimalTilingFeatures & needed) == needed) {
+            return format;
+        }
+    }
+    throw std::runtime_error("failed to find a supported depth format");
+}
+
+void TriangleApplication::createDescriptorSetLayout()
+{
+    VkDescriptorSetLayoutBinding frame_binding{};
+    frame_binding.binding = 0;
+    frame_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    frame_binding.descriptorCount = 1;
+    frame_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    frame_binding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.bindingCount = 1;
+    create_info.pBindings = &frame_binding;
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkResult res = vkCreateDescriptorSetLayout(device_, &create_info, nullptr, &layout);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout, error: " + std::to_string(res));
+    }
+    descriptor_set_layout_ = utils::UniqueDescriptorSetLayout(device_, layout);
+    std::cout << "Descriptor set layout created" << std::endl;
+}
+
+utils::UniqueRenderPass TriangleApplication::createSceneRenderPass(VkImageLayout final_layout, VkPipelineStageFlags src_stage,
+                                                                  VkAttachmentLoadOp depth_load_op)
 {
     VkAttachmentDescription color_attachment{};
-    color_attachment.format = swap_chain_image_format_;
+    color_attachment.format = outputs_.front().format;
     color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
     color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_attachment.finalLayout = final_layout;
+
+    // Loaded depth comes from the occlusion culling prepass, already read by
+    // the pyramid build.
+    VkAttachmentDescription depth_attachment{};
+    depth_attachment.format = depth_format_;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = depth_load_op;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = depth_load_op == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                                                                 : VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription attachments[] = { color_attachment, depth_attachment };
 
     VkAttachmentReference color_attachment_ref{};
     color_attachment_ref.attachment = 0;
     color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depth_attachment_ref{};
+    depth_attachment_ref.attachment = 1;
+    depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &color_attachment_ref;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
 
+    // The depth buffer is shared by all frames in flight, so the previous
+    // frame's depth tests have to finish before this one clears it.
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcStageMask = src_stage | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
     VkRenderPassCreateInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_info.attachmentCount = 1;
-    render_pass_info.pAttachments = &color_attachment;
+    render_pass_info.attachmentCount = 2;
+    render_pass_info.pAttachments = attachments;
     render_pass_info.subpassCount = 1;
     render_pass_info.pSubpasses = &subpass;
     render_pass_info.dependencyCount = 1;
@@ -486,40 +1071,212 @@ void TriangleApplication::createRenderPass()
 
 
 
-    VkResult res = vkCreateRenderPass(device_, &render_pass_info, nullptr, &render_pass_);
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    VkResult res = vkCreateRenderPass(device_, &render_pass_info, nullptr, &render_pass);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass, error: " + std::to_string(res));
     }
-    std::cout << "RenderPass created" << std::endl;
+    return utils::UniqueRenderPass(device_, render_pass);
+}
+
+utils::UniqueRenderPass TriangleApplication::createPrepassRenderPass()
+{
+    VkAttachmentDescription depth_attachment{};
+    depth_attachment.format = depth_format_;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_ref{};
+    depth_attachment_ref.attachment = 0;
+    depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    // The previous frame's main pass and pyramid build are done with the depth
+    // before it is cleared; the pyramid build of this frame samples the result.
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkRenderPassCreateInfo render_pass_info{};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &depth_attachment;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    render_pass_info.dependencyCount = 2;
+    render_pass_info.pDependencies = dependencies;
+
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    VkResult res = vkCreateRenderPass(device_, &render_pass_info, nullptr, &render_pass);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth prepass, error: " + std::to_string(res));
+    }
+    return utils::UniqueRenderPass(device_, render_pass);
+}
+
+utils::UniqueImage TriangleApplication::createDepthImage(VkExtent2D extent, VkImageUsageFlags usage)
+{
+    return utils::UniqueImage(device_, utils::createImage(device_, device_caps_.memory_properties, extent, depth_format_,
+                                                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | usage,
+                                                          VK_IMAGE_ASPECT_DEPTH_BIT));
+}
+
+void TriangleApplication::createOffscreenTarget()
+{
+    VkFormatProperties format_props{};
+    const WindowOutput& output = outputs_.front();
+    vkGetPhysicalDeviceFormatProperties(physical_device_, output.format, &format_props);
+    const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if ((format_props.optimalTilingFeatures & needed) != needed) {
+        throw std::runtime_error("dynamic resolution requested, but the swap chain format does not support linear blits");
+    }
+
+    // The target is allocated at full size once; lower scales only render into
+    // its top-left corner, so changing the scale never reallocates anything.
+    offscreen_target_ = utils::UniqueImage(device_, utils::createImage(device_, device_caps_.memory_properties, output.extent,
+                                                                       output.format,
+                                                                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                                                       VK_IMAGE_ASPECT_COLOR_BIT));
+    // The previous frame's blit reads the target, so the next render pass has to
+    // wait for transfers as well as for color output.
+    offscreen_render_pass_ = createSceneRenderPass(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+    offscreen_depth_ = createDepthImage(output.extent, 0);
+
+    VkImageView attachments[] = { offscreen_target_->view, offscreen_depth_->view };
+
+    VkFramebufferCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    create_info.renderPass = offscreen_render_pass_;
+    create_info.attachmentCount = 2;
+    create_info.pAttachments = attachments;
+    create_info.width = output.extent.width;
+    create_info.height = output.extent.height;
+    create_info.layers = 1;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkResult res = vkCreateFramebuffer(device_, &create_info, nullptr, &framebuffer);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create offscreen framebuffer, error: " + std::to_string(res));
+    }
+    offscreen_framebuffer_ = utils::UniqueFramebuffer(device_, framebuffer);
+
+    DynamicResolutionSettings settings{};
+    settings.budget_ms = options_.dynamic_resolution_budget_ms;
+    settings.min_scale = options_.dynamic_resolution_min_scale;
+    dynamic_resolution_.emplace(settings);
+    std::cout << "Offscreen target created" << std::endl;
+}
+
+void TriangleApplication::createPipelineCache(const std::vector<char>& initial_data)
+{
+    // A blob written by another driver or GPU is rejected by the implementation
+    // itself, which then simply starts from an empty cache.
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = initial_data.size();
+    create_info.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+
+    VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+    VkResult res = vkCreatePipelineCache(device_, &create_info, nullptr, &pipeline_cache);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache, error: " + std::to_string(res));
+    }
+    pipeline_cache_ = utils::UniquePipelineCache(device_, pipeline_cache);
+    std::cout << "Pipeline cache created (" << initial_data.size() << " bytes loaded)" << std::endl;
+}
+
+void TriangleApplication::savePipelineCache()
+{
+    if (pipeline_cache_ == VK_NULL_HANDLE) {
+        return;
+    }
+    size_t size = 0;
+    VkResult res = vkGetPipelineCacheData(device_, pipeline_cache_, &size, nullptr);
+    if (res != VK_SUCCESS || size == 0) {
+        return;
+    }
+    std::vector<char> data(size);
+    res = vkGetPipelineCacheData(device_, pipeline_cache_, &size, data.data());
+    if (res != VK_SUCCESS) {
+        return;
+    }
+    try {
+        utils::writeFile(pipeline_cache_path, data.data(), size);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
 }
 
 void TriangleApplication::createGraphicsPipeline()
 {
-#if defined(_WIN32)
-    auto vert = utils::readFile("shaders\\vert.spv");
-    std::cout << "vert size: " << vert.size() << std::endl;
-    auto frag = utils::readFile("shaders\\frag.spv");
-    std::cout << "vert size: " << frag.size() << std::endl;
-#elif defined(__linux__)
-    auto vert = utils::readFile("shaders/vert.spv");
-    std::cout << "vert size: " << vert.size() << std::endl;
-    auto frag = utils::readFile("shaders/frag.spv");
-    std::cout << "vert size: " << frag.size() << std::endl;
-#endif
-    VkShaderModule vert_shader_module = createShaderModule(vert);
-    VkShaderModule frag_shader_module = createShaderModule(frag);
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(DrawPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = descriptor_set_layout_.address();
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkResult res = vkCreatePipelineLayout(device_, &pipeline_layout_info, nullptr, &pipeline_layout);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout, error: " + std::to_string(res));
+    }
+    pipeline_layout_ = utils::UniquePipelineLayout(device_, pipeline_layout);
+
+    std::cout << "Pipeline layout created" << std::endl;
+
+    triangle_pipelines_ = std::make_unique<PipelineVariants<TriangleFeatures>>(device_, [this](const VkSpecializationInfo& specialization) {
+        return createTrianglePipeline(specialization);
+    });
+    // Built up front so the first frame does not wait for it; other variants are
+    // built when first drawn.
+    triangle_pipelines_->get(default_triangle_features);
+    std::cout << "Pipeline created" << std::endl;
+}
+
+VkPipeline TriangleApplication::createTrianglePipeline(const VkSpecializationInfo& specialization)
+{
+    utils::UniqueShaderModule vert_shader_module = createShaderModule(vert_shader_code_);
+    utils::UniqueShaderModule frag_shader_module = createShaderModule(frag_shader_code_);
 
     VkPipelineShaderStageCreateInfo vert_stage_info{};
     vert_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vert_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vert_stage_info.module = vert_shader_module;
     vert_stage_info.pName = "main";
+    vert_stage_info.pSpecializationInfo = &specialization;
 
     VkPipelineShaderStageCreateInfo frag_stage_info{};
     frag_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     frag_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     frag_stage_info.module = frag_shader_module;
     frag_stage_info.pName = "main";
+    frag_stage_info.pSpecializationInfo = &specialization;
 
     std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = {
         vert_stage_info, 
@@ -550,13 +1307,13 @@ void TriangleApplication::createGraphicsPipeline()
     VkViewport view_port{};
     view_port.x = 0.0f;
     view_port.y = 0.0f;
-    view_port.height = static_cast<float>(swap_chain_extent_.height);
-    view_port.width = static_cast<float>(swap_chain_extent_.width);
+    view_port.height = static_cast<float>(outputs_.front().extent.height);
+    view_port.width = static_cast<float>(outputs_.front().extent.width);
     view_port.minDepth = 0.0f;
     view_port.maxDepth = 1.0f;
 
     VkRect2D scissor{};
-    scissor.extent = swap_chain_extent_;
+    scissor.extent = outputs_.front().extent;
     scissor.offset = {0, 0};
 
     VkPipelineViewportStateCreateInfo viewport_state_info{};
@@ -609,19 +1366,12 @@ void TriangleApplication::createGraphicsPipeline()
     color_blend_info.blendConstants[2] = 0.0f;
     color_blend_info.blendConstants[3] = 0.0f;
 
-    VkPipelineLayoutCreateInfo pipeline_layout_info{};
-    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_info.setLayoutCount = 0;
-    pipeline_layout_info.pSetLayouts = nullptr;
-    pipeline_layout_info.pushConstantRangeCount = 0;
-    pipeline_layout_info.pPushConstantRanges = nullptr;
-
-    VkResult res = vkCreatePipelineLayout(device_, &pipeline_layout_info, nullptr, &pipeline_layout_);
-    if (res != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout, error: " + std::to_string(res));
-    }
-
-    std::cout << "Pipeline layout created" << std::endl;
+    // The triangle is flat and drawn alone; it ignores the depth buffer.
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info{};
+    depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil_info.depthTestEnable = VK_FALSE;
+    depth_stencil_info.depthWriteEnable = VK_FALSE;
+    depth_stencil_info.depthCompareOp = VK_COMPARE_OP_ALWAYS;
 
     VkGraphicsPipelineCreateInfo pipeline_info{};
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -633,7 +1383,7 @@ void TriangleApplication::createGraphicsPipeline()
     pipeline_info.pViewportState = &viewport_state_info;
     pipeline_info.pRasterizationState = &rasterizer_info;
     pipeline_info.pMultisampleState = &multisample_state_info;
-    pipeline_info.pDepthStencilState = nullptr;
+    pipeline_info.pDepthStencilState = &depth_stencil_info;
     pipeline_info.pColorBlendState = &color_blend_info;
     pipeline_info.pDynamicState = &dynamic_state_info;
 
@@ -643,71 +1393,108 @@ void TriangleApplication::createGraphicsPipeline()
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.basePipelineIndex = -1;
 
-    res = vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &graphics_pipeline_);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult res = vkCreateGraphicsPipelines(device_, pipeline_cache_, 1, &pipeline_info, nullptr, &pipeline);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline, error: " + std::to_string(res));
     }
-
-    std::cout << "Pipeline created" << std::endl;
-
-    vkDestroyShaderModule(device_, vert_shader_module, nullptr);
-    vkDestroyShaderModule(device_, frag_shader_module, nullptr);
+    return pipeline;
 }
 
-void TriangleApplication::createFramebuffers()
+void TriangleApplication::createFramebuffers(WindowOutput& output)
 {
-    swap_chain_framebuffers_.resize(swap_chain_image_views_.size());
-
-    for (size_t i = 0; i < swap_chain_image_views_.size(); i++) {
+    deletion_queue_.retire(frame_number_, std::move(output.framebuffers));
+    output.framebuffers.clear();
+    output.framebuffers.reserve(output.image_views.size());
+    deletion_queue_.retire(frame_number_, std::move(output.depth));
+    const bool sampled = options_.occlusion_culling && &output == &outputs_.front();
+    output.depth = createDepthImage(output.extent, sampled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
+
+    for (size_t i = 0; i < output.image_views.size(); i++) {
         VkImageView attachments[] = {
-            swap_chain_image_views_[i]
+            output.image_views[i],
+            output.depth->view
         };
 
         VkFramebufferCreateInfo create_info{};
         create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         create_info.renderPass = render_pass_;
-        create_info.attachmentCount = 1;
+        create_info.attachmentCount = 2;
         create_info.pAttachments = attachments;
-        create_info.width = swap_chain_extent_.width;
-        create_info.height = swap_chain_extent_.height;
+        create_info.width = output.extent.width;
+        create_info.height = output.extent.height;
         create_info.layers = 1;
 
-        VkResult res = vkCreateFramebuffer(device_, &create_info, nullptr, &swap_chain_framebuffers_[i]);
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkResult res = vkCreateFramebuffer(device_, &create_info, nullptr, &framebuffer);
         if (res != VK_SUCCESS) {
             throw std::runtime_error("failed to create framebuffer, error: " + std::to_string(res));
         }
+        output.framebuffers.emplace_back(device_, framebuffer);
     }
     std::cout << "Framebuffers created" << std::endl;
 }
 
+void TriangleApplication::createDepthPrepass()
+{
+    // Frames in flight still render with the old framebuffer and pyramid.
+    deletion_queue_.retire(frame_number_, std::move(prepass_framebuffer_));
+    deletion_queue_.retire(frame_number_, std::move(depth_pyramid_));
+
+    const WindowOutput& output = outputs_.front();
+    VkFramebufferCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    create_info.renderPass = prepass_render_pass_;
+    create_info.attachmentCount = 1;
+    create_info.pAttachments = &output.depth->view;
+    create_info.width = output.extent.width;
+    create_info.height = output.extent.height;
+    create_info.layers = 1;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkResult res = vkCreateFramebuffer(device_, &create_info, nullptr, &framebuffer);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth prepass framebuffer, error: " + std::to_string(res));
+    }
+    prepass_framebuffer_ = utils::UniqueFramebuffer(device_, framebuffer);
+
+    depth_pyramid_ = std::make_unique<DepthPyramid>(device_, device_caps_.memory_properties, pipeline_cache_,
+                                                    output.depth->view, output.extent);
+    if (cluster_renderer_) {
+        cluster_renderer_->setDepthPyramid(depth_pyramid_.get());
+    }
+}
+
 void TriangleApplication::createCommandPool()
 {
-    QueueFamilyIndices queue_family_indices = findQueueFamilies(physical_device_);
+    const QueueFamilyIndices& queue_family_indices = device_caps_.queue_families;
     VkCommandPoolCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     create_info.queueFamilyIndex = queue_family_indices.graphics_family.value();
 
-    VkResult res = vkCreateCommandPool(device_, &create_info, nullptr, &command_pool_);
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkResult res = vkCreateCommandPool(device_, &create_info, nullptr, &command_pool);
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool, error: " + std::to_string(res));
-    } 
+    }
+    command_pool_ = utils::UniqueCommandPool(device_, command_pool);
     std::cout << "Command pool created" << std::endl;
 }
 
-void TriangleApplication::createCommandBuffer()
+void TriangleApplication::createCommandBuffers()
 {
+    command_buffers_.resize(max_frames_in_flight);
     VkCommandBufferAllocateInfo alloc_info{};
     alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     alloc_info.commandPool = command_pool_;
-    alloc_info.commandBufferCount = 1;
+    alloc_info.commandBufferCount = static_cast<uint32_t>(command_buffers_.size());
     alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-    VkResult res = vkAllocateCommandBuffers(device_, &alloc_info, &command_buffer_);
+    VkResult res = vkAllocateCommandBuffers(device_, &alloc_info, command_buffers_.data());
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers, error: " + std::to_string(res));
     }
-    std::cout << "Command buffer created" << std::endl;
+    std::cout << "Command buffers created" << std::endl;
 }
 
 void TriangleApplication::createSyncObjects()
@@ -719,21 +1506,378 @@ void TriangleApplication::createSyncObjects()
     fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    VkResult res = vkCreateSemaphore(device_, &semaphore_info, nullptr, &semaphore_image_available_);
-    if (res != VK_SUCCESS) {
-        throw std::runtime_error("failed to create image_available semaphore, error: " + std::to_string(res));
+    for (uint32_t i = 0; i < max_frames_in_flight; ++i) {
+        for (auto& output: outputs_) {
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            VkResult res = vkCreateSemaphore(device_, &semaphore_info, nullptr, &semaphore);
+            if (res != VK_SUCCESS) {
+                throw std::runtime_error("failed to create image_available semaphore, error: " + std::to_string(res));
+            }
+            output.image_available.emplace_back(device_, semaphore);
+            res = vkCreateSemaphore(device_, &semaphore_info, nullptr, &semaphore);
+            if (res != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render_finished semaphore, error: " + std::to_string(res));
+            }
+            output.render_finished.emplace_back(device_, semaphore);
+        }
+        VkFence fence = VK_NULL_HANDLE;
+        VkResult res = vkCreateFence(device_, &fence_info, nullptr, &fence);
+        if (res != VK_SUCCESS) {
+            throw std::runtime_error("failed to create in_flight fence, error: " + std::to_string(res));
+        }
+        fences_in_flight_.emplace_back(device_, fence);
     }
-    res = vkCreateSemaphore(device_, &semaphore_info, nullptr, &semaphore_render_finished_);
+}
+
+void TriangleApplication::createUniformRing()
+{
+    uniform_ring_ = std::make_unique<UniformRing>(device_, device_caps_.memory_properties, device_caps_.properties.limits,
+                                                  uniform_bytes_per_frame, max_frames_in_flight);
+}
+
+void TriangleApplication::createDescriptorSet()
+{
+    VkDescriptorPoolSize pool_size{};
+    pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    pool_size.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    VkResult res = vkCreateDescriptorPool(device_, &pool_info, nullptr, &descriptor_pool);
     if (res != VK_SUCCESS) {
-        throw std::runtime_error("failed to create render_finished semaphore, error: " + std::to_string(res));
+        throw std::runtime_error("failed to create descriptor pool, error: " + std::to_string(res));
     }
-    res = vkCreateFence(device_, &fence_info, nullptr, &fence_in_flight_);
+    descriptor_pool_ = utils::UniqueDescriptorPool(device_, descriptor_pool);
+
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool_;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = descriptor_set_layout_.address();
+    res = vkAllocateDescriptorSets(device_, &alloc_info, &descriptor_set_);
     if (res != VK_SUCCESS) {
-        throw std::runtime_error("failed to create in_flight fence, error: " + std::to_string(res));
+        throw std::runtime_error("failed to allocate descriptor set, error: " + std::to_string(res));
+    }
+
+    // One descriptor covers every frame: the dynamic offset picks the frame's
+    // sub-allocation at bind time.
+    VkDescriptorBufferInfo buffer_info{};
+    buffer_info.buffer = uniform_ring_->buffer();
+    buffer_info.offset = 0;
+    buffer_info.range = sizeof(FrameUniforms);
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptor_set_;
+    write.dstBinding = 0;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+    std::cout << "Descriptor set created" << std::endl;
+}
+
+void TriangleApplication::createFrameCapture()
+{
+    const WindowOutput& output = outputs_.front();
+    auto sink = createCaptureSink(options_.capture, output.extent, output.format);
+    frame_capture_ = std::make_unique<FrameCapture>(device_, device_caps_.memory_properties,
+                                                    output.extent, output.format,
+                                                    options_.capture_ring_size, std::move(sink));
+}
+
+void TriangleApplication::createGpuTimer()
+{
+    uint32_t graphics_family = device_caps_.queue_families.graphics_family.value();
+    if (device_caps_.queue_family_properties[graphics_family].timestampValidBits == 0 ||
+        device_caps_.properties.limits.timestampPeriod <= 0.0f) {
+        if (dynamic_resolution_) {
+            std::cerr << "GPU timestamps are not supported, dynamic resolution stays at full scale" << std::endl;
+        }
+        if (options_.variant_bench_frames > 0) {
+            std::cerr << "GPU timestamps are not supported, pipeline variants cannot be timed" << std::endl;
+        }
+        return;
+    }
+    gpu_timer_ = std::make_unique<GpuTimer>(device_, device_caps_.properties.limits.timestampPeriod, max_frames_in_flight);
+    if (options_.variant_bench_frames > 0) {
+        draw_timer_ = std::make_unique<GpuTimer>(device_, device_caps_.properties.limits.timestampPeriod, max_frames_in_flight);
     }
+    std::cout << "GPU timer created" << std::endl;
 }
 
-void TriangleApplication::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index)
+void TriangleApplication::createFramePacer()
+{
+    FramePacerSettings settings{};
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (mode != nullptr && mode->refreshRate > 0) {
+        settings.refresh_period_ms = 1000.0 / mode->refreshRate;
+    }
+    frame_pacer_.emplace(settings);
+    if (present_wait_) {
+        wait_for_present_ = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR"));
+        if (wait_for_present_ == nullptr) {
+            throw std::runtime_error("failed to load vkWaitForPresentKHR");
+        }
+    }
+    if (!options_.latency_log.empty()) {
+        latency_log_.open(options_.latency_log);
+        if (!latency_log_) {
+            throw std::runtime_error("failed to open latency log: " + options_.latency_log);
+        }
+        latency_log_ << "frame,latency_ms,start_delay_ms,missed" << std::endl;
+    }
+    std::cout << "Frame pacing: " << (present_wait_ ? "present wait" : "software estimate") << ", "
+              << 1000.0 / settings.refresh_period_ms << " Hz" << std::endl;
+}
+
+void TriangleApplication::paceFrame()
+{
+    // Waits until the previous frame is on screen, or with the software stand-in
+    // until it has rendered and the vblank it is predicted to show at, and then
+    // for the pacer's start delay.
+    if (pending_present_) {
+        const uint64_t frame = *pending_present_;
+        std::optional<FramePacer::Clock::time_point> presented;
+        if (present_wait_) {
+            VkResult res = wait_for_present_(device_, outputs_.front().swap_chain, frame + 1, present_wait_timeout_ns);
+            if (res == VK_SUCCESS || res == VK_SUBOPTIMAL_KHR) {
+                presented = FramePacer::Clock::now();
+            } else if (res != VK_TIMEOUT && res != VK_ERROR_OUT_OF_DATE_KHR) {
+                throw std::runtime_error("failed to wait for present, error: " + std::to_string(res));
+            }
+        } else {
+            VkFence fence = fences_in_flight_[frame % max_frames_in_flight];
+            VkResult res = vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+            if (res != VK_SUCCESS) {
+                throw std::runtime_error("failed to wait for fences, error: " + std::to_string(res));
+            }
+            presented = frame_pacer_->estimatePresent(FramePacer::Clock::now());
+        }
+        pending_present_.reset();
+        if (presented) {
+            auto latency = frame_pacer_->framePresented(frame, *presented);
+            if (latency && latency_log_.is_open()) {
+                latency_log_ << latency->frame_number << "," << latency->latency_ms << "," << latency->start_delay_ms
+                             << "," << latency->missed << "\n";
+            }
+            std::this_thread::sleep_until(frame_pacer_->startTime(*presented));
+        }
+    }
+    frame_pacer_->frameStarted(frame_number_, FramePacer::Clock::now());
+    if (frame_number_ % 120 == 0 && frame_number_ > 0) {
+        frame_pacer_->printStats(std::cout);
+    }
+}
+
+void TriangleApplication::createClusterRenderer(const MeshletData& data)
+{
+    ClusterRendererFeatures features{};
+    // Occlusion culling draws the indirect lists twice, so it needs the compute path.
+    features.mesh_shaders = options_.mesh_shaders && !options_.occlusion_culling && device_caps_.supportsMeshShaders();
+    features.multi_draw_indirect = device_caps_.features.multiDrawIndirect;
+    features.draw_indirect_first_instance = device_caps_.features.drawIndirectFirstInstance;
+    features.max_draw_indirect_count = device_caps_.properties.limits.maxDrawIndirectCount;
+    features.occlusion_culling = options_.occlusion_culling;
+    cluster_renderer_ = std::make_unique<ClusterRenderer>(device_, device_caps_.memory_properties, graphics_queue_, command_pool_,
+                                                          pipeline_cache_, render_pass_, prepass_render_pass_,
+                                                          uniform_ring_->buffer(), sizeof(FrameUniforms), data, features,
+                                                          max_frames_in_flight);
+    if (depth_pyramid_) {
+        cluster_renderer_->setDepthPyramid(depth_pyramid_.get());
+    }
+}
+
+void TriangleApplication::createMeshRenderer(const MeshFile& mesh)
+{
+    mesh_renderer_ = std::make_unique<MeshRenderer>(device_, device_caps_.memory_properties, graphics_queue_, command_pool_,
+                                                    pipeline_cache_, render_pass_, descriptor_set_layout_, mesh);
+}
+
+void TriangleApplication::createScene()
+{
+    // Culling splits the scene into batches for these workers; the texture
+    // streamer shares them, and its decode jobs wait while culling batches run.
+    jobs_ = std::make_unique<JobSystem>();
+    scene_ = std::make_unique<Scene>();
+    grid_ = buildGridScene(*scene_, options_.scene_instances, mesh_renderer_->center(), mesh_renderer_->radius(),
+                           scene_material_count);
+    scene_->updateTransforms();
+    std::cout << "Scene created: " << scene_->size() << " nodes, " << grid_.groups.size() << " groups ("
+              << Scene::simdPath() << ", " << jobs_->threadCount() << " worker threads)" << std::endl;
+}
+
+void TriangleApplication::updateScene(const Camera& camera, float time)
+{
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    // One group in eight spins; the rest of the scene stays clean.
+    animateGridScene(*scene_, grid_, time, 8);
+    uint32_t moved = scene_->updateTransforms();
+    auto updated = Clock::now();
+    scene_->cull(camera.frustum_planes, CullTest::sphere, jobs_.get(), scene_visible_);
+    auto culled = Clock::now();
+    // View depth over the far end of the orbit, front to back within a state.
+    queueSceneDraws(*scene_, scene_visible_, camera, grid_.radius, draw_queue_);
+    const bool print_stats = frame_number_ % 120 == 0;
+    if (print_stats) {
+        // Replaying the keys costs as much as recording them, so the unsorted
+        // order is only measured on frames that print it.
+        unsorted_binds_ = draw_queue_.bindStats();
+    }
+    auto queued = Clock::now();
+    draw_queue_.sort();
+    auto sorted = Clock::now();
+    if (print_stats) {
+        auto ms = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+        std::cout << "Scene: " << scene_visible_.size() << "/" << options_.scene_instances << " visible, " << moved
+                  << " nodes updated in " << ms(updated - start) << " ms, culled in " << ms(culled - updated)
+                  << " ms, sorted in " << ms(sorted - queued) << " ms" << std::endl;
+    }
+}
+
+void TriangleApplication::printClusterStats(uint32_t frame_slot)
+{
+    if (!cluster_renderer_ || frame_number_ % 120 != 0) {
+        return;
+    }
+    auto stats = cluster_renderer_->readStats(frame_slot);
+    if (!stats) {
+        return;
+    }
+    std::cout << "Clusters: " << stats->visible << "/" << cluster_renderer_->meshletCount() << " visible, "
+              << stats->frustum_culled << " frustum culled, " << stats->backface_culled << " back-face culled ("
+              << (cluster_renderer_->usesMeshShaders() ? "mesh shaders" : "compute + indirect") << ")" << std::endl;
+    if (cluster_renderer_->usesOcclusionCulling()) {
+        std::cout << "Clusters: " << stats->occlusion_culled << " occlusion culled, " << stats->late_visible
+                  << " drawn late" << std::endl;
+    }
+}
+
+void TriangleApplication::createTextureStreamer()
+{
+    std::vector<std::string> paths;
+    for (const auto& entry: std::filesystem::directory_iterator(options_.textures)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".ktx2") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    TextureStreamerConfig config{};
+    config.memory_cap = VkDeviceSize(options_.texture_budget_mib) << 20;
+    config.upload_budget = VkDeviceSize(options_.texture_upload_mib) << 20;
+    config.frame_count = max_frames_in_flight;
+    if (!jobs_) {
+        jobs_ = std::make_unique<JobSystem>();
+    }
+    texture_streamer_ = std::make_unique<TextureStreamer>(physical_device_, device_, device_caps_.memory_properties,
+                                                          device_caps_.supportsMemoryBudget(), *jobs_, config);
+    for (const auto& path: paths) {
+        try {
+            textures_.push_back(texture_streamer_->addTexture(path));
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping texture: " << e.what() << std::endl;
+        }
+    }
+    std::cout << "Streaming " << textures_.size() << " textures from " << options_.textures << " on "
+              << jobs_->threadCount() << " worker threads" << std::endl;
+}
+
+void TriangleApplication::updateDynamicResolution(uint32_t frame_slot)
+{
+    if (!gpu_timer_ || !dynamic_resolution_) {
+        return;
+    }
+    if (rendered_scales_.empty()) {
+        rendered_scales_.resize(max_frames_in_flight);
+    }
+    auto gpu_ms = gpu_timer_->read(frame_slot);
+    std::optional<float>& rendered_scale = rendered_scales_[frame_slot];
+    if (gpu_ms && rendered_scale) {
+        dynamic_resolution_->addSample(*gpu_ms, *rendered_scale);
+    }
+    const float scale = dynamic_resolution_->scale();
+    render_extent_.width = std::max(1u, static_cast<uint32_t>(outputs_.front().extent.width * scale));
+    render_extent_.height = std::max(1u, static_cast<uint32_t>(outputs_.front().extent.height * scale));
+    rendered_scale = scale;
+    if (gpu_ms && frame_number_ % 120 == 0) {
+        std::cout << "Dynamic resolution: scale " << scale << " (" << render_extent_.width << "x" << render_extent_.height
+                  << "), gpu " << *gpu_ms << " ms, avg " << dynamic_resolution_->averageMs()
+                  << " ms, budget " << dynamic_resolution_->settings().budget_ms << " ms" << std::endl;
+    }
+}
+
+void TriangleApplication::updateVariantBenchmark(uint32_t frame_slot)
+{
+    using Variants = PipelineVariants<TriangleFeatures>;
+    if (!draw_timer_) {
+        return;
+    }
+    if (variant_bench_slots_.empty()) {
+        variant_bench_slots_.resize(max_frames_in_flight);
+        variant_bench_times_.resize(Variants::variant_count);
+    }
+    auto draw_ms = draw_timer_->read(frame_slot);
+    if (draw_ms && variant_bench_slots_[frame_slot]) {
+        auto& [total_ms, frames] = variant_bench_times_[*variant_bench_slots_[frame_slot]];
+        total_ms += *draw_ms;
+        ++frames;
+    }
+
+    // The first frames of each window build the variant and may still overlap
+    // frames of the previous one, so they are not timed. By the end of the first
+    // window of a cycle, every frame of the previous cycle has been read back.
+    const uint64_t window = options_.variant_bench_frames;
+    const uint64_t position = frame_number_ % (window * Variants::variant_count);
+    const uint64_t warm_up_frames = max_frames_in_flight;
+    if (position == warm_up_frames && frame_number_ > position) {
+        std::cout << "Pipeline variants (" << window - warm_up_frames << " frames each, GPU time of the "
+                  << options_.draw_instances << " instance draw):" << std::endl;
+        for (uint32_t key = 0; key < Variants::variant_count; ++key) {
+            auto& [total_ms, frames] = variant_bench_times_[key];
+            std::cout << "\t" << Variants::name(key) << ": draw " << (frames > 0 ? total_ms / frames : 0.0)
+                      << " ms, built in " << triangle_pipelines_->buildMs(key) << " ms" << std::endl;
+            total_ms = 0.0;
+            frames = 0;
+        }
+    }
+    triangle_variant_ = static_cast<uint32_t>(position / window);
+    variant_bench_slots_[frame_slot] = position % window >= warm_up_frames ? std::optional{triangle_variant_} : std::nullopt;
+}
+
+void TriangleApplication::recordUpscale(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    const WindowOutput& output = outputs_.front();
+    VkImage swap_chain_image = output.images[image_index];
+    utils::imageBarrier(command_buffer, swap_chain_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    VkImageBlit blit{};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = 0;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[0] = {0, 0, 0};
+    blit.srcOffsets[1] = {static_cast<int32_t>(render_extent_.width), static_cast<int32_t>(render_extent_.height), 1};
+    blit.dstSubresource = blit.srcSubresource;
+    blit.dstOffsets[0] = {0, 0, 0};
+    blit.dstOffsets[1] = {static_cast<int32_t>(output.extent.width), static_cast<int32_t>(output.extent.height), 1};
+    vkCmdBlitImage(command_buffer, offscreen_target_->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   swap_chain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+    utils::imageBarrier(command_buffer, swap_chain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+}
+
+void TriangleApplication::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t frame_slot)
 {
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -744,66 +1888,200 @@ void TriangleApplication::recordCommandBuffer(VkCommandBuffer command_buffer, ui
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to begin recording command buffer, error: " + std::to_string(res));
     }
-    std::cout << "Command buffer record begin" << std::endl;
+    if (gpu_timer_) {
+        gpu_timer_->reset(command_buffer, frame_slot);
+        gpu_timer_->begin(command_buffer, frame_slot);
+    }
+    // Stays unavailable, and the frame untimed, if the main window has no image.
+    if (draw_timer_) {
+        draw_timer_->reset(command_buffer, frame_slot);
+    }
+    if (texture_streamer_) {
+        texture_streamer_->recordUpdate(command_buffer, frame_slot, frame_number_);
+    }
+    if (cluster_renderer_) {
+        cluster_renderer_->recordCull(command_buffer, frame_slot, frame_uniforms_offset_);
+    }
+    // Runs even when the main window has no image this frame, so the pyramid
+    // the next frame culls against stays one frame old.
+    if (depth_pyramid_) {
+        recordDepthPrepass(command_buffer, frame_slot);
+    }
+
+    // Every window draws the same view, culled once for the main window.
+    for (const auto& output: outputs_) {
+        if (output.image_index) {
+            recordOutput(command_buffer, output, frame_slot);
+        }
+    }
+    if (cluster_renderer_) {
+        cluster_renderer_->recordEndFrame(command_buffer);
+    }
+
+    const WindowOutput& main_output = outputs_.front();
+    if (dynamic_resolution_ && main_output.image_index) {
+        recordUpscale(command_buffer, *main_output.image_index);
+    }
+
+    if (frame_capture_ && main_output.image_index) {
+        frame_capture_->recordCopy(command_buffer, main_output.images[*main_output.image_index], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                   frame_number_);
+    }
+    if (gpu_timer_) {
+        gpu_timer_->end(command_buffer, frame_slot);
+    }
+
+    res = vkEndCommandBuffer(command_buffer);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer, error: " + std::to_string(res));
+    }
+}
+
+void TriangleApplication::recordDepthPrepass(VkCommandBuffer command_buffer, uint32_t frame_slot)
+{
+    const VkExtent2D extent = outputs_.front().extent;
 
     VkRenderPassBeginInfo rp_begin_info{};
     rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    rp_begin_info.renderPass = render_pass_;
-    rp_begin_info.framebuffer = swap_chain_framebuffers_[image_index];
+    rp_begin_info.renderPass = prepass_render_pass_;
+    rp_begin_info.framebuffer = prepass_framebuffer_;
     rp_begin_info.renderArea.offset = {0, 0};
-    rp_begin_info.renderArea.extent = swap_chain_extent_;
-
-    VkClearValue color_value = {
-        {
-            { 0.0f, 0.0f, 0.0f, 1.0f }
-        }
-    };
+    rp_begin_info.renderArea.extent = extent;
+    VkClearValue depth_value{};
+    depth_value.depthStencil = { 1.0f, 0 };
     rp_begin_info.clearValueCount = 1;
-    rp_begin_info.pClearValues = &color_value;
-
+    rp_begin_info.pClearValues = &depth_value;
     vkCmdBeginRenderPass(command_buffer, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
 
     VkViewport view_port{};
     view_port.x = 0.0f;
     view_port.y = 0.0f;
-    view_port.width = static_cast<float>(swap_chain_extent_.width);
-    view_port.height = static_cast<float>(swap_chain_extent_.height);
+    view_port.width = static_cast<float>(extent.width);
+    view_port.height = static_cast<float>(extent.height);
     view_port.minDepth = 0.0f;
     view_port.maxDepth = 1.0f;
     vkCmdSetViewport(command_buffer, 0, 1, &view_port);
 
     VkRect2D scissor{};
-    scissor.extent = swap_chain_extent_;
+    scissor.extent = extent;
     scissor.offset = {0, 0};
     vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-    vkCmdDraw(command_buffer, 3, 1, 0, 0);
+
+    cluster_renderer_->recordDepthPrepass(command_buffer, frame_slot, frame_uniforms_offset_);
     vkCmdEndRenderPass(command_buffer);
 
-    res = vkEndCommandBuffer(command_buffer);
-    if (res != VK_SUCCESS) {
-        throw std::runtime_error("failed to record command buffer, error: " + std::to_string(res));
+    depth_pyramid_->recordBuild(command_buffer);
+    cluster_renderer_->recordLateCull(command_buffer, frame_slot, frame_uniforms_offset_);
+}
+
+void TriangleApplication::recordOutput(VkCommandBuffer command_buffer, const WindowOutput& output, uint32_t frame_slot)
+{
+    // With dynamic resolution the main window is drawn offscreen and upscaled.
+    const bool offscreen = dynamic_resolution_ && &output == &outputs_.front();
+    const VkExtent2D extent = offscreen ? render_extent_ : output.extent;
+
+    VkRenderPassBeginInfo rp_begin_info{};
+    rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    if (offscreen) {
+        rp_begin_info.renderPass = offscreen_render_pass_;
+        rp_begin_info.framebuffer = offscreen_framebuffer_;
+    } else {
+        const bool main_window = &output == &outputs_.front();
+        rp_begin_info.renderPass = depth_pyramid_ && main_window ? load_depth_render_pass_ : render_pass_;
+        rp_begin_info.framebuffer = output.framebuffers[*output.image_index];
     }
-    std::cout << "Command buffer recorded" << std::endl;
+    rp_begin_info.renderArea.offset = {0, 0};
+    rp_begin_info.renderArea.extent = extent;
+
+    VkClearValue clear_values[2]{};
+    clear_values[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+    clear_values[1].depthStencil = { 1.0f, 0 };
+    rp_begin_info.clearValueCount = 2;
+    rp_begin_info.pClearValues = clear_values;
+
+    vkCmdBeginRenderPass(command_buffer, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport view_port{};
+    view_port.x = 0.0f;
+    view_port.y = 0.0f;
+    view_port.width = static_cast<float>(extent.width);
+    view_port.height = static_cast<float>(extent.height);
+    view_port.minDepth = 0.0f;
+    view_port.maxDepth = 1.0f;
+    vkCmdSetViewport(command_buffer, 0, 1, &view_port);
+
+    VkRect2D scissor{};
+    scissor.extent = extent;
+    scissor.offset = {0, 0};
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    if (cluster_renderer_) {
+        // The counters describe the main window's view, as with compute culling.
+        cluster_renderer_->recordDraw(command_buffer, frame_slot, output.frame_uniforms_offset, &output == &outputs_.front());
+    } else if (scene_) {
+        struct SceneRecorder
+        {
+            VkCommandBuffer command_buffer;
+            MeshRenderer& renderer;
+            const Scene& scene;
+
+            void bindPipeline(uint32_t pipeline) { renderer.recordBindPipeline(command_buffer, pipeline); }
+            void bindMaterial(uint32_t material) { renderer.recordBindMaterial(command_buffer, material); }
+            // The renderer holds a single mesh.
+            void bindMesh(uint32_t) { renderer.recordBindMesh(command_buffer); }
+            void draw(uint32_t node) { renderer.recordInstance(command_buffer, scene.worldTransform(node)); }
+        };
+        mesh_renderer_->recordBindFrame(command_buffer, descriptor_set_, output.frame_uniforms_offset);
+        DrawQueue::BindStats binds = draw_queue_.record(SceneRecorder{command_buffer, *mesh_renderer_, *scene_});
+        if (&output == &outputs_.front() && frame_number_ % 120 == 0) {
+            std::cout << "Binds per window: " << binds.pipeline_binds << " pipeline, " << binds.material_binds
+                      << " material, " << binds.mesh_binds << " mesh for " << binds.draws << " draws (unsorted "
+                      << unsorted_binds_.pipeline_binds << ", " << unsorted_binds_.material_binds << ", "
+                      << unsorted_binds_.mesh_binds << ")" << std::endl;
+        }
+    } else if (mesh_renderer_) {
+        mesh_renderer_->recordDraw(command_buffer, descriptor_set_, output.frame_uniforms_offset);
+    } else {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle_pipelines_->get(triangle_variant_));
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set_,
+                                1, &output.frame_uniforms_offset);
+
+        DrawPushConstants push_constants{};
+        push_constants.offset[0] = 0.0f;
+        push_constants.offset[1] = 0.0f;
+        push_constants.scale = 1.0f;
+        push_constants.rotation = 0.0f;
+        vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constants), &push_constants);
+        // Only the draw is timed for the variant benchmark, in the main window.
+        const bool timed = draw_timer_ && &output == &outputs_.front();
+        if (timed) {
+            draw_timer_->begin(command_buffer, frame_slot);
+        }
+        vkCmdDraw(command_buffer, 3, options_.draw_instances, 0, 0);
+        if (timed) {
+            draw_timer_->end(command_buffer, frame_slot);
+        }
+    }
+    vkCmdEndRenderPass(command_buffer);
 }
 
-SwapChainSupportDetails TriangleApplication::querySwapChainSupport(VkPhysicalDevice device)
+SwapChainSupportDetails TriangleApplication::querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface)
 {
     SwapChainSupportDetails details{};
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface_, &details.capabilities);
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
     uint32_t format_count = 0;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface_, &format_count, nullptr);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &format_count, nullptr);
     if (format_count != 0) {
         details.formats.resize(format_count);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface_, &format_count, details.formats.data());
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &format_count, details.formats.data());
     }
 
     uint32_t present_mode_count = 0;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface_, &present_mode_count, nullptr);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &present_mode_count, nullptr);
     if (present_mode_count != 0) {
         details.present_modes.resize(present_mode_count);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface_, &present_mode_count, details.present_modes.data());
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &present_mode_count, details.present_modes.data());
     }
     return details;
 }
@@ -820,6 +2098,11 @@ VkSurfaceFormatKHR TriangleApplication::chooseSwapSurfaceFormat(const std::vecto
 
 VkPresentModeKHR TriangleApplication::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes)
 {
+    // Paced frames are each shown once at their own vblank; mailbox would render
+    // frames that are replaced before they are seen.
+    if (options_.low_latency != LatencyMode::off) {
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
     for (const auto& present_mode: available_present_modes) {
         if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
             return present_mode;
@@ -828,13 +2111,13 @@ VkPresentModeKHR TriangleApplication::chooseSwapPresentMode(const std::vector<Vk
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D TriangleApplication::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
+VkExtent2D TriangleApplication::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window)
 {
     if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
         return capabilities.currentExtent;
     } else {
         int width, height;
-        glfwGetFramebufferSize(window_, &width, &height);
+        glfwGetFramebufferSize(window, &width, &height);
 
         VkExtent2D actual_extent = {
             static_cast<uint32_t>(width),
@@ -846,7 +2129,7 @@ VkExtent2D TriangleApplication::chooseSwapExtent(const VkSurfaceCapabilitiesKHR&
     }
 }
 
-VkShaderModule TriangleApplication::createShaderModule(const std::vector<char> &code)
+utils::UniqueShaderModule TriangleApplication::createShaderModule(const std::vector<char> &code)
 {
     VkShaderModuleCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -857,5 +2140,5 @@ VkShaderModule TriangleApplication::createShaderModule(const std::vector<char> &
     if (res != VK_SUCCESS) {
         throw std::runtime_error("failed to create shader module, error: " + std::to_string(res));
     }
-    return shader_module;
+    return utils::UniqueShaderModule(device_, shader_module);
 }
@@ -1,14 +1,36 @@
 #pragma once
 
+#include "cluster_renderer.h"
+#include "deletion_queue.h"
+#include "depth_pyramid.h"
+#include "draw_queue.h"
+#include "dynamic_resolution.h"
+#include "frame_capture.h"
+#include "frame_pacer.h"
+#include "gpu_timer.h"
+#include "job_system.h"
+#include "mesh_renderer.h"
+#include "options.h"
+#include "pipeline_variants.h"
+#include "scene.h"
+#include "startup_timeline.h"
+#include "texture_streamer.h"
+#include "uniform_ring.h"
+#include "vk_handle.h"
+#include "vk_utils.h"
 #include "vulkan/vulkan_core.h"
+#include "window_output.h"
 #include <stdint.h>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct QueueFamilyIndices
@@ -16,27 +38,97 @@ struct QueueFamilyIndices
     std::optional<uint32_t> graphics_family;
     std::optional<uint32_t> present_family;
 
-    bool isComplete() {
+    bool isComplete() const {
         return graphics_family.has_value() && present_family.has_value();
     }
 };
 
-struct SwapChainSupportDetails
+// Everything startup needs to know about a physical device, queried once in
+// pickPhysicalDevice() instead of re-asking the driver at every create* step.
+struct DeviceCapabilities
 {
-    VkSurfaceCapabilitiesKHR capabilities;
-    std::vector<VkSurfaceFormatKHR> formats;
-    std::vector<VkPresentModeKHR> present_modes;
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceFeatures features{};
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    std::vector<VkExtensionProperties> extensions;
+    std::vector<VkQueueFamilyProperties> queue_family_properties;
+    QueueFamilyIndices queue_families;
+    SwapChainSupportDetails swap_chain_support;
+    // Only queried when the device exposes VK_EXT_mesh_shader.
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{};
+    // Only queried when the device exposes VK_KHR_present_id and VK_KHR_present_wait.
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+
+    bool hasExtension(std::string_view name) const;
+    bool supportsMeshShaders() const;
+    bool supportsMemoryBudget() const;
+    bool supportsPresentWait() const;
+};
+
+// Per-frame data read by every draw through the dynamic uniform buffer; laid out
+// to match std140 in triangle_shader.vert and meshlet_common.glsl.
+struct FrameUniforms
+{
+    float time;
+    float aspect;
+    float padding[2];
+    float view_projection[16];
+    float camera_position[4];
+    float frustum_planes[6][4];
+    // Camera of the previous frame, which occlusion culling's depth pyramid was
+    // built with.
+    float previous_view_projection[16];
+};
+
+// Small per-draw data passed as push constants.
+struct DrawPushConstants
+{
+    float offset[2];
+    float scale;
+    float rotation;
+};
+
+// Feature switches of triangle_shader.vert and triangle_shader.frag, compiled
+// into the triangle pipeline as specialization constants in member order.
+struct TriangleFeatures
+{
+    VkBool32 rotation;
+    VkBool32 vertex_colors;
+    VkBool32 dither;
+
+    static constexpr const char* names[] = { "rotation", "vertex_colors", "dither" };
+};
+
+constexpr TriangleFeatures default_triangle_features{ VK_TRUE, VK_TRUE, VK_FALSE };
+
+// Terminates GLFW after everything created through it has been destroyed.
+struct GlfwLibrary
+{
+    bool initialized = false;
+
+    GlfwLibrary() = default;
+    ~GlfwLibrary()
+    {
+        if (initialized) {
+            glfwTerminate();
+        }
+    }
+    GlfwLibrary(const GlfwLibrary&) = delete;
+    GlfwLibrary& operator=(const GlfwLibrary&) = delete;
 };
 
 class TriangleApplication {
 public:
-    TriangleApplication() = default;
+    explicit TriangleApplication(AppOptions options);
     ~TriangleApplication();
 public:
     void run();
 
 
 private:
+    void initGlfw();
     void initWindow();
     void initVulkan();
     void enumExtensions();
@@ -44,48 +136,140 @@ private:
     void mainLoop();
     void drawFrame();
     bool checkValidationLayerSupport();
+    void loadShaders();
     void pickPhysicalDevice();
-    bool isSuitableDevice(VkPhysicalDevice physical_device);
-    bool isDeviceExtensionSupport(VkPhysicalDevice device);
-    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+    DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device);
+    bool isSuitableDevice(const DeviceCapabilities& caps);
+    bool isDeviceExtensionSupport(const DeviceCapabilities& caps);
+    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, const std::vector<VkQueueFamilyProperties>& family_props);
     void createSurface();
     void createLogicalDevice();
-    void createSwapChain();
-    void createImageViews();
+    void createSwapChains();
+    void createSwapChain(WindowOutput& output);
+    void recreateSwapChain(WindowOutput& output);
+    void createImageViews(WindowOutput& output);
     void createRenderPass();
+    void createDescriptorSetLayout();
+    VkFormat findDepthFormat();
+    utils::UniqueRenderPass createSceneRenderPass(VkImageLayout final_layout, VkPipelineStageFlags src_stage,
+                                                  VkAttachmentLoadOp depth_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR);
+    utils::UniqueRenderPass createPrepassRenderPass();
+    utils::UniqueImage createDepthImage(VkExtent2D extent, VkImageUsageFlags usage);
+    void createOffscreenTarget();
+    void createPipelineCache(const std::vector<char>& initial_data);
+    void savePipelineCache();
     void createGraphicsPipeline();
-    void createFramebuffers();
+    VkPipeline createTrianglePipeline(const VkSpecializationInfo& specialization);
+    void createFramebuffers(WindowOutput& output);
+    void createDepthPrepass();
     void createCommandPool();
-    void createCommandBuffer();
+    void createCommandBuffers();
     void createSyncObjects();
-    void recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index);
-    std::string getPhysicalDeviceName(VkPhysicalDevice device);
-    SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+    void createUniformRing();
+    void createDescriptorSet();
+    void createFrameCapture();
+    void createGpuTimer();
+    void createFramePacer();
+    void paceFrame();
+    void createClusterRenderer(const MeshletData& data);
+    void printClusterStats(uint32_t frame_slot);
+    void createMeshRenderer(const MeshFile& mesh);
+    void createScene();
+    void updateScene(const Camera& camera, float time);
+    void createTextureStreamer();
+    void updateDynamicResolution(uint32_t frame_slot);
+    void updateVariantBenchmark(uint32_t frame_slot);
+    void closeWindows();
+    void printWindowStats();
+    void recordUpscale(VkCommandBuffer command_buffer, uint32_t image_index);
+    void recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t frame_slot);
+    void recordDepthPrepass(VkCommandBuffer command_buffer, uint32_t frame_slot);
+    void recordOutput(VkCommandBuffer command_buffer, const WindowOutput& output, uint32_t frame_slot);
+    SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats);
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes);
-    VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-    VkShaderModule createShaderModule(const std::vector<char>& code);
+    VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window);
+    utils::UniqueShaderModule createShaderModule(const std::vector<char>& code);
 
 private:
-    GLFWwindow* window_ = nullptr;
-    VkInstance instance_ = VK_NULL_HANDLE;
+    AppOptions options_;
+    StartupTimeline timeline_;
+    // Members are destroyed in reverse order of declaration, so every Vulkan
+    // object below goes before the objects it was created from.
+    GlfwLibrary glfw_;
+    utils::UniqueInstance instance_;
     VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
-    VkDevice device_ = VK_NULL_HANDLE;
+    DeviceCapabilities device_caps_;
+    std::vector<char> vert_shader_code_;
+    std::vector<char> frag_shader_code_;
+    utils::UniqueDevice device_;
+    // The first output is the main window: device selection, dynamic resolution,
+    // frame capture and frame pacing follow it. Declared before the deletion
+    // queue so retired swap chains are destroyed before their surfaces.
+    std::vector<WindowOutput> outputs_;
+    // Objects replaced while frames are in flight wait here until those frames
+    // have completed.
+    DeletionQueue deletion_queue_;
+    utils::UniquePipelineCache pipeline_cache_;
     VkQueue graphics_queue_ = VK_NULL_HANDLE;
-    VkSurfaceKHR surface_ = VK_NULL_HANDLE;
     VkQueue present_queue_ = VK_NULL_HANDLE;
-    VkSwapchainKHR swap_chain_ = VK_NULL_HANDLE;
-    std::vector<VkImage> swap_chain_images_;
-    VkFormat swap_chain_image_format_;
-    VkExtent2D swap_chain_extent_;
-    std::vector<VkImageView> swap_chain_image_views_;
-    VkRenderPass render_pass_ = VK_NULL_HANDLE;
-    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
-    VkPipeline graphics_pipeline_ = VK_NULL_HANDLE;
-    std::vector<VkFramebuffer> swap_chain_framebuffers_;
-    VkCommandPool command_pool_ = VK_NULL_HANDLE;
-    VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
-    VkSemaphore semaphore_image_available_;
-    VkSemaphore semaphore_render_finished_;
-    VkFence fence_in_flight_;
+    utils::UniqueRenderPass render_pass_;
+    VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
+    utils::UniqueDescriptorSetLayout descriptor_set_layout_;
+    utils::UniquePipelineLayout pipeline_layout_;
+    std::unique_ptr<PipelineVariants<TriangleFeatures>> triangle_pipelines_;
+    uint32_t triangle_variant_ = PipelineVariants<TriangleFeatures>::key(default_triangle_features);
+    utils::UniqueCommandPool command_pool_;
+    std::vector<VkCommandBuffer> command_buffers_;
+    std::vector<utils::UniqueFence> fences_in_flight_;
+    uint64_t frame_number_ = 0;
+    std::optional<FramePacer> frame_pacer_;
+    // Presents carry frame_number + 1 as present ID and are waited on through
+    // VK_KHR_present_wait; otherwise the pacer estimates when frames are shown.
+    bool present_wait_ = false;
+    PFN_vkWaitForPresentKHR wait_for_present_ = nullptr;
+    // Last frame queued for present whose display time the pacer has not seen.
+    std::optional<uint64_t> pending_present_;
+    std::ofstream latency_log_;
+    std::unique_ptr<UniformRing> uniform_ring_;
+    utils::UniqueDescriptorPool descriptor_pool_;
+    VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+    uint32_t frame_uniforms_offset_ = 0;
+    std::unique_ptr<FrameCapture> frame_capture_;
+    std::unique_ptr<GpuTimer> gpu_timer_;
+    // Times the triangle draw alone, for --variant-bench.
+    std::unique_ptr<GpuTimer> draw_timer_;
+    std::optional<DynamicResolutionController> dynamic_resolution_;
+    // Render scale of the frame each slot recorded last, the one its GPU time is from.
+    std::vector<std::optional<float>> rendered_scales_;
+    utils::UniqueRenderPass offscreen_render_pass_;
+    utils::UniqueImage offscreen_target_;
+    utils::UniqueImage offscreen_depth_;
+    utils::UniqueFramebuffer offscreen_framebuffer_;
+    VkExtent2D render_extent_{};
+    // Variant drawn by each frame slot while benchmarking, unset for warm-up frames.
+    std::vector<std::optional<uint32_t>> variant_bench_slots_;
+    std::vector<std::pair<double, uint32_t>> variant_bench_times_;
+    // Occlusion culling: a depth-only prepass into the main window's depth
+    // buffer, the pyramid built from it, and the main window's pass that keeps
+    // the prepass depth instead of clearing it.
+    utils::UniqueRenderPass prepass_render_pass_;
+    utils::UniqueRenderPass load_depth_render_pass_;
+    utils::UniqueFramebuffer prepass_framebuffer_;
+    std::unique_ptr<DepthPyramid> depth_pyramid_;
+    float previous_view_projection_[16] = {};
+    std::unique_ptr<ClusterRenderer> cluster_renderer_;
+    std::unique_ptr<MeshRenderer> mesh_renderer_;
+    // --scene: instances of the mesh, culled for the main window's camera and
+    // drawn in every window.
+    std::unique_ptr<Scene> scene_;
+    GridScene grid_{};
+    std::vector<NodeId> scene_visible_;
+    // The visible nodes sorted by state, recorded into every window.
+    DrawQueue draw_queue_;
+    // Binds of the queue in scene order, measured on frames that print stats.
+    DrawQueue::BindStats unsorted_binds_{};
+    std::unique_ptr<JobSystem> jobs_;
+    std::unique_ptr<TextureStreamer> texture_streamer_;
+    std::vector<TextureStreamer::TextureId> textures_;
 };
\ No newline at end of file
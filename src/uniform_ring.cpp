@@ -0,0 +1,68 @@
+#include "uniform_ring.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+UniformRing::UniformRing(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, const VkPhysicalDeviceLimits& limits,
+                         VkDeviceSize bytes_per_frame, uint32_t frame_count)
+    : device_{device}, alignment_{std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1)}
+{
+    // Both limits are powers of two, so the larger one is a multiple of the other
+    // and every frame region starts on a flushable boundary.
+    const VkDeviceSize atom = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+    frame_size_ = alignUp(bytes_per_frame, std::max(alignment_, atom));
+    // Device local + host visible memory (resizable BAR or UMA) saves the GPU a
+    // trip over the bus on every read; plain host memory works everywhere.
+    buffer_ = utils::createBuffer(device_, mem_props, frame_size_ * frame_count, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!(buffer_.memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        non_coherent_atom_ = atom;
+    }
+    std::cout << "Uniform ring created: " << frame_count << " x " << frame_size_ << " bytes" << std::endl;
+}
+
+UniformRing::~UniformRing()
+{
+    utils::destroyBuffer(device_, buffer_);
+}
+
+void UniformRing::beginFrame(uint32_t frame_slot)
+{
+    frame_begin_ = frame_size_ * frame_slot;
+    cursor_ = frame_begin_;
+}
+
+UniformRing::Allocation UniformRing::allocate(VkDeviceSize size)
+{
+    VkDeviceSize offset = alignUp(cursor_, alignment_);
+    if (offset + size > frame_begin_ + frame_size_) {
+        throw std::runtime_error("uniform ring exhausted: " + std::to_string(offset + size - frame_begin_) +
+                                 " bytes requested this frame, " + std::to_string(frame_size_) + " available");
+    }
+    cursor_ = offset + size;
+    return Allocation{static_cast<char*>(buffer_.mapped) + offset, static_cast<uint32_t>(offset)};
+}
+
+void UniformRing::flush()
+{
+    if (non_coherent_atom_ == 0 || cursor_ == frame_begin_) {
+        return;
+    }
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = buffer_.memory;
+    range.offset = frame_begin_;
+    range.size = std::min(alignUp(cursor_ - frame_begin_, non_coherent_atom_), buffer_.size - frame_begin_);
+    vkFlushMappedMemoryRanges(device_, 1, &range);
+}
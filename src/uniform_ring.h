@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vk_utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <cstring>
+#include <stdint.h>
+
+// Per-frame uniform data without per-frame allocations or map calls. One buffer
+// is mapped once and split into a region per frame in flight; each frame
+// sub-allocates linearly from its own region, aligned to
+// minUniformBufferOffsetAlignment, and the returned offsets are used as dynamic
+// offsets for a single UNIFORM_BUFFER_DYNAMIC descriptor.
+class UniformRing {
+public:
+    struct Allocation
+    {
+        void* data;
+        uint32_t offset;
+    };
+
+public:
+    UniformRing(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, const VkPhysicalDeviceLimits& limits,
+                VkDeviceSize bytes_per_frame, uint32_t frame_count);
+    ~UniformRing();
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+public:
+    // Starts sub-allocating from frame_slot's region. The caller must have waited
+    // for the GPU to finish the frame that last used this slot.
+    void beginFrame(uint32_t frame_slot);
+    Allocation allocate(VkDeviceSize size);
+
+    template <typename T>
+    uint32_t push(const T& value)
+    {
+        Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation.offset;
+    }
+
+    // Makes this frame's writes visible to the device when the memory is not
+    // host coherent. Call once before submitting.
+    void flush();
+
+    VkBuffer buffer() const { return buffer_.buffer; }
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    utils::Buffer buffer_;
+    VkDeviceSize alignment_ = 0;
+    VkDeviceSize non_coherent_atom_ = 0;
+    VkDeviceSize frame_size_ = 0;
+    VkDeviceSize frame_begin_ = 0;
+    VkDeviceSize cursor_ = 0;
+};
@@ -1,6 +1,18 @@
 #include "utils.h"
 
 #include <fstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace utils
 {
@@ -19,6 +31,93 @@ std::vector<char> readFile(const std::string& file_path)
     file.close();
     return content;
 }
+
+std::vector<char> readFileIfExists(const std::string& file_path)
+{
+    std::ifstream file(file_path, std::fstream::ate | std::fstream::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+    size_t file_size = file.tellg();
+    std::vector<char> content;
+    content.resize(file_size);
+    file.seekg(0);
+    file.read(content.data(), file_size);
+    return content;
+}
+
+void writeFile(const std::string& file_path, const void* data, size_t size)
+{
+    std::ofstream file(file_path, std::fstream::trunc | std::fstream::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file for writing: " + file_path);
+    }
+    file.write(static_cast<const char*>(data), size);
+}
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& file_path)
+{
+    file_ = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        throw std::runtime_error("failed to open file: " + file_path);
+    }
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+        CloseHandle(file_);
+        throw std::runtime_error("failed to map empty or unreadable file: " + file_path);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        CloseHandle(file_);
+        throw std::runtime_error("failed to map file: " + file_path);
+    }
+    data_ = static_cast<const uint8_t*>(view);
+}
+
+MappedFile::~MappedFile()
+{
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& file_path)
+{
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file: " + file_path);
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("failed to map empty or unreadable file: " + file_path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* view = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("failed to map file: " + file_path);
+    }
+    data_ = static_cast<const uint8_t*>(view);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+#endif
     
 } // namespace utils
 
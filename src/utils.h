@@ -1,10 +1,34 @@
 #pragma once
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
 namespace utils {
 
 std::vector<char> readFile(const std::string& file_path);
+std::vector<char> readFileIfExists(const std::string& file_path);
+void writeFile(const std::string& file_path, const void* data, size_t size);
 
-} //utils
\ No newline at end of file
+// Read-only memory mapping of a whole file. Pages are read on first access, so
+// opening is cheap regardless of the file size.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& file_path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+} //utils
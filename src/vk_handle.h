@@ -0,0 +1,136 @@
+#pragma once
+
+#include "vk_utils.h"
+#include "vulkan/vulkan_core.h"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace utils {
+
+// Move-only owner of a Vulkan handle. Destroy is called as Destroy(parent,
+// handle, nullptr), or Destroy(handle, nullptr) for handles without a parent
+// (Parent = std::nullptr_t). The owner converts to the raw handle, so it can be
+// passed to Vulkan calls as is.
+template <typename Parent, typename T, auto Destroy>
+class OwnedHandle {
+public:
+    OwnedHandle() = default;
+    OwnedHandle(Parent parent, T handle)
+        : parent_{parent}
+        , handle_{handle}
+    {
+    }
+    ~OwnedHandle() { reset(); }
+    OwnedHandle(OwnedHandle&& other) noexcept
+        : parent_{other.parent_}
+        , handle_{std::exchange(other.handle_, T(VK_NULL_HANDLE))}
+    {
+    }
+    OwnedHandle& operator=(OwnedHandle&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            parent_ = other.parent_;
+            handle_ = std::exchange(other.handle_, T(VK_NULL_HANDLE));
+        }
+        return *this;
+    }
+    OwnedHandle(const OwnedHandle&) = delete;
+    OwnedHandle& operator=(const OwnedHandle&) = delete;
+
+    void reset()
+    {
+        if (handle_ == T(VK_NULL_HANDLE)) {
+            return;
+        }
+        if constexpr (std::is_same_v<Parent, std::nullptr_t>) {
+            Destroy(handle_, nullptr);
+        } else {
+            Destroy(parent_, handle_, nullptr);
+        }
+        handle_ = T(VK_NULL_HANDLE);
+    }
+    // Gives up ownership without destroying the handle.
+    T release() { return std::exchange(handle_, T(VK_NULL_HANDLE)); }
+
+    T get() const { return handle_; }
+    operator T() const { return handle_; }
+    // For calls taking an array of handles.
+    const T* address() const { return &handle_; }
+
+private:
+    Parent parent_{};
+    T handle_ = T(VK_NULL_HANDLE);
+};
+
+template <typename T, auto Destroy>
+using DeviceHandle = OwnedHandle<VkDevice, T, Destroy>;
+
+using UniqueInstance = OwnedHandle<std::nullptr_t, VkInstance, vkDestroyInstance>;
+using UniqueDevice = OwnedHandle<std::nullptr_t, VkDevice, vkDestroyDevice>;
+using UniqueSurface = OwnedHandle<VkInstance, VkSurfaceKHR, vkDestroySurfaceKHR>;
+using UniqueSwapchain = DeviceHandle<VkSwapchainKHR, vkDestroySwapchainKHR>;
+using UniqueImageView = DeviceHandle<VkImageView, vkDestroyImageView>;
+using UniqueRenderPass = DeviceHandle<VkRenderPass, vkDestroyRenderPass>;
+using UniqueFramebuffer = DeviceHandle<VkFramebuffer, vkDestroyFramebuffer>;
+using UniqueDescriptorSetLayout = DeviceHandle<VkDescriptorSetLayout, vkDestroyDescriptorSetLayout>;
+using UniqueDescriptorPool = DeviceHandle<VkDescriptorPool, vkDestroyDescriptorPool>;
+using UniquePipelineLayout = DeviceHandle<VkPipelineLayout, vkDestroyPipelineLayout>;
+using UniquePipelineCache = DeviceHandle<VkPipelineCache, vkDestroyPipelineCache>;
+using UniquePipeline = DeviceHandle<VkPipeline, vkDestroyPipeline>;
+using UniqueSampler = DeviceHandle<VkSampler, vkDestroySampler>;
+using UniqueShaderModule = DeviceHandle<VkShaderModule, vkDestroyShaderModule>;
+using UniqueCommandPool = DeviceHandle<VkCommandPool, vkDestroyCommandPool>;
+using UniqueSemaphore = DeviceHandle<VkSemaphore, vkDestroySemaphore>;
+using UniqueFence = DeviceHandle<VkFence, vkDestroyFence>;
+
+// Move-only owner of a utils::Buffer or utils::Image.
+template <typename T, void (*Destroy)(VkDevice, T&)>
+class OwnedResource {
+public:
+    OwnedResource() = default;
+    OwnedResource(VkDevice device, T resource)
+        : device_{device}
+        , resource_{resource}
+    {
+    }
+    ~OwnedResource() { reset(); }
+    OwnedResource(OwnedResource&& other) noexcept
+        : device_{other.device_}
+        , resource_{std::exchange(other.resource_, T{})}
+    {
+    }
+    OwnedResource& operator=(OwnedResource&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            device_ = other.device_;
+            resource_ = std::exchange(other.resource_, T{});
+        }
+        return *this;
+    }
+    OwnedResource(const OwnedResource&) = delete;
+    OwnedResource& operator=(const OwnedResource&) = delete;
+
+    // The destroy functions accept empty resources.
+    void reset()
+    {
+        if (device_ != VK_NULL_HANDLE) {
+            Destroy(device_, resource_);
+        }
+    }
+
+    const T& get() const { return resource_; }
+    const T* operator->() const { return &resource_; }
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    T resource_{};
+};
+
+using UniqueBuffer = OwnedResource<Buffer, destroyBuffer>;
+using UniqueImage = OwnedResource<Image, destroyImage>;
+
+} // namespace utils
@@ -0,0 +1,244 @@
+#include "vk_utils.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace utils
+{
+
+std::optional<uint32_t> findMemoryType(const VkPhysicalDeviceMemoryProperties& mem_props, uint32_t type_bits, VkMemoryPropertyFlags flags)
+{
+    for (uint32_t i = 0; i < mem_props.memoryTypeCount; ++i) {
+        if ((type_bits & (1u << i)) && (mem_props.memoryTypes[i].propertyFlags & flags) == flags) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+Buffer createBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkDeviceSize size,
+                    VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+    Buffer result{};
+    result.size = size;
+
+    VkBufferCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.size = size;
+    create_info.usage = usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult res = vkCreateBuffer(device, &create_info, nullptr, &result.buffer);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer, error: " + std::to_string(res));
+    }
+
+    VkMemoryRequirements mem_reqs{};
+    vkGetBufferMemoryRequirements(device, result.buffer, &mem_reqs);
+    auto type_index = findMemoryType(mem_props, mem_reqs.memoryTypeBits, required | preferred);
+    if (!type_index) {
+        type_index = findMemoryType(mem_props, mem_reqs.memoryTypeBits, required);
+    }
+    if (!type_index) {
+        vkDestroyBuffer(device, result.buffer, nullptr);
+        throw std::runtime_error("failed to find suitable memory type for buffer");
+    }
+    result.memory_flags = mem_props.memoryTypes[*type_index].propertyFlags;
+
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = mem_reqs.size;
+    alloc_info.memoryTypeIndex = *type_index;
+    res = vkAllocateMemory(device, &alloc_info, nullptr, &result.memory);
+    if (res != VK_SUCCESS) {
+        vkDestroyBuffer(device, result.buffer, nullptr);
+        throw std::runtime_error("failed to allocate buffer memory, error: " + std::to_string(res));
+    }
+    vkBindBufferMemory(device, result.buffer, result.memory, 0);
+
+    if (result.memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        res = vkMapMemory(device, result.memory, 0, VK_WHOLE_SIZE, 0, &result.mapped);
+        if (res != VK_SUCCESS) {
+            destroyBuffer(device, result);
+            throw std::runtime_error("failed to map buffer memory, error: " + std::to_string(res));
+        }
+    }
+    return result;
+}
+
+void destroyBuffer(VkDevice device, Buffer& buffer)
+{
+    if (buffer.mapped) {
+        vkUnmapMemory(device, buffer.memory);
+    }
+    vkDestroyBuffer(device, buffer.buffer, nullptr);
+    vkFreeMemory(device, buffer.memory, nullptr);
+    buffer = Buffer{};
+}
+
+Buffer createDeviceLocalBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                               VkCommandPool command_pool, const void* data, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    if (size == 0) {
+        throw std::invalid_argument("cannot create an empty buffer");
+    }
+    Buffer staging = createBuffer(device, mem_props, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    std::memcpy(staging.mapped, data, size);
+    Buffer result{};
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    try {
+        result = createBuffer(device, mem_props, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        VkResult res = vkAllocateCommandBuffers(device, &alloc_info, &command_buffer);
+        if (res != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer, error: " + std::to_string(res));
+        }
+
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(command_buffer, &begin_info);
+        VkBufferCopy region{};
+        region.size = size;
+        vkCmdCopyBuffer(command_buffer, staging.buffer, result.buffer, 1, &region);
+        vkEndCommandBuffer(command_buffer);
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &command_buffer;
+        res = vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
+        if (res != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit buffer upload, error: " + std::to_string(res));
+        }
+        res = vkQueueWaitIdle(queue);
+        if (res != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for buffer upload, error: " + std::to_string(res));
+        }
+    } catch (...) {
+        if (command_buffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+        }
+        destroyBuffer(device, result);
+        destroyBuffer(device, staging);
+        throw;
+    }
+    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+    destroyBuffer(device, staging);
+    return result;
+}
+
+Image createImage(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkExtent2D extent,
+                  VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, uint32_t mip_levels)
+{
+    Image result{};
+    result.format = format;
+    result.extent = extent;
+    result.mip_levels = mip_levels;
+
+    VkImageCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = format;
+    create_info.extent = {extent.width, extent.height, 1};
+    create_info.mipLevels = mip_levels;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult res = vkCreateImage(device, &create_info, nullptr, &result.image);
+    if (res != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image, error: " + std::to_string(res));
+    }
+
+    VkMemoryRequirements mem_reqs{};
+    vkGetImageMemoryRequirements(device, result.image, &mem_reqs);
+    auto type_index = findMemoryType(mem_props, mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!type_index) {
+        vkDestroyImage(device, result.image, nullptr);
+        throw std::runtime_error("failed to find suitable memory type for image");
+    }
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = mem_reqs.size;
+    alloc_info.memoryTypeIndex = *type_index;
+    res = vkAllocateMemory(device, &alloc_info, nullptr, &result.memory);
+    if (res != VK_SUCCESS) {
+        vkDestroyImage(device, result.image, nullptr);
+        throw std::runtime_error("failed to allocate image memory, error: " + std::to_string(res));
+    }
+    vkBindImageMemory(device, result.image, result.memory, 0);
+
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = result.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.subresourceRange.aspectMask = aspect;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = mip_levels;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    res = vkCreateImageView(device, &view_info, nullptr, &result.view);
+    if (res != VK_SUCCESS) {
+        destroyImage(device, result);
+        throw std::runtime_error("failed to create image view, error: " + std::to_string(res));
+    }
+    return result;
+}
+
+void destroyImage(VkDevice device, Image& image)
+{
+    vkDestroyImageView(device, image.view, nullptr);
+    vkDestroyImage(device, image.image, nullptr);
+    vkFreeMemory(device, image.memory, nullptr);
+    image = Image{};
+}
+
+void imageBarrier(VkCommandBuffer command_buffer, VkImage image,
+                  VkImageLayout old_layout, VkImageLayout new_layout,
+                  VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                  VkPipelineStageFlags dst_stage, VkAccessFlags dst_access,
+                  VkImageAspectFlags aspect)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void memoryBarrier(VkCommandBuffer command_buffer,
+                   VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                   VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+} // namespace utils
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "vulkan/vulkan_core.h"
+
+#include <optional>
+#include <stdint.h>
+
+namespace utils {
+
+struct Buffer
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    VkMemoryPropertyFlags memory_flags = 0;
+    // Persistently mapped for the buffer's whole lifetime when host visible.
+    void* mapped = nullptr;
+};
+
+std::optional<uint32_t> findMemoryType(const VkPhysicalDeviceMemoryProperties& mem_props, uint32_t type_bits, VkMemoryPropertyFlags flags);
+
+// Allocates a dedicated memory block for the buffer. A memory type that also has
+// the preferred flags is picked when there is one, otherwise any type with the
+// required flags. Host visible memory is mapped once here and unmapped in
+// destroyBuffer().
+Buffer createBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkDeviceSize size,
+                    VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0);
+void destroyBuffer(VkDevice device, Buffer& buffer);
+
+// Creates a device local buffer and fills it through a temporary staging buffer.
+// Blocks until the copy has finished, so it is meant for load time uploads.
+Buffer createDeviceLocalBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkQueue queue,
+                               VkCommandPool command_pool, const void* data, VkDeviceSize size, VkBufferUsageFlags usage);
+
+struct Image
+{
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent{};
+    uint32_t mip_levels = 1;
+};
+
+// Creates a device local 2D image with its own memory block and a view of all
+// of its mip levels.
+Image createImage(VkDevice device, const VkPhysicalDeviceMemoryProperties& mem_props, VkExtent2D extent,
+                  VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, uint32_t mip_levels = 1);
+void destroyImage(VkDevice device, Image& image);
+
+void imageBarrier(VkCommandBuffer command_buffer, VkImage image,
+                  VkImageLayout old_layout, VkImageLayout new_layout,
+                  VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                  VkPipelineStageFlags dst_stage, VkAccessFlags dst_access,
+                  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+void memoryBarrier(VkCommandBuffer command_buffer,
+                   VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                   VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+
+} // namespace utils
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "vk_handle.h"
+#include "vulkan/vulkan_core.h"
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <vector>
+
+struct SwapChainSupportDetails
+{
+    VkSurfaceCapabilitiesKHR capabilities;
+    std::vector<VkSurfaceFormatKHR> formats;
+    std::vector<VkPresentModeKHR> present_modes;
+};
+
+// A window the application renders into, with its own surface, swap chain and
+// presentation semaphores. The device, render pass, pipelines and scene
+// resources are shared by all outputs, so every swap chain has to use the same
+// format. Outputs are drawn in the same command buffer and presented together,
+// each at most once per interval.
+struct WindowOutput
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Members are destroyed in reverse order: the swap chain goes before its
+    // surface, and the surface before its window.
+    std::unique_ptr<GLFWwindow, decltype(&glfwDestroyWindow)> window{nullptr, glfwDestroyWindow};
+    utils::UniqueSurface surface;
+    SwapChainSupportDetails support{};
+    utils::UniqueSwapchain swap_chain;
+    std::vector<VkImage> images;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent{};
+    std::vector<utils::UniqueImageView> image_views;
+    // Shared by the framebuffers of all swap chain images.
+    utils::UniqueImage depth;
+    std::vector<utils::UniqueFramebuffer> framebuffers;
+    // One of each per frame in flight.
+    std::vector<utils::UniqueSemaphore> image_available;
+    std::vector<utils::UniqueSemaphore> render_finished;
+
+    // Shortest time between two frames of this window; zero draws it every frame.
+    Clock::duration interval{};
+    Clock::time_point next_frame{};
+    // Image acquired for the frame being recorded, unset when the window skips it.
+    std::optional<uint32_t> image_index;
+    // Uniform ring offset of the window's FrameUniforms for that frame.
+    uint32_t frame_uniforms_offset = 0;
+    uint64_t frames = 0;
+    // Frames the window was due but had no image available.
+    uint64_t skipped = 0;
+
+    bool due(Clock::time_point now) const { return now >= next_frame; }
+    // Keeps the window on its cadence, or restarts it after falling a whole
+    // interval behind.
+    void scheduleNext(Clock::time_point now)
+    {
+        next_frame = now - next_frame >= interval ? now + interval : next_frame + interval;
+        ++frames;
+    }
+    // Tries again shortly after the window could not be drawn, without spinning.
+    void retryLater(Clock::time_point now)
+    {
+        next_frame = now + std::min<Clock::duration>(interval, std::chrono::milliseconds(2));
+    }
+};